@@ -36,6 +36,13 @@ typedef struct __attribute__((packed)) E820Entries
   E820Entry entries[];
 } E820Entries;
 
+typedef struct __attribute__((packed)) RamdiskDescriptor
+{
+  UINT64 magic;
+  UINT64 base;
+  UINT64 size;
+} RamdiskDescriptor;
+
 EFI_HANDLE imageHandle = NULL;
 EFI_SYSTEM_TABLE *systemTable = NULL;
 
@@ -252,6 +259,62 @@ EFI_STATUS ReadFileFromCurrentFilesystem(CHAR16 *FileName, VOID **Buffer_Out, UI
   return EFI_SUCCESS;
 }
 
+/**
+  Loads the optional ramdisk.img next to the kernel and describes it to the
+  kernel at MYOS_RAMDISK_DESCRIPTOR_LOCATION. Must run before SetupMemoryMaps
+  so the image pages are not handed to the kernel heap.
+**/
+EFI_STATUS SetupRamdisk()
+{
+  EFI_STATUS Status;
+  EFI_PHYSICAL_ADDRESS DescriptorLocation = MYOS_RAMDISK_DESCRIPTOR_LOCATION;
+  Status = gBS->AllocatePages(
+      AllocateAddress,
+      EfiLoaderData,
+      1,
+      &DescriptorLocation);
+  if (EFI_ERROR(Status))
+  {
+    Print(L"AllocatePages RamdiskDescriptor error: %r\n", Status);
+    return Status;
+  }
+
+  RamdiskDescriptor *Descriptor = (RamdiskDescriptor *)DescriptorLocation;
+  ZeroMem(Descriptor, sizeof(*Descriptor));
+
+  VOID *ImageBuffer = NULL;
+  UINTN ImageBufferSize = 0;
+  Status = ReadFileFromCurrentFilesystem(L"ramdisk.img", &ImageBuffer, &ImageBufferSize);
+  if (EFI_ERROR(Status))
+  {
+    Print(L"No ramdisk image, continuing without one\n");
+    return EFI_SUCCESS;
+  }
+
+  // keep the image below 4GB, the kernel identity maps it
+  EFI_PHYSICAL_ADDRESS ImageBase = 0xFFFFFFFF;
+  Status = gBS->AllocatePages(
+      AllocateMaxAddress,
+      EfiLoaderData,
+      EFI_SIZE_TO_PAGES(ImageBufferSize),
+      &ImageBase);
+  if (EFI_ERROR(Status))
+  {
+    Print(L"AllocatePages RamdiskImage error: %r\n", Status);
+    FreePool(ImageBuffer);
+    return Status;
+  }
+
+  CopyMem((VOID *)ImageBase, ImageBuffer, ImageBufferSize);
+  FreePool(ImageBuffer);
+
+  Descriptor->base = ImageBase;
+  Descriptor->size = ImageBufferSize;
+  Descriptor->magic = MYOS_RAMDISK_DESCRIPTOR_MAGIC;
+  Print(L"Ramdisk image at 0x%lx, size 0x%lx\n", Descriptor->base, Descriptor->size);
+  return EFI_SUCCESS;
+}
+
 EFI_STATUS GetFrameBufferInfo(EFI_GRAPHICS_OUTPUT_PROTOCOL **GraphicsOutput)
 {
   EFI_STATUS Status;
@@ -316,6 +379,13 @@ UefiMain(
 
   Print(L"KernelBuffer: %p, KernelBufferSize: %u\n", KernelBuffer, KernelBufferSize);
 
+  // load the optional ramdisk image, failure only costs us the ramdisk
+  Status = SetupRamdisk();
+  if (EFI_ERROR(Status))
+  {
+    Print(L"SetupRamdisk error: %r\n", Status);
+  }
+
   // setup memory maps
   Status = SetupMemoryMaps();
   if (EFI_ERROR(Status))
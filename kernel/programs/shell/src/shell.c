@@ -3,6 +3,112 @@
 #include "string.h"
 #include "stdlib.h"
 #include "myos.h"
+#include "file.h"
+
+static uint64_t shell_ticks_to_microseconds(uint64_t ticks, uint64_t tsc_frequency)
+{
+	uint64_t ticks_per_microsecond = tsc_frequency / 1000000;
+	return ticks_per_microsecond ? ticks / ticks_per_microsecond : ticks;
+}
+
+static void shell_iostat_direction(const char *name, struct disk_io_stats *stats, uint64_t tsc_frequency)
+{
+	uint64_t completed = stats->requests - stats->errors;
+	uint64_t average = completed ? shell_ticks_to_microseconds(stats->total_latency / completed, tsc_frequency) : 0;
+	printf("  %s: %lu requests, %lu sectors, %lu bytes, %lu errors, avg %lu us\n",
+		   name, stats->requests, stats->sectors, stats->bytes, stats->errors, average);
+
+	// one line per populated log2 bucket, lower bound in microseconds
+	for (int i = 0; i < MYOS_DISK_STATS_LATENCY_BUCKETS; i++)
+	{
+		if (stats->latency_histogram[i])
+		{
+			printf("    >= %lu us: %lu\n", shell_ticks_to_microseconds(1ul << i, tsc_frequency), stats->latency_histogram[i]);
+		}
+	}
+}
+
+static void shell_iostat()
+{
+	struct disk_stats_info info;
+	for (long disk_id = 0; myos_disk_stats(disk_id, &info) >= 0; disk_id++)
+	{
+		printf("disk %d (%s): %lu sectors of %d bytes\n", info.id,
+			   info.type == MYOS_DISK_TYPE_REAL ? "hardware" : "partition", info.total_sectors, info.sector_size);
+		shell_iostat_direction("read", &info.read, info.tsc_frequency);
+		shell_iostat_direction("write", &info.write, info.tsc_frequency);
+		printf("  cache: %lu hits, %lu misses\n", info.cache_hits, info.cache_misses);
+		if (info.type == MYOS_DISK_TYPE_REAL)
+		{
+			printf("  queue: %lu commands, %lu front merges, %lu back merges, max depth %lu, service %lu us\n",
+				   info.queue_dispatched, info.queue_front_merges, info.queue_back_merges, info.queue_max_depth,
+				   shell_ticks_to_microseconds(info.queue_service_time, info.tsc_frequency));
+		}
+	}
+}
+
+static void shell_gstat()
+{
+	struct graphics_stats stats;
+	if (myos_graphics_stats(&stats) < 0)
+	{
+		printf("gstat: no graphics statistics\n");
+		return;
+	}
+
+	printf("%lu frames, %lu rects, %lu pixels pushed, %lu pixels/s\n", stats.frames, stats.rects, stats.pixels, stats.pixels_per_second);
+}
+
+// lists a directory a batch of entries per system call, the primary disk's root without an argument
+static void shell_ls(const char *command)
+{
+	const char *path = command[2] == ' ' ? command + 3 : "@:/";
+	struct dirent entries[32];
+	unsigned int cursor = 0;
+	int total = 0;
+	while ((total = readdir(path, &cursor, entries, sizeof(entries) / sizeof(entries[0]))) > 0)
+	{
+		for (int i = 0; i < total; i++)
+		{
+			if (entries[i].attributes & DIRENT_DIRECTORY)
+			{
+				printf("  %s/\n", entries[i].name);
+				continue;
+			}
+
+			printf("  %s %u\n", entries[i].name, entries[i].size);
+		}
+	}
+
+	if (total < 0)
+	{
+		printf("ls: cannot list %s\n", path);
+	}
+}
+
+// commands handled by the shell itself, returns false to run the command as a program
+static bool shell_builtin(const char *command)
+{
+	if (strncmp(command, "iostat", sizeof("iostat")) == 0)
+	{
+		shell_iostat();
+		return true;
+	}
+
+	if (strncmp(command, "gstat", sizeof("gstat")) == 0)
+	{
+		shell_gstat();
+		return true;
+	}
+
+	if (strncmp(command, "ls", 2) == 0 && (command[2] == 0 || command[2] == ' '))
+	{
+		shell_ls(command);
+		return true;
+	}
+
+	return false;
+}
 
 int main(int argc, char **argv)
 {
@@ -13,6 +119,12 @@ int main(int argc, char **argv)
 		char buf[1024];
 		myos_terminal_readline(buf, sizeof(buf), true);
 		print("\n");
+		if (shell_builtin(buf))
+		{
+			print("\n");
+			continue;
+		}
+
 		int res = myos_system_run(buf);
 		if (res < 0)
 		{
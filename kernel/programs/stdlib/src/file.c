@@ -24,4 +24,59 @@ int fseek(long fd, int offset, int whence)
 int fstat(long fd, struct file_stat *filestat_out)
 {
 	return (int)myos_fstat(fd, filestat_out);
-}
\ No newline at end of file
+}
+
+int fwrite(const void *buffer, size_t size, size_t count, long fd)
+{
+	return (int)myos_fwrite(buffer, size, count, fd);
+}
+
+int ftruncate(long fd, size_t size)
+{
+	return (int)myos_ftruncate(fd, size);
+}
+
+int fdup(long fd)
+{
+	return (int)myos_fdup(fd);
+}
+
+int funlink(const char *filename)
+{
+	return (int)myos_funlink(filename);
+}
+
+int pread(long fd, void *buffer, size_t count, long offset)
+{
+	return (int)myos_pread(fd, buffer, count, offset);
+}
+
+int pwrite(long fd, const void *buffer, size_t count, long offset)
+{
+	return (int)myos_pwrite(fd, buffer, count, offset);
+}
+
+int readv(long fd, const struct iovec *iov, int iovcnt)
+{
+	return (int)myos_readv(fd, iov, iovcnt);
+}
+
+int writev(long fd, const struct iovec *iov, int iovcnt)
+{
+	return (int)myos_writev(fd, iov, iovcnt);
+}
+
+int readdir(const char *path, unsigned int *cursor, struct dirent *entries, int max)
+{
+	return (int)myos_readdir(path, cursor, entries, max);
+}
+
+void *fmap(long fd, long offset, size_t size)
+{
+	return myos_fmap(fd, offset, size);
+}
+
+int funmap(void *ptr)
+{
+	return (int)myos_funmap(ptr);
+}
@@ -11,8 +11,50 @@ struct file_stat
 	uint32_t filesize;
 };
 
+#define DIRENT_DIRECTORY 0b00000001
+#define DIRENT_READ_ONLY 0b00000010
+#define DIRENT_HIDDEN 0b00000100
+#define DIRENT_SYSTEM 0b00001000
+
+// must match struct file_dirent in the kernel
+struct dirent
+{
+	char name[16];
+	uint32_t size;
+	uint32_t attributes;
+	uint32_t first_cluster;
+	uint32_t reserved;
+};
+
+// one buffer of a readv or writev
+struct iovec
+{
+	void *base;
+	size_t len;
+};
+
 int fopen(const char *filename, const char *mode);
 void fclose(int fd);
 int fread(void *buffer, size_t size, size_t count, long fd);
 int fseek(long fd, int offset, int whence);
-int fstat(long fd, struct file_stat *filestat_out);
\ No newline at end of file
+int fstat(long fd, struct file_stat *filestat_out);
+int fwrite(const void *buffer, size_t size, size_t count, long fd);
+int ftruncate(long fd, size_t size);
+int funlink(const char *filename);
+
+// a second descriptor for the same open file, the two share the position until both are closed
+int fdup(long fd);
+
+// positional and vectored calls return bytes transferred, pread and pwrite leave the position untouched
+int pread(long fd, void *buffer, size_t count, long offset);
+int pwrite(long fd, const void *buffer, size_t count, long offset);
+int readv(long fd, const struct iovec *iov, int iovcnt);
+int writev(long fd, const struct iovec *iov, int iovcnt);
+
+// fills up to max entries of the directory at path, start with a zero cursor and call again until it returns zero
+int readdir(const char *path, unsigned int *cursor, struct dirent *entries, int max);
+
+// maps size bytes of the file from offset, a multiple of 4096, read only, returns NULL on failure
+// the mapping is shared with every other process that maps the same pages and stays valid after fclose
+void *fmap(long fd, long offset, size_t size);
+int funmap(void *ptr);
\ No newline at end of file
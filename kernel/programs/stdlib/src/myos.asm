@@ -27,6 +27,19 @@ global myos_graphics_create:function
 global myos_window_redraw_region:function
 global myos_window_title_set:function
 global myos_udelay:function
+global myos_disk_stats:function
+global myos_fwrite:function
+global myos_ftruncate:function
+global myos_funlink:function
+global myos_pread:function
+global myos_pwrite:function
+global myos_readv:function
+global myos_writev:function
+global myos_readdir:function
+global myos_fmap:function
+global myos_funmap:function
+global myos_graphics_stats:function
+global myos_fdup:function
 
 ; void print(const char* filename)
 print:
@@ -244,4 +257,128 @@ myos_udelay:
 	push qword rdi      ; variable microseconds
 	int 0x80
 	add rsp, 8          ; clean up stack
-	ret
\ No newline at end of file
+	ret
+
+; long myos_disk_stats(long disk_id, struct disk_stats_info* info_out)
+myos_disk_stats:
+	mov rax, 26         ; command 26 disk stats
+	push qword rsi      ; variable info_out
+	push qword rdi      ; variable disk_id
+	int 0x80
+	add rsp, 16         ; clean up stack
+	ret
+
+; long myos_fwrite(const void* buffer, size_t size, size_t count, long fd)
+myos_fwrite:
+	mov rax, 27        ; command 27 fwrite
+	push qword rcx     ; variable fd
+	push qword rdx     ; variable count
+	push qword rsi     ; variable size
+	push qword rdi     ; variable ptr
+	int 0x80
+	add rsp, 32        ; clean up stack
+	ret
+
+; long myos_ftruncate(long fd, size_t size)
+myos_ftruncate:
+	mov rax, 28        ; command 28 ftruncate
+	push qword rsi     ; variable size
+	push qword rdi     ; variable fd
+	int 0x80
+	add rsp, 16        ; clean up stack
+	ret
+
+; long myos_funlink(const char* filename)
+myos_funlink:
+	mov rax, 29        ; command 29 funlink
+	push qword rdi     ; variable filename
+	int 0x80
+	add rsp, 8         ; clean up stack
+	ret
+
+; long myos_pread(long fd, void* buffer, size_t count, long offset)
+myos_pread:
+	mov rax, 30        ; command 30 pread
+	push qword rcx     ; variable offset
+	push qword rdx     ; variable count
+	push qword rsi     ; variable buffer
+	push qword rdi     ; variable fd
+	int 0x80
+	add rsp, 32        ; clean up stack
+	ret
+
+; long myos_pwrite(long fd, const void* buffer, size_t count, long offset)
+myos_pwrite:
+	mov rax, 31        ; command 31 pwrite
+	push qword rcx     ; variable offset
+	push qword rdx     ; variable count
+	push qword rsi     ; variable buffer
+	push qword rdi     ; variable fd
+	int 0x80
+	add rsp, 32        ; clean up stack
+	ret
+
+; long myos_readv(long fd, const struct iovec* iov, long iovcnt)
+myos_readv:
+	mov rax, 32        ; command 32 readv
+	push qword rdx     ; variable iovcnt
+	push qword rsi     ; variable iov
+	push qword rdi     ; variable fd
+	int 0x80
+	add rsp, 24        ; clean up stack
+	ret
+
+; long myos_writev(long fd, const struct iovec* iov, long iovcnt)
+myos_writev:
+	mov rax, 33        ; command 33 writev
+	push qword rdx     ; variable iovcnt
+	push qword rsi     ; variable iov
+	push qword rdi     ; variable fd
+	int 0x80
+	add rsp, 24        ; clean up stack
+	ret
+
+; long myos_readdir(const char* path, unsigned int* cursor, struct dirent* entries, long max)
+myos_readdir:
+	mov rax, 34        ; command 34 readdir
+	push qword rcx     ; variable max
+	push qword rdx     ; variable entries
+	push qword rsi     ; variable cursor
+	push qword rdi     ; variable path
+	int 0x80
+	add rsp, 32        ; clean up stack
+	ret
+
+; void* myos_fmap(long fd, long offset, size_t size)
+myos_fmap:
+	mov rax, 35        ; command 35 fmap
+	push qword rdx     ; variable size
+	push qword rsi     ; variable offset
+	push qword rdi     ; variable fd
+	int 0x80
+	add rsp, 24        ; clean up stack
+	ret
+
+; long myos_funmap(void* ptr)
+myos_funmap:
+	mov rax, 36        ; command 36 funmap
+	push qword rdi     ; variable ptr
+	int 0x80
+	add rsp, 8         ; clean up stack
+	ret
+
+; long myos_graphics_stats(struct graphics_stats* stats_out)
+myos_graphics_stats:
+	mov rax, 37        ; command 37 graphics stats
+	push qword rdi     ; variable stats_out
+	int 0x80
+	add rsp, 8         ; clean up stack
+	ret
+
+; long myos_fdup(long fd)
+myos_fdup:
+	mov rax, 38        ; command 38 fdup
+	push qword rdi     ; variable fd
+	int 0x80
+	add rsp, 8         ; clean up stack
+	ret
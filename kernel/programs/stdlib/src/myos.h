@@ -5,6 +5,8 @@
 #include <stdint.h>
 
 struct file_stat;
+struct iovec;
+struct dirent;
 struct window;
 
 // temporary structure for window events until implementing a GUI sdk
@@ -42,6 +44,52 @@ struct window_event
 	} data;			  // event-specific data
 };
 
+#define MYOS_DISK_TYPE_REAL 0
+#define MYOS_DISK_TYPE_PARTITION 1
+#define MYOS_DISK_STATS_LATENCY_BUCKETS 40
+
+// counters for one transfer direction, latencies are in TSC ticks
+struct disk_io_stats
+{
+	uint64_t requests;
+	uint64_t sectors;
+	uint64_t bytes;
+	uint64_t errors;
+	uint64_t total_latency;
+	uint64_t latency_histogram[MYOS_DISK_STATS_LATENCY_BUCKETS]; // bucket n counts requests that took [2^n, 2^(n+1)) ticks
+};
+
+// must match struct disk_stats_info in the kernel
+struct disk_stats_info
+{
+	int id;
+	int type;
+	int sector_size;
+	int reserved;
+	uint64_t total_sectors;
+	uint64_t tsc_frequency;
+
+	struct disk_io_stats read;
+	struct disk_io_stats write;
+	uint64_t cache_hits;
+	uint64_t cache_misses;
+
+	uint64_t queue_dispatched;
+	uint64_t queue_front_merges;
+	uint64_t queue_back_merges;
+	uint64_t queue_max_depth;
+	uint64_t queue_service_time;
+};
+
+// must match struct graphics_stats in the kernel
+struct graphics_stats
+{
+	uint64_t frames;			// presents that had damage to push
+	uint64_t rects;				// dirty rectangles pushed
+	uint64_t pixels;			// pixels pushed since boot
+	uint64_t pixels_per_second; // pixels pushed over the last full second
+};
+
 struct command_argument
 {
 	char argument[512];
@@ -73,6 +121,17 @@ void myos_fclose(int fd);
 long myos_fread(void *buffer, size_t size, size_t count, long fd);
 long myos_fseek(long fd, long offset, long whence);
 long myos_fstat(long fd, struct file_stat *filestat_out);
+long myos_fwrite(const void *buffer, size_t size, size_t count, long fd);
+long myos_ftruncate(long fd, size_t size);
+long myos_funlink(const char *filename);
+long myos_pread(long fd, void *buffer, size_t count, long offset);
+long myos_pwrite(long fd, const void *buffer, size_t count, long offset);
+long myos_readv(long fd, const struct iovec *iov, long iovcnt);
+long myos_writev(long fd, const struct iovec *iov, long iovcnt);
+long myos_readdir(const char *path, unsigned int *cursor, struct dirent *entries, long max);
+void *myos_fmap(long fd, long offset, size_t size);
+long myos_funmap(void *ptr);
+long myos_fdup(long fd);
 void *myos_window_create(const char *title, long width, long height, long flags, long id);
 void myos_divert_stdout_to_window(struct window *win);
 int myos_process_get_window_event(struct window_event *event);
@@ -82,4 +141,6 @@ void myos_window_redraw(struct window *win);
 void *myos_graphics_create(size_t x, size_t y, size_t width, size_t height, void *parent_graphics);
 void myos_window_redraw_region(long rel_x, long rel_y, long rel_width, long rel_height, struct window *win);
 void myos_window_title_set(struct window *win, const char *title);
-void myos_udelay(uint64_t microseconds);
\ No newline at end of file
+void myos_udelay(uint64_t microseconds);
+long myos_disk_stats(long disk_id, struct disk_stats_info *info_out);
+long myos_graphics_stats(struct graphics_stats *stats_out);
\ No newline at end of file
@@ -43,6 +43,14 @@ int printf(const char *fmt, ...)
 			print(utoa(ival));
 			break;
 
+		case 'l':
+			if (*(p + 1) == 'u')
+			{
+				p++;
+				print(ultoa(va_arg(ap, unsigned long)));
+			}
+			break;
+
 		default:
 			putchar(*p);
 			break;
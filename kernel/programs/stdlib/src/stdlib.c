@@ -53,6 +53,26 @@ char *utoa(unsigned int i)
 	return &text[loc];
 }
 
+char *ultoa(unsigned long i)
+{
+	static char text[21];
+	int loc = 20;
+	text[20] = 0;
+
+	while (i)
+	{
+		text[--loc] = '0' + (i % 10);
+		i /= 10;
+	}
+
+	if (loc == 20)
+	{
+		text[--loc] = '0';
+	}
+
+	return &text[loc];
+}
+
 void *malloc(size_t size)
 {
 	return myos_malloc(size);
@@ -7,4 +7,5 @@ void *calloc(size_t n_memb, size_t size);
 void *realloc(void *ptr, size_t new_size);
 void free(void *ptr);
 char *itoa(int i);
-char *utoa(unsigned int i);
\ No newline at end of file
+char *utoa(unsigned int i);
+char *ultoa(unsigned long i);
\ No newline at end of file
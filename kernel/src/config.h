@@ -16,9 +16,18 @@
 
 #define MYOS_TOTAL_INTERRUPTS 512
 
+// range of vectors handed out to MSI/MSI-X capable drivers, the CPU only dispatches
+// vectors 0-255 and 0xFF is kept for the local APIC spurious interrupt
+#define MYOS_FIRST_DYNAMIC_INTERRUPT 0x30
+#define MYOS_LAST_DYNAMIC_INTERRUPT 0xEF
+
 #define MYOS_MEMORY_MAP_TOTAL_ENTRIES_LOCATION 0x210000 // location of e820 entry count
 #define MYOS_MEMORY_MAP_LOCATION 0x210008				// location of e820 entries
 
+// the bootloader describes an optional ramdisk image here
+#define MYOS_RAMDISK_DESCRIPTOR_LOCATION 0x20F000
+#define MYOS_RAMDISK_DESCRIPTOR_MAGIC 0x4B5349444D4152ULL // "RAMDISK"
+
 #define MYOS_HEAP_MINIMUM_SIZE_BYTES 104857600 // 100MB heap size
 #define MYOS_HEAP_BLOCK_SIZE 4096
 
@@ -35,10 +44,37 @@
 #define MYOS_SECTOR_SIZE 512
 
 #define MYOS_MAX_FILESYSTEMS 12
-#define MYOS_MAX_FILE_DESCRIPTORS 512
+
+// descriptor tables start with this many slots and double when full
+#define MYOS_FD_TABLE_INITIAL 32
 
 #define MYOS_MAX_PATH 108
 
+// components a path may have, parsed paths keep one view per component on the caller's stack
+#define MYOS_PATH_MAX_PARTS 32
+
+// physically contiguous runs of a user buffer handed to the filesystem per batch
+#define MYOS_PROCESS_IO_SEGMENTS 16
+
+// largest iovec array accepted by readv and writev
+#define MYOS_PROCESS_MAX_IOVEC 1024
+
+// file page cache, unreferenced pages beyond the limit are evicted least recently used first
+#define MYOS_PAGE_CACHE_BUCKETS 256
+#define MYOS_PAGE_CACHE_MAX_PAGES 4096
+#define MYOS_PAGE_CACHE_READAHEAD_MIN_PAGES 4
+#define MYOS_PAGE_CACHE_READAHEAD_MAX_PAGES 32
+
+// user virtual addresses where files are mapped, far above any identity mapped memory
+#define MYOS_PROCESS_MAP_VIRTUAL_ADDRESS 0x100000000000
+
+// path components cached by the dentry cache, least recently used entries are evicted first
+#define MYOS_DENTRY_CACHE_ENTRIES 128
+#define MYOS_DENTRY_CACHE_BUCKETS 64
+
+// largest FAT kept in memory, bigger FAT32 tables are read through the disk cache and mounted read only
+#define MYOS_FAT_MIRROR_MAX_BYTES 16777216
+
 #define MYOS_TOTAL_GDT_SEGMENTS 6
 
 #define MYOS_PROGRAM_VIRTUAL_ADDRESS 0x400000
@@ -56,6 +92,10 @@
 
 #define MYOS_KEYBOARD_BUFFER_SIZE 1024
 
+// dirty rectangles kept between presents, and the shortest time between two presents
+#define MYOS_GRAPHICS_MAX_DAMAGE_RECTS 32
+#define MYOS_GRAPHICS_FRAME_MICROSECONDS 16666
+
 #define WINDOW_MAX_TITLE_LENGTH 64
 #define WINDOW_BORDER_PIXEL_SIZE 2
 #define WINDOW_TITLE_BAR_HEIGHT 20
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include "bio.h"
+#include "disk.h"
+#include "driver.h"
+#include "queue.h"
+#include "status.h"
+#include "idt/idt.h"
+#include "task/task.h"
+#include "io/tsc.h"
+#include "memory/heap/kheap.h"
+#include "memory/memory.h"
+
+void bio_init(struct bio *bio, struct disk *disk, int direction, uint64_t lba)
+{
+	memset(bio, 0, sizeof(struct bio));
+	bio->disk = disk;
+	bio->direction = direction;
+	bio->lba = lba;
+}
+
+struct bio *bio_new(struct disk *disk, int direction, uint64_t lba)
+{
+	struct bio *bio = kzalloc(sizeof(struct bio));
+	if (!bio)
+	{
+		return NULL;
+	}
+
+	bio_init(bio, disk, direction, lba);
+	return bio;
+}
+
+void bio_free(struct bio *bio)
+{
+	kfree(bio);
+}
+
+int bio_add_segment(struct bio *bio, void *buf, uint32_t total_sectors)
+{
+	if (!buf || total_sectors == 0)
+	{
+		return -EINVARG;
+	}
+
+	// a buffer that continues the previous segment just grows it
+	if (bio->total_segments > 0)
+	{
+		struct bio_segment *last = &bio->segments[bio->total_segments - 1];
+		if ((uint8_t *)last->buf + (size_t)last->total_sectors * bio->disk->sector_size == buf)
+		{
+			last->total_sectors += total_sectors;
+			bio->total_sectors += total_sectors;
+			return 0;
+		}
+	}
+
+	if (bio->total_segments >= BIO_MAX_SEGMENTS)
+	{
+		return -ENOMEM;
+	}
+
+	bio->segments[bio->total_segments].buf = buf;
+	bio->segments[bio->total_segments].total_sectors = total_sectors;
+	bio->total_segments++;
+	bio->total_sectors += total_sectors;
+	return 0;
+}
+
+bool bio_done(struct bio *bio)
+{
+	return bio->status != BIO_STATUS_PENDING;
+}
+
+// drivers call this exactly once per bio, from any context
+void bio_complete(struct bio *bio, int status)
+{
+	bio->status = status > 0 ? -EIO : status;
+	if (bio->submitted_at)
+	{
+		disk_stats_record(bio->disk, bio->direction, bio->total_sectors, read_tsc() - bio->submitted_at, bio->status);
+	}
+
+	if (bio->completion)
+	{
+		bio->completion(bio);
+	}
+
+	task_wakeup(bio);
+}
+
+// runs a bio through the synchronous read and write hooks for drivers without a submit hook
+static int bio_submit_sync(struct bio *bio)
+{
+	int res = 0;
+	struct disk_driver *driver = bio->disk->driver;
+	uint64_t sector = bio->sector;
+	for (int i = 0; i < bio->total_segments; i++)
+	{
+		struct bio_segment *segment = &bio->segments[i];
+		if (bio->direction == BIO_WRITE)
+		{
+			res = driver->functions.write ? driver->functions.write(bio->disk, sector, segment->total_sectors, segment->buf) : -ERDONLY;
+		}
+		else
+		{
+			res = driver->functions.read ? driver->functions.read(bio->disk, sector, segment->total_sectors, segment->buf) : -EIO;
+		}
+
+		if (res < 0)
+		{
+			break;
+		}
+
+		sector += segment->total_sectors;
+	}
+
+	bio_complete(bio, res);
+	return 0;
+}
+
+// hands a bio straight to the driver, bypassing the request queue
+int bio_dispatch(struct bio *bio)
+{
+	bio->status = BIO_STATUS_PENDING;
+	if (bio->disk->driver->functions.submit)
+	{
+		return bio->disk->driver->functions.submit(bio->disk, bio);
+	}
+
+	return bio_submit_sync(bio);
+}
+
+int bio_submit(struct bio *bio)
+{
+	struct disk *disk = bio->disk;
+	if (!disk || !disk->driver || bio->total_segments == 0)
+	{
+		return -EINVARG;
+	}
+
+	bio->sector = disk->starting_lba + bio->lba;
+	// out of bounds check only if not primary disk
+	if (disk->starting_lba != 0 && disk->ending_lba != 0 && bio->sector + bio->total_sectors > disk->ending_lba)
+	{
+		return -EIO;
+	}
+
+	bio->status = BIO_STATUS_PENDING;
+	bio->next = NULL;
+	bio->submitted_at = read_tsc();
+	struct disk *hw = disk_hardware_disk(disk);
+	if (hw && hw->queue)
+	{
+		return disk_queue_add(hw->queue, bio);
+	}
+
+	return bio_dispatch(bio);
+}
+
+int bio_wait(struct bio *bio)
+{
+	// a plugged queue may still hold the bio back
+	struct disk *hw = disk_hardware_disk(bio->disk);
+	if (!bio_done(bio) && hw && hw->queue)
+	{
+		disk_queue_run(hw->queue);
+	}
+
+	if (!bio_done(bio))
+	{
+		// checking and halting must not race the completion interrupt
+		bool were_enabled = interrupts_enabled();
+		disable_interrupts();
+		while (!bio_done(bio))
+		{
+			task_wait_for_wakeup(bio);
+		}
+
+		if (were_enabled)
+		{
+			enable_interrupts();
+		}
+	}
+
+	return bio->status;
+}
+
+int bio_submit_wait(struct bio *bio)
+{
+	int res = bio_submit(bio);
+	if (res < 0)
+	{
+		return res;
+	}
+
+	return bio_wait(bio);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define BIO_MAX_SEGMENTS 16
+
+#define BIO_READ 0
+#define BIO_WRITE 1
+
+// status of a bio that has been submitted but not completed yet
+#define BIO_STATUS_PENDING 1
+
+struct disk;
+struct bio;
+
+typedef void (*BIO_COMPLETION)(struct bio *bio);
+
+struct bio_segment
+{
+	void *buf;
+	uint32_t total_sectors;
+};
+
+struct bio
+{
+	struct disk *disk; // disk the request was issued against, partitions included
+	int direction;	   // BIO_READ or BIO_WRITE
+
+	uint64_t lba;	 // first sector relative to the disk
+	uint64_t sector; // first sector on the hardware disk, filled in by bio_submit
+	uint32_t total_sectors;
+
+	// scatter gather list, segments are transferred back to back starting at sector
+	struct bio_segment segments[BIO_MAX_SEGMENTS];
+	int total_segments;
+
+	uint64_t submitted_at; // TSC at bio_submit, zero for bios that bypass it
+
+	// BIO_STATUS_PENDING while in flight, zero or a negative error once complete
+	volatile int status;
+
+	// called once the bio completes, possibly from interrupt context
+	BIO_COMPLETION completion;
+	void *private;
+
+	struct bio *next; // used by whoever currently owns the bio to queue it
+};
+
+void bio_init(struct bio *bio, struct disk *disk, int direction, uint64_t lba);
+struct bio *bio_new(struct disk *disk, int direction, uint64_t lba);
+void bio_free(struct bio *bio);
+int bio_add_segment(struct bio *bio, void *buf, uint32_t total_sectors);
+int bio_submit(struct bio *bio);
+int bio_dispatch(struct bio *bio);
+int bio_wait(struct bio *bio);
+int bio_submit_wait(struct bio *bio);
+void bio_complete(struct bio *bio, int status);
+bool bio_done(struct bio *bio);
@@ -8,6 +8,9 @@
 #include "memory/heap/kheap.h"
 #include "driver.h"
 #include "disk/streamer.h"
+#include "bio.h"
+#include "queue.h"
+#include "io/tsc.h"
 
 struct vector *disk_vector = NULL;	 // vector of all disks in the system
 struct disk *disk = NULL;			 // pointer to the primary disk
@@ -32,7 +35,8 @@ int disk_filesystem_mount(struct disk *disk)
 		char primary_drive_fs_name[11] = {0};
 		strncpy(primary_drive_fs_name, MYOS_KERNEL_FILESYSTEM_NAME, strlen(MYOS_KERNEL_FILESYSTEM_NAME));
 		disk->filesystem->volume_name(disk->fs_private, fs_name, sizeof(fs_name));
-		if (strncmp(fs_name, primary_drive_fs_name, sizeof(fs_name)) == 0)
+		// the first match wins, so a ramdisk copy of the system volume does not take over @:
+		if (!primary_fs_disk && strncmp(fs_name, primary_drive_fs_name, sizeof(fs_name)) == 0)
 		{
 			primary_fs_disk = disk;
 		}
@@ -93,8 +97,22 @@ int disk_create_new(struct disk_driver *driver, struct disk *hardware_disk, int
 	disk->driver = driver;
 	disk->driver_private = driver_private_data;
 	disk->hardware_disk = hardware_disk;
+	if (hardware_disk != disk)
+	{
+		disk->limits = hardware_disk->limits;
+	}
+
 	disk->id = vector_count(disk_vector);
 	disk->cache = diskstreamer_cache_new();
+	if (type == MYOS_DISK_TYPE_REAL)
+	{
+		disk->queue = disk_queue_new(disk);
+		if (!disk->queue)
+		{
+			res = -ENOMEM;
+			goto out;
+		}
+	}
 
 	if (out_disk)
 	{
@@ -168,27 +186,113 @@ struct disk *disk_get(int index)
 	return disk;
 }
 
-int disk_read_block(struct disk *idisk, unsigned int lba, int total, void *buf)
+static int disk_transfer_block(struct disk *idisk, int direction, unsigned int lba, int total, void *buf)
 {
-	size_t absolute_lba = idisk->starting_lba + lba;
-	size_t absolute_ending_lba = absolute_lba + total;
-	if (absolute_ending_lba > idisk->ending_lba)
+	if (total <= 0)
 	{
-		if (idisk->starting_lba != 0 && idisk->ending_lba != 0) // out of bounds check only if not primary disk
-		{
-			return -EIO;
-		}
+		return -EINVARG;
 	}
 
-	if (!idisk->driver->functions.read)
+	struct bio bio;
+	bio_init(&bio, idisk, direction, lba);
+	int res = bio_add_segment(&bio, buf, total);
+	if (res < 0)
 	{
-		return -EIO;
+		return res;
 	}
 
-	return idisk->driver->functions.read(idisk, absolute_lba, total, buf);
+	return bio_submit_wait(&bio);
+}
+
+int disk_read_block(struct disk *idisk, unsigned int lba, int total, void *buf)
+{
+	return disk_transfer_block(idisk, BIO_READ, lba, total, buf);
+}
+
+int disk_write_block(struct disk *idisk, unsigned int lba, int total, const void *buf)
+{
+	return disk_transfer_block(idisk, BIO_WRITE, lba, total, (void *)buf);
 }
 
 void *disk_private_data_driver(struct disk *disk)
 {
 	return disk->driver_private;
-}
\ No newline at end of file
+}
+
+static int disk_stats_latency_bucket(uint64_t latency)
+{
+	int bucket = 0;
+	while (latency > 1 && bucket < DISK_STATS_LATENCY_BUCKETS - 1)
+	{
+		latency >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+static void disk_stats_record_one(struct disk *disk, int direction, uint32_t total_sectors, uint64_t latency, int status)
+{
+	struct disk_io_stats *stats = direction == BIO_WRITE ? &disk->stats.write : &disk->stats.read;
+	stats->requests++;
+	if (status < 0)
+	{
+		stats->errors++;
+		return;
+	}
+
+	stats->sectors += total_sectors;
+	stats->bytes += (uint64_t)total_sectors * disk->sector_size;
+	stats->total_latency += latency;
+	stats->latency_histogram[disk_stats_latency_bucket(latency)]++;
+}
+
+void disk_stats_record(struct disk *disk, int direction, uint32_t total_sectors, uint64_t latency, int status)
+{
+	disk_stats_record_one(disk, direction, total_sectors, latency, status);
+	if (disk->hardware_disk && disk->hardware_disk != disk)
+	{
+		disk_stats_record_one(disk->hardware_disk, direction, total_sectors, latency, status);
+	}
+}
+
+void disk_stats_cache_lookup(struct disk *disk, bool hit)
+{
+	if (hit)
+	{
+		disk->stats.cache_hits++;
+	}
+	else
+	{
+		disk->stats.cache_misses++;
+	}
+}
+
+int disk_stats_info_get(int disk_id, struct disk_stats_info *info_out)
+{
+	struct disk *disk = disk_get(disk_id);
+	if (!disk)
+	{
+		return -ENOENT;
+	}
+
+	memset(info_out, 0, sizeof(struct disk_stats_info));
+	info_out->id = disk->id;
+	info_out->type = disk->type;
+	info_out->sector_size = disk->sector_size;
+	info_out->total_sectors = disk->type == MYOS_DISK_TYPE_PARTITION ? disk->ending_lba - disk->starting_lba : disk->limits.total_sectors;
+	info_out->tsc_frequency = tsc_frequency();
+	info_out->stats = disk->stats;
+
+	struct disk_queue_stats queue_stats;
+	if (disk->type == MYOS_DISK_TYPE_REAL && disk_queue_stats(disk, &queue_stats) == 0)
+	{
+		info_out->queue_dispatched = queue_stats.dispatched;
+		info_out->queue_front_merges = queue_stats.front_merges;
+		info_out->queue_back_merges = queue_stats.back_merges;
+		info_out->queue_max_depth = queue_stats.max_depth;
+		info_out->queue_service_time = queue_stats.service_time;
+	}
+
+	return 0;
+}
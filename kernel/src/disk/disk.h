@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 typedef unsigned int MYOS_DISK_TYPE;
 
@@ -16,8 +17,51 @@ typedef unsigned int MYOS_DISK_TYPE;
 // represents the kernel filesystem name
 #define MYOS_KERNEL_FILESYSTEM_NAME "MYOSFS     "
 
+// latency histograms use log2 buckets of TSC ticks
+#define DISK_STATS_LATENCY_BUCKETS 40
+
+// counters for one transfer direction, latencies are in TSC ticks
+struct disk_io_stats
+{
+	uint64_t requests;
+	uint64_t sectors;
+	uint64_t bytes;
+	uint64_t errors;
+	uint64_t total_latency;
+	uint64_t latency_histogram[DISK_STATS_LATENCY_BUCKETS]; // bucket n counts requests that took [2^n, 2^(n+1)) ticks
+};
+
+struct disk_stats
+{
+	struct disk_io_stats read;
+	struct disk_io_stats write;
+	uint64_t cache_hits; // streamer sector lookups served from the cache
+	uint64_t cache_misses;
+};
+
+// snapshot of a disk's statistics as returned to userland, mirrored in programs/stdlib/src/myos.h
+struct disk_stats_info
+{
+	int id;
+	int type;
+	int sector_size;
+	int reserved;
+	uint64_t total_sectors;
+	uint64_t tsc_frequency; // converts the latency ticks to time
+
+	struct disk_stats stats;
+
+	// request queue of the hardware disk, all zero for partitions
+	uint64_t queue_dispatched; // commands issued to the driver
+	uint64_t queue_front_merges;
+	uint64_t queue_back_merges;
+	uint64_t queue_max_depth;
+	uint64_t queue_service_time;
+};
+
 struct disk_driver;
 struct disk_stream_cache;
+struct disk_queue;
 struct disk
 {
 	MYOS_DISK_TYPE type;
@@ -32,12 +76,25 @@ struct disk
 	struct disk *hardware_disk; // the hardware disk this disk is attached to
 
 	struct disk_stream_cache *cache; // cache for disk streaming
+	struct disk_queue *queue;		 // request queue, only hardware disks own one
 
 	// set both to zero for primary disk
 	// all bounds checks are ignored if starting_lba and ending_lba are zero
 	size_t starting_lba; // starting LBA of this disk (for partitions)
 	size_t ending_lba;	 // ending LBA of this disk (for partitions)
 
+	// transfer limits reported by the hardware, in sectors. zero means the device imposes no limit
+	struct
+	{
+		size_t total_sectors;			// capacity of the hardware disk
+		uint32_t max_transfer_sectors;	// largest single request the device accepts
+		uint32_t boundary_sectors;		// requests should not cross a multiple of this
+		uint32_t write_granularity_sectors; // writes perform best in multiples of this
+	} limits;
+
+	// requests issued against this disk, a hardware disk also accumulates its partitions
+	struct disk_stats stats;
+
 	// private data of our filesystem
 	void *fs_private;
 
@@ -48,6 +105,7 @@ struct disk
 int disk_search_and_init();
 struct disk *disk_get(int index);
 int disk_read_block(struct disk *idisk, unsigned int lba, int total, void *buf);
+int disk_write_block(struct disk *idisk, unsigned int lba, int total, const void *buf);
 int disk_create_new(struct disk_driver *driver, struct disk *hardware_disk, int type, int starting_lba, int ending_lba, size_t sector_size, void *driver_private_data, struct disk **out_disk);
 struct disk *disk_primary_fs_disk();
 struct disk *disk_primary();
@@ -56,4 +114,7 @@ int disk_filesystem_mount(struct disk *disk);
 int disk_create_partition(struct disk *disk, uint64_t starting_lba, uint64_t ending_lba, struct disk **partition_disk_out);
 void *disk_private_data_driver(struct disk *disk);
 long disk_real_sector(struct disk *idisk, unsigned int lba);
-long disk_real_offset(struct disk *idisk, unsigned int lba);
\ No newline at end of file
+long disk_real_offset(struct disk *idisk, unsigned int lba);
+void disk_stats_record(struct disk *disk, int direction, uint32_t total_sectors, uint64_t latency, int status);
+void disk_stats_cache_lookup(struct disk *disk, bool hit);
+int disk_stats_info_get(int disk_id, struct disk_stats_info *info_out);
\ No newline at end of file
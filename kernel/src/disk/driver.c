@@ -5,6 +5,9 @@
 #include "disk.h"
 #include "drivers/pata.h"
 #include "drivers/nvme.h"
+#include "drivers/ahci.h"
+#include "drivers/virtio_blk.h"
+#include "drivers/ramdisk.h"
 #include "status.h"
 
 struct vector *disk_driver_vec = NULL; // vector of all disk drivers in the system
@@ -27,6 +30,27 @@ int disk_driver_system_load_drivers()
 		goto out;
 	}
 
+	// register AHCI SATA
+	res = disk_driver_register(ahci_driver_init());
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	// register virtio-blk
+	res = disk_driver_register(virtio_blk_driver_init());
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	// register RAM disks
+	res = disk_driver_register(ramdisk_driver_init());
+	if (res < 0)
+	{
+		goto out;
+	}
+
 out:
 	return res;
 }
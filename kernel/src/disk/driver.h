@@ -7,6 +7,7 @@
 
 struct disk;
 struct disk_driver;
+struct bio;
 
 typedef int (*DISK_DRIVER_LOADED)(struct disk_driver *driver);
 typedef void (*DISK_DRIVER_UNLOADED)(struct disk_driver *driver);
@@ -16,6 +17,8 @@ typedef void (*DISK_DRIVER_UNMOUNT)(struct disk *disk);
 
 typedef int (*DISK_DRIVER_WRITE)(struct disk *disk, uint64_t lba, uint32_t total_sectors, const void *buf);
 typedef int (*DISK_DRIVER_READ)(struct disk *disk, uint64_t lba, uint32_t total_sectors, void *buf);
+// queues a bio and returns immediately, the driver calls bio_complete when the transfer finishes
+typedef int (*DISK_DRIVER_SUBMIT)(struct disk *disk, struct bio *bio);
 typedef int (*DISK_DRIVER_MOUNT_PARTITION)(struct disk *disk, uint64_t starting_lba, uint64_t ending_lba, struct disk **partition_disk_out);
 
 struct disk_driver
@@ -30,6 +33,7 @@ struct disk_driver
 		DISK_DRIVER_UNMOUNT unmount;				 // called when a disk is unmounted, used for cleanup
 		DISK_DRIVER_READ read;						 // called to read from a disk
 		DISK_DRIVER_WRITE write;					 // called to write to a disk
+		DISK_DRIVER_SUBMIT submit;					 // optional asynchronous entry point, read and write are used when NULL
 		DISK_DRIVER_MOUNT_PARTITION mount_partition; // called to mount a partition on a hardware disk, used for partition discovery and mounting
 	} functions;
 
@@ -0,0 +1,676 @@
+#include "ahci.h"
+#include "status.h"
+#include "kernel.h"
+#include "io/pci.h"
+#include "io/apic.h"
+#include "idt/idt.h"
+#include "task/task.h"
+#include "disk/streamer.h"
+#include "memory/heap/kheap.h"
+#include "memory/paging/paging.h"
+#include "memory/memory.h"
+
+static inline uint32_t ahci_read(struct ahci_hba *hba, uint32_t off)
+{
+	return *((volatile uint32_t *)(hba->base + off));
+}
+
+static inline void ahci_write(struct ahci_hba *hba, uint32_t off, uint32_t value)
+{
+	*((volatile uint32_t *)(hba->base + off)) = value;
+}
+
+static inline uint32_t ahci_port_read(struct ahci_port *port, uint32_t reg)
+{
+	return ahci_read(port->hba, port->registers + reg);
+}
+
+static inline void ahci_port_write(struct ahci_port *port, uint32_t reg, uint32_t value)
+{
+	ahci_write(port->hba, port->registers + reg, value);
+}
+
+static bool ahci_pci_device(struct pci_device *dev)
+{
+	return dev->class.base == AHCI_PCI_BASE_CLASS && dev->class.subclass == AHCI_PCI_SUBCLASS;
+}
+
+static void ahci_map_mmio(struct ahci_hba *hba)
+{
+	uintptr_t base = (uintptr_t)hba->base;
+	uint64_t size = hba->device->bars[AHCI_ABAR].size ? hba->device->bars[AHCI_ABAR].size : 0x2000; // port 31 ends at 0x1100
+	const uint32_t flags = PAGING_IS_PRESENT | PAGING_IS_WRITEABLE | PAGING_CACHE_DISABLED;
+	for (uintptr_t off = 0; off < size; off += PAGING_PAGE_SIZE)
+	{
+		paging_map(kernel_desc(), (void *)(base + off), (void *)(base + off), flags);
+	}
+}
+
+// acknowledges the port interrupts before the HBA level summary bit as the specification requires
+static void ahci_interrupt_handler(struct interrupt_frame *frame, void *private)
+{
+	struct ahci_hba *hba = private;
+	uint32_t pending = ahci_read(hba, AHCI_HBA_REGISTER_IS);
+	for (int i = 0; i < AHCI_MAX_PORTS; i++)
+	{
+		if (!(pending & (1u << i)))
+		{
+			continue;
+		}
+
+		uint32_t registers = AHCI_PORT_REGISTERS(i);
+		ahci_write(hba, registers + AHCI_PORT_REGISTER_IS, ahci_read(hba, registers + AHCI_PORT_REGISTER_IS));
+		if (hba->ports[i])
+		{
+			task_wakeup(hba->ports[i]);
+		}
+	}
+
+	ahci_write(hba, AHCI_HBA_REGISTER_IS, pending);
+	hba->irq.count++;
+}
+
+// route HBA interrupts through MSI, failure is not fatal as the driver falls back to polling
+static int ahci_interrupts_init(struct ahci_hba *hba)
+{
+	int res = 0;
+	if (!apic_enabled())
+	{
+		res = -EUNIMP;
+		goto out;
+	}
+
+	int vector = idt_allocate_vector(ahci_interrupt_handler, hba);
+	if (vector < 0)
+	{
+		res = vector;
+		goto out;
+	}
+
+	res = pci_msi_enable(hba->device, vector, apic_id());
+	if (res < 0)
+	{
+		idt_free_vector(vector);
+		goto out;
+	}
+
+	hba->irq.vector = vector;
+
+out:
+	return res;
+}
+
+static int ahci_hba_reset(struct ahci_hba *hba)
+{
+	ahci_write(hba, AHCI_HBA_REGISTER_GHC, ahci_read(hba, AHCI_HBA_REGISTER_GHC) | AHCI_HBA_GHC_AE);
+	ahci_write(hba, AHCI_HBA_REGISTER_GHC, ahci_read(hba, AHCI_HBA_REGISTER_GHC) | AHCI_HBA_GHC_HR);
+	for (uint32_t i = 0; i < AHCI_RESET_TIMEOUT_ITERATIONS && (ahci_read(hba, AHCI_HBA_REGISTER_GHC) & AHCI_HBA_GHC_HR); i++)
+	{
+		__asm__ volatile("pause");
+	}
+
+	if (ahci_read(hba, AHCI_HBA_REGISTER_GHC) & AHCI_HBA_GHC_HR)
+	{
+		return -ETIMEOUT;
+	}
+
+	// the reset clears AHCI enable, switch back into AHCI mode
+	ahci_write(hba, AHCI_HBA_REGISTER_GHC, ahci_read(hba, AHCI_HBA_REGISTER_GHC) | AHCI_HBA_GHC_AE);
+	return 0;
+}
+
+static int ahci_port_stop(struct ahci_port *port)
+{
+	ahci_port_write(port, AHCI_PORT_REGISTER_CMD, ahci_port_read(port, AHCI_PORT_REGISTER_CMD) & ~(AHCI_PORT_CMD_ST | AHCI_PORT_CMD_FRE));
+	for (uint32_t i = 0; i < AHCI_RESET_TIMEOUT_ITERATIONS; i++)
+	{
+		if (!(ahci_port_read(port, AHCI_PORT_REGISTER_CMD) & (AHCI_PORT_CMD_CR | AHCI_PORT_CMD_FR)))
+		{
+			return 0;
+		}
+
+		__asm__ volatile("pause");
+	}
+
+	return -ETIMEOUT;
+}
+
+static void ahci_port_start(struct ahci_port *port)
+{
+	for (uint32_t i = 0; i < AHCI_RESET_TIMEOUT_ITERATIONS && (ahci_port_read(port, AHCI_PORT_REGISTER_TFD) & (AHCI_PORT_TFD_BSY | AHCI_PORT_TFD_DRQ)); i++)
+	{
+		__asm__ volatile("pause");
+	}
+
+	uint32_t cmd = ahci_port_read(port, AHCI_PORT_REGISTER_CMD);
+	cmd |= AHCI_PORT_CMD_FRE;
+	ahci_port_write(port, AHCI_PORT_REGISTER_CMD, cmd);
+	cmd |= AHCI_PORT_CMD_ST;
+	ahci_port_write(port, AHCI_PORT_REGISTER_CMD, cmd);
+}
+
+// a failed command halts the port, restart it so later commands can be issued
+static void ahci_port_recover(struct ahci_port *port)
+{
+	ahci_port_stop(port);
+	ahci_port_write(port, AHCI_PORT_REGISTER_SERR, 0xFFFFFFFF);
+	ahci_port_write(port, AHCI_PORT_REGISTER_IS, 0xFFFFFFFF);
+	ahci_port_start(port);
+}
+
+static void ahci_fis_build(struct ahci_fis_reg_h2d *fis, uint8_t command, uint64_t lba, uint32_t total_sectors, int tag)
+{
+	memset(fis, 0, sizeof(struct ahci_fis_reg_h2d));
+	fis->type = AHCI_FIS_TYPE_REG_H2D;
+	fis->flags = AHCI_FIS_H2D_COMMAND;
+	fis->command = command;
+	fis->device = AHCI_FIS_DEVICE_LBA;
+	fis->lba0 = (uint8_t)(lba & 0xFF);
+	fis->lba1 = (uint8_t)((lba >> 8) & 0xFF);
+	fis->lba2 = (uint8_t)((lba >> 16) & 0xFF);
+	fis->lba3 = (uint8_t)((lba >> 24) & 0xFF);
+	fis->lba4 = (uint8_t)((lba >> 32) & 0xFF);
+	fis->lba5 = (uint8_t)((lba >> 40) & 0xFF);
+
+	if (command == AHCI_ATA_COMMAND_READ_FPDMA_QUEUED || command == AHCI_ATA_COMMAND_WRITE_FPDMA_QUEUED)
+	{
+		// queued commands carry the sector count in the feature field and the tag in the count field
+		fis->feature_low = (uint8_t)(total_sectors & 0xFF);
+		fis->feature_high = (uint8_t)((total_sectors >> 8) & 0xFF);
+		fis->count_low = (uint8_t)(tag << 3);
+	}
+	else
+	{
+		fis->count_low = (uint8_t)(total_sectors & 0xFF);
+		fis->count_high = (uint8_t)((total_sectors >> 8) & 0xFF);
+	}
+}
+
+// fills the command header and table of a slot, the buffer must be identity mapped kernel memory
+static int ahci_command_build(struct ahci_port *port, int slot, uint8_t command, uint64_t lba, uint32_t total_sectors, void *buf, size_t total_bytes, bool write)
+{
+	struct ahci_command_header *header = &port->command_list[slot];
+	struct ahci_command_table *table = &port->command_tables[slot];
+	uintptr_t addr = (uintptr_t)buf;
+	if (addr & 0x01)
+	{
+		return -EINVARG; // data base addresses must be word aligned
+	}
+
+	if (!(port->hba->capabilities & AHCI_HBA_CAP_S64A) && addr + total_bytes > 0x100000000ull)
+	{
+		return -EUNIMP;
+	}
+
+	memset(table, 0, sizeof(struct ahci_command_table));
+	uint16_t entries = 0;
+	while (total_bytes > 0)
+	{
+		if (entries >= AHCI_PRDT_ENTRIES)
+		{
+			return -EINVARG;
+		}
+
+		size_t chunk = total_bytes > AHCI_PRDT_MAX_BYTES ? AHCI_PRDT_MAX_BYTES : total_bytes;
+		table->prdt[entries].data_base = (uint32_t)(addr & 0xFFFFFFFFu);
+		table->prdt[entries].data_base_upper = (uint32_t)((uint64_t)addr >> 32);
+		table->prdt[entries].byte_count = (uint32_t)(chunk - 1);
+		addr += chunk;
+		total_bytes -= chunk;
+		entries++;
+	}
+
+	ahci_fis_build((struct ahci_fis_reg_h2d *)table->command_fis, command, lba, total_sectors, slot);
+	header->flags = (uint16_t)(sizeof(struct ahci_fis_reg_h2d) / sizeof(uint32_t));
+	if (write)
+	{
+		header->flags |= AHCI_COMMAND_HEADER_WRITE;
+	}
+
+	header->prdt_length = entries;
+	header->prd_byte_count = 0;
+	return 0;
+}
+
+static bool ahci_port_commands_finished(struct ahci_port *port, uint32_t slots)
+{
+	uint32_t outstanding = ahci_port_read(port, AHCI_PORT_REGISTER_SACT) | ahci_port_read(port, AHCI_PORT_REGISTER_CI);
+	return (outstanding & slots) == 0 || (ahci_port_read(port, AHCI_PORT_REGISTER_TFD) & AHCI_PORT_TFD_ERR);
+}
+
+// spin briefly, then halt until the HBA interrupt arrives. until an interrupt has been seen we keep polling
+static int ahci_port_wait(struct ahci_port *port, uint32_t slots)
+{
+	for (uint32_t i = 0; i < AHCI_POLL_SPIN_ITERATIONS; i++)
+	{
+		if (ahci_port_commands_finished(port, slots))
+		{
+			return 0;
+		}
+
+		__asm__ volatile("pause");
+	}
+
+	if (port->hba->irq.verified)
+	{
+		bool were_enabled = interrupts_enabled();
+		disable_interrupts();
+		for (uint32_t i = 0; i < AHCI_INTERRUPT_WAIT_MAX_WAKEUPS && !ahci_port_commands_finished(port, slots); i++)
+		{
+			task_wait_for_wakeup(port);
+		}
+
+		if (were_enabled)
+		{
+			enable_interrupts();
+		}
+	}
+	else
+	{
+		for (uint32_t i = AHCI_POLL_SPIN_ITERATIONS; i < AHCI_POLL_TIMEOUT_ITERATIONS && !ahci_port_commands_finished(port, slots); i++)
+		{
+			__asm__ volatile("pause");
+		}
+	}
+
+	return ahci_port_commands_finished(port, slots) ? 0 : -ETIMEOUT;
+}
+
+// issues every built slot at once and waits for all of them to complete
+static int ahci_port_issue(struct ahci_port *port, uint32_t slots, bool queued)
+{
+	if (queued)
+	{
+		ahci_port_write(port, AHCI_PORT_REGISTER_SACT, slots);
+	}
+
+	ahci_port_write(port, AHCI_PORT_REGISTER_CI, slots);
+
+	int res = ahci_port_wait(port, slots);
+	ahci_port_write(port, AHCI_PORT_REGISTER_IS, ahci_port_read(port, AHCI_PORT_REGISTER_IS));
+	if (res == 0 && (ahci_port_read(port, AHCI_PORT_REGISTER_TFD) & AHCI_PORT_TFD_ERR))
+	{
+		res = -EIO;
+	}
+
+	if (res < 0)
+	{
+		ahci_port_recover(port);
+	}
+
+	if (port->hba->irq.count)
+	{
+		port->hba->irq.verified = true;
+	}
+
+	return res;
+}
+
+static int ahci_port_init(struct ahci_hba *hba, int index, struct ahci_port **port_out)
+{
+	int res = 0;
+	struct ahci_port *port = kzalloc(sizeof(struct ahci_port));
+	if (!port)
+	{
+		res = -ENOMEM;
+		goto out;
+	}
+
+	port->hba = hba;
+	port->index = index;
+	port->registers = AHCI_PORT_REGISTERS(index);
+	port->sector_size = AHCI_SECTOR_SIZE;
+	port->queue_depth = 1;
+
+	// spin up the device and wait for the link to come up
+	ahci_port_write(port, AHCI_PORT_REGISTER_CMD, ahci_port_read(port, AHCI_PORT_REGISTER_CMD) | AHCI_PORT_CMD_SUD | AHCI_PORT_CMD_POD);
+	for (uint32_t i = 0; i < AHCI_RESET_TIMEOUT_ITERATIONS && (ahci_port_read(port, AHCI_PORT_REGISTER_SSTS) & 0x0F) != AHCI_PORT_SSTS_DET_PRESENT; i++)
+	{
+		__asm__ volatile("pause");
+	}
+
+	uint32_t ssts = ahci_port_read(port, AHCI_PORT_REGISTER_SSTS);
+	if ((ssts & 0x0F) != AHCI_PORT_SSTS_DET_PRESENT || ((ssts >> 8) & 0x0F) != AHCI_PORT_SSTS_IPM_ACTIVE)
+	{
+		res = -ENOENT; // nothing attached
+		goto out;
+	}
+
+	res = ahci_port_stop(port);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	// the command list takes the first kilobyte of the page and the received FIS area follows it
+	port->command_list = kzalloc(PAGING_PAGE_SIZE);
+	port->command_tables = kzalloc(sizeof(struct ahci_command_table) * AHCI_MAX_COMMAND_SLOTS);
+	if (!port->command_list || !port->command_tables)
+	{
+		res = -ENOMEM;
+		goto out;
+	}
+
+	port->received_fis = (uint8_t *)port->command_list + sizeof(struct ahci_command_header) * AHCI_MAX_COMMAND_SLOTS;
+	for (int i = 0; i < AHCI_MAX_COMMAND_SLOTS; i++)
+	{
+		uint64_t table = (uint64_t)(uintptr_t)&port->command_tables[i];
+		port->command_list[i].command_table_base = (uint32_t)(table & 0xFFFFFFFFu);
+		port->command_list[i].command_table_base_upper = (uint32_t)(table >> 32);
+	}
+
+	uint64_t command_list = (uint64_t)(uintptr_t)port->command_list;
+	uint64_t received_fis = (uint64_t)(uintptr_t)port->received_fis;
+	ahci_port_write(port, AHCI_PORT_REGISTER_CLB, (uint32_t)(command_list & 0xFFFFFFFFu));
+	ahci_port_write(port, AHCI_PORT_REGISTER_CLBU, (uint32_t)(command_list >> 32));
+	ahci_port_write(port, AHCI_PORT_REGISTER_FB, (uint32_t)(received_fis & 0xFFFFFFFFu));
+	ahci_port_write(port, AHCI_PORT_REGISTER_FBU, (uint32_t)(received_fis >> 32));
+	ahci_port_write(port, AHCI_PORT_REGISTER_SERR, 0xFFFFFFFF);
+	ahci_port_write(port, AHCI_PORT_REGISTER_IS, 0xFFFFFFFF);
+	ahci_port_write(port, AHCI_PORT_REGISTER_IE, AHCI_PORT_IE_DEFAULT);
+	ahci_port_start(port);
+
+	if (ahci_port_read(port, AHCI_PORT_REGISTER_SIG) != AHCI_PORT_SIG_ATA)
+	{
+		res = -EUNIMP; // ATAPI, port multipliers and enclosures are not supported
+		goto out;
+	}
+
+	*port_out = port;
+
+out:
+	if (res < 0 && port)
+	{
+		if (port->command_list)
+		{
+			ahci_port_stop(port);
+		}
+
+		kfree(port->command_list);
+		kfree(port->command_tables);
+		kfree(port);
+	}
+
+	return res;
+}
+
+// stops a port set up by ahci_port_init and releases its command memory
+static void ahci_port_free(struct ahci_port *port)
+{
+	ahci_port_stop(port);
+	port->hba->ports[port->index] = NULL;
+	kfree(port->command_list);
+	kfree(port->command_tables);
+	kfree(port);
+}
+
+static int ahci_port_identify(struct ahci_port *port)
+{
+	int res = 0;
+	uint16_t *identify = kzalloc(AHCI_SECTOR_SIZE);
+	if (!identify)
+	{
+		res = -ENOMEM;
+		goto out;
+	}
+
+	res = ahci_command_build(port, 0, AHCI_ATA_COMMAND_IDENTIFY, 0, 0, identify, AHCI_SECTOR_SIZE, false);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = ahci_port_issue(port, 1u << 0, false);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	port->lba48 = (identify[AHCI_IDENTIFY_WORD_COMMAND_SETS] & AHCI_IDENTIFY_COMMAND_SETS_LBA48) != 0;
+	if (!port->lba48)
+	{
+		res = -EUNIMP; // the DMA EXT and FPDMA commands all need 48 bit addressing
+		goto out;
+	}
+
+	port->total_sectors = (uint64_t)identify[AHCI_IDENTIFY_WORD_LBA48_SECTORS] |
+						  ((uint64_t)identify[AHCI_IDENTIFY_WORD_LBA48_SECTORS + 1] << 16) |
+						  ((uint64_t)identify[AHCI_IDENTIFY_WORD_LBA48_SECTORS + 2] << 32) |
+						  ((uint64_t)identify[AHCI_IDENTIFY_WORD_LBA48_SECTORS + 3] << 48);
+
+	// word 106 is only valid with bit 14 set and bit 15 clear, bit 12 announces logical sectors above 512 bytes
+	uint16_t sector_size_info = identify[AHCI_IDENTIFY_WORD_SECTOR_SIZE];
+	if ((sector_size_info & 0xC000) == 0x4000 && (sector_size_info & 0x1000))
+	{
+		uint32_t words = (uint32_t)identify[AHCI_IDENTIFY_WORD_LOGICAL_SECTOR_SIZE] |
+						 ((uint32_t)identify[AHCI_IDENTIFY_WORD_LOGICAL_SECTOR_SIZE + 1] << 16);
+		if (words * 2 > DISK_STREAMER_MAX_CACHE_SECTOR_SIZE)
+		{
+			res = -EUNIMP;
+			goto out;
+		}
+
+		port->sector_size = (int)(words * 2);
+	}
+
+	bool drive_ncq = (identify[AHCI_IDENTIFY_WORD_SATA_CAPABILITIES] & AHCI_IDENTIFY_SATA_CAPABILITIES_NCQ) != 0;
+	port->ncq = drive_ncq && (port->hba->capabilities & AHCI_HBA_CAP_SNCQ);
+	if (port->ncq)
+	{
+		uint32_t drive_depth = (identify[AHCI_IDENTIFY_WORD_QUEUE_DEPTH] & 0x1F) + 1u;
+		port->queue_depth = drive_depth < port->hba->command_slots ? drive_depth : port->hba->command_slots;
+	}
+
+out:
+	kfree(identify);
+	return res;
+}
+
+// large requests are fanned out over the command slots, with NCQ the drive services them concurrently
+static int ahci_port_transfer(struct ahci_port *port, uint64_t lba, uint32_t total_sectors, void *buf, bool write)
+{
+	int res = 0;
+	if (port->total_sectors && lba + total_sectors > port->total_sectors)
+	{
+		return -EIO;
+	}
+
+	uint8_t command = 0;
+	if (port->ncq)
+	{
+		command = write ? AHCI_ATA_COMMAND_WRITE_FPDMA_QUEUED : AHCI_ATA_COMMAND_READ_FPDMA_QUEUED;
+	}
+	else
+	{
+		command = write ? AHCI_ATA_COMMAND_WRITE_DMA_EXT : AHCI_ATA_COMMAND_READ_DMA_EXT;
+	}
+
+	uint8_t *current_buf = buf;
+	while (total_sectors > 0)
+	{
+		uint32_t slots = 0;
+		for (uint32_t slot = 0; slot < port->queue_depth && total_sectors > 0; slot++)
+		{
+			uint32_t chunk = total_sectors > AHCI_MAX_SECTORS_PER_COMMAND ? AHCI_MAX_SECTORS_PER_COMMAND : total_sectors;
+			size_t total_bytes = (size_t)chunk * port->sector_size;
+			res = ahci_command_build(port, slot, command, lba, chunk, current_buf, total_bytes, write);
+			if (res < 0)
+			{
+				goto out;
+			}
+
+			slots |= 1u << slot;
+			lba += chunk;
+			current_buf += total_bytes;
+			total_sectors -= chunk;
+		}
+
+		res = ahci_port_issue(port, slots, port->ncq);
+		if (res < 0)
+		{
+			goto out;
+		}
+	}
+
+	if (write)
+	{
+		// the data only counts as written once the drive has flushed its write cache
+		res = ahci_command_build(port, 0, AHCI_ATA_COMMAND_FLUSH_CACHE_EXT, 0, 0, NULL, 0, false);
+		if (res < 0)
+		{
+			goto out;
+		}
+
+		res = ahci_port_issue(port, 1u << 0, false);
+	}
+
+out:
+	return res;
+}
+
+static int ahci_disk_driver_mount_for_device(struct disk_driver *driver, struct pci_device *dev)
+{
+	int res = 0;
+	uint64_t abar = pci_device_bar_address(dev, AHCI_ABAR);
+	if (!abar || dev->bars[AHCI_ABAR].type != PCI_DEVICE_IO_MEMORY)
+	{
+		return -EIO;
+	}
+
+	struct ahci_hba *hba = kzalloc(sizeof(struct ahci_hba));
+	if (!hba)
+	{
+		return -ENOMEM;
+	}
+
+	hba->device = dev;
+	hba->base = (volatile uint8_t *)(uintptr_t)abar;
+	pci_enable_bus_master(dev);
+	ahci_map_mmio(hba);
+
+	res = ahci_hba_reset(hba);
+	if (res < 0)
+	{
+		kfree(hba);
+		return res;
+	}
+
+	hba->capabilities = ahci_read(hba, AHCI_HBA_REGISTER_CAP);
+	hba->command_slots = AHCI_HBA_CAP_NCS(hba->capabilities);
+
+	// interrupts are optional, on failure completions are polled
+	ahci_interrupts_init(hba);
+
+	uint32_t implemented = ahci_read(hba, AHCI_HBA_REGISTER_PI);
+	for (int i = 0; i < AHCI_MAX_PORTS; i++)
+	{
+		if (!(implemented & (1u << i)))
+		{
+			continue;
+		}
+
+		struct ahci_port *port = NULL;
+		if (ahci_port_init(hba, i, &port) < 0)
+		{
+			continue;
+		}
+
+		hba->ports[i] = port;
+		if (ahci_port_identify(port) < 0)
+		{
+			ahci_port_free(port);
+			continue;
+		}
+
+		res = disk_create_new(driver, NULL, MYOS_DISK_TYPE_REAL, 0, 0, port->sector_size, port, &port->disk);
+		if (res < 0)
+		{
+			ahci_port_free(port);
+			break;
+		}
+
+		port->disk->limits.total_sectors = port->total_sectors;
+		port->disk->limits.max_transfer_sectors = AHCI_MAX_SECTORS_PER_COMMAND * port->queue_depth;
+	}
+
+	if (hba->irq.vector)
+	{
+		ahci_write(hba, AHCI_HBA_REGISTER_IS, 0xFFFFFFFF);
+		ahci_write(hba, AHCI_HBA_REGISTER_GHC, ahci_read(hba, AHCI_HBA_REGISTER_GHC) | AHCI_HBA_GHC_IE);
+	}
+
+	return res;
+}
+
+static int ahci_disk_driver_mount(struct disk_driver *driver)
+{
+	int res = 0;
+	size_t total_pci = pci_device_count();
+	for (size_t i = 0; i < total_pci; i++)
+	{
+		struct pci_device *dev = NULL;
+		res = pci_device_get(i, &dev);
+		if (res < 0)
+		{
+			break;
+		}
+
+		if (ahci_pci_device(dev))
+		{
+			res = ahci_disk_driver_mount_for_device(driver, dev);
+			if (res < 0)
+			{
+				break;
+			}
+		}
+	}
+
+	return res;
+}
+
+static void ahci_disk_driver_unmount(struct disk *disk)
+{
+	struct ahci_port *port = disk_private_data_driver(disk);
+	if (!port || disk->type != MYOS_DISK_TYPE_REAL)
+	{
+		return;
+	}
+
+	ahci_port_free(port);
+	disk->driver_private = NULL;
+}
+
+static int ahci_disk_driver_read(struct disk *disk, uint64_t lba, uint32_t total_sectors, void *buf)
+{
+	struct disk *hw = disk_hardware_disk(disk);
+	return ahci_port_transfer(disk_private_data_driver(hw), lba, total_sectors, buf, false);
+}
+
+static int ahci_disk_driver_write(struct disk *disk, uint64_t lba, uint32_t total_sectors, const void *buf)
+{
+	struct disk *hw = disk_hardware_disk(disk);
+	return ahci_port_transfer(disk_private_data_driver(hw), lba, total_sectors, (void *)buf, true);
+}
+
+static int ahci_disk_driver_mount_partition(struct disk *disk, uint64_t starting_lba, uint64_t ending_lba, struct disk **partition_disk_out)
+{
+	return disk_create_new(disk->driver, disk->hardware_disk, MYOS_DISK_TYPE_PARTITION, starting_lba, ending_lba, disk->sector_size, NULL, partition_disk_out);
+}
+
+static struct disk_driver ahci_driver = {
+	.name = "AHCI",
+	.functions = {
+		.loaded = NULL,
+		.unloaded = NULL,
+		.mount = ahci_disk_driver_mount,
+		.unmount = ahci_disk_driver_unmount,
+		.read = ahci_disk_driver_read,
+		.write = ahci_disk_driver_write,
+		.mount_partition = ahci_disk_driver_mount_partition,
+	},
+};
+
+struct disk_driver *ahci_driver_init()
+{
+	return &ahci_driver;
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "disk.h"
+#include "driver.h"
+
+#define AHCI_PCI_BASE_CLASS 0x01
+#define AHCI_PCI_SUBCLASS 0x06
+#define AHCI_ABAR 5 // the HBA registers live behind BAR5
+#define AHCI_SECTOR_SIZE 512
+
+#define AHCI_MAX_PORTS 32
+#define AHCI_MAX_COMMAND_SLOTS 32
+
+// generic host control registers
+#define AHCI_HBA_REGISTER_CAP 0x00
+#define AHCI_HBA_REGISTER_GHC 0x04
+#define AHCI_HBA_REGISTER_IS 0x08
+#define AHCI_HBA_REGISTER_PI 0x0C
+
+#define AHCI_HBA_CAP_SNCQ (1u << 30)
+#define AHCI_HBA_CAP_S64A (1u << 31)
+#define AHCI_HBA_CAP_NCS(cap) ((((cap) >> 8) & 0x1Fu) + 1u)
+
+#define AHCI_HBA_GHC_HR (1u << 0)
+#define AHCI_HBA_GHC_IE (1u << 1)
+#define AHCI_HBA_GHC_AE (1u << 31)
+
+// port registers, every port owns a 0x80 byte register block starting at 0x100
+#define AHCI_PORT_REGISTERS(port) (0x100u + (port) * 0x80u)
+#define AHCI_PORT_REGISTER_CLB 0x00
+#define AHCI_PORT_REGISTER_CLBU 0x04
+#define AHCI_PORT_REGISTER_FB 0x08
+#define AHCI_PORT_REGISTER_FBU 0x0C
+#define AHCI_PORT_REGISTER_IS 0x10
+#define AHCI_PORT_REGISTER_IE 0x14
+#define AHCI_PORT_REGISTER_CMD 0x18
+#define AHCI_PORT_REGISTER_TFD 0x20
+#define AHCI_PORT_REGISTER_SIG 0x24
+#define AHCI_PORT_REGISTER_SSTS 0x28
+#define AHCI_PORT_REGISTER_SERR 0x30
+#define AHCI_PORT_REGISTER_SACT 0x34
+#define AHCI_PORT_REGISTER_CI 0x38
+
+#define AHCI_PORT_CMD_ST (1u << 0)
+#define AHCI_PORT_CMD_SUD (1u << 1)
+#define AHCI_PORT_CMD_POD (1u << 2)
+#define AHCI_PORT_CMD_FRE (1u << 4)
+#define AHCI_PORT_CMD_FR (1u << 14)
+#define AHCI_PORT_CMD_CR (1u << 15)
+
+#define AHCI_PORT_IS_DHRS (1u << 0) // device to host register FIS received
+#define AHCI_PORT_IS_PSS (1u << 1)	// PIO setup FIS received
+#define AHCI_PORT_IS_SDBS (1u << 3) // set device bits FIS received, signals NCQ completions
+#define AHCI_PORT_IS_TFES (1u << 30)
+#define AHCI_PORT_IE_DEFAULT (AHCI_PORT_IS_DHRS | AHCI_PORT_IS_PSS | AHCI_PORT_IS_SDBS | AHCI_PORT_IS_TFES)
+
+#define AHCI_PORT_TFD_ERR 0x01
+#define AHCI_PORT_TFD_DRQ 0x08
+#define AHCI_PORT_TFD_BSY 0x80
+
+#define AHCI_PORT_SSTS_DET_PRESENT 0x3
+#define AHCI_PORT_SSTS_IPM_ACTIVE 0x1
+#define AHCI_PORT_SIG_ATA 0x00000101
+
+#define AHCI_FIS_TYPE_REG_H2D 0x27
+#define AHCI_FIS_H2D_COMMAND 0x80
+#define AHCI_FIS_DEVICE_LBA 0x40
+#define AHCI_FIS_DEVICE_FUA 0x80
+
+#define AHCI_ATA_COMMAND_READ_DMA_EXT 0x25
+#define AHCI_ATA_COMMAND_WRITE_DMA_EXT 0x35
+#define AHCI_ATA_COMMAND_READ_FPDMA_QUEUED 0x60
+#define AHCI_ATA_COMMAND_WRITE_FPDMA_QUEUED 0x61
+#define AHCI_ATA_COMMAND_FLUSH_CACHE_EXT 0xEA
+#define AHCI_ATA_COMMAND_IDENTIFY 0xEC
+
+// IDENTIFY DEVICE words we care about
+#define AHCI_IDENTIFY_WORD_QUEUE_DEPTH 75
+#define AHCI_IDENTIFY_WORD_SATA_CAPABILITIES 76
+#define AHCI_IDENTIFY_WORD_COMMAND_SETS 83
+#define AHCI_IDENTIFY_WORD_LBA48_SECTORS 100
+#define AHCI_IDENTIFY_WORD_SECTOR_SIZE 106
+#define AHCI_IDENTIFY_WORD_LOGICAL_SECTOR_SIZE 117
+#define AHCI_IDENTIFY_SATA_CAPABILITIES_NCQ 0x0100
+#define AHCI_IDENTIFY_COMMAND_SETS_LBA48 0x0400
+
+// a request is fanned out over the command slots in commands of at most this many sectors
+#define AHCI_MAX_SECTORS_PER_COMMAND 256
+#define AHCI_PRDT_ENTRIES 8
+#define AHCI_PRDT_MAX_BYTES 0x400000
+
+#define AHCI_RESET_TIMEOUT_ITERATIONS 1000000u
+#define AHCI_POLL_SPIN_ITERATIONS 2000u
+#define AHCI_POLL_TIMEOUT_ITERATIONS 10000000u
+#define AHCI_INTERRUPT_WAIT_MAX_WAKEUPS 100000u
+
+struct ahci_command_header
+{
+	uint16_t flags; // command FIS length in dwords, write and prefetch bits
+	uint16_t prdt_length;
+	volatile uint32_t prd_byte_count;
+	uint32_t command_table_base;
+	uint32_t command_table_base_upper;
+	uint32_t reserved[4];
+} __attribute__((packed));
+
+#define AHCI_COMMAND_HEADER_WRITE (1u << 6)
+#define AHCI_COMMAND_HEADER_PREFETCH (1u << 7)
+
+struct ahci_prdt_entry
+{
+	uint32_t data_base;
+	uint32_t data_base_upper;
+	uint32_t reserved;
+	uint32_t byte_count; // bytes minus one, bit 31 requests an interrupt on completion
+} __attribute__((packed));
+
+struct ahci_fis_reg_h2d
+{
+	uint8_t type;
+	uint8_t flags;
+	uint8_t command;
+	uint8_t feature_low;
+	uint8_t lba0;
+	uint8_t lba1;
+	uint8_t lba2;
+	uint8_t device;
+	uint8_t lba3;
+	uint8_t lba4;
+	uint8_t lba5;
+	uint8_t feature_high;
+	uint8_t count_low;
+	uint8_t count_high;
+	uint8_t icc;
+	uint8_t control;
+	uint8_t reserved[4];
+} __attribute__((packed));
+
+// one per command slot, must be 128 byte aligned
+struct ahci_command_table
+{
+	uint8_t command_fis[64];
+	uint8_t atapi_command[16];
+	uint8_t reserved[48];
+	struct ahci_prdt_entry prdt[AHCI_PRDT_ENTRIES];
+} __attribute__((packed));
+
+struct ahci_hba;
+struct ahci_port
+{
+	struct ahci_hba *hba;
+	int index;
+	uint32_t registers; // offset of the port register block from the HBA base
+
+	struct ahci_command_header *command_list; // 32 headers, 1KB aligned
+	void *received_fis;						  // 256 byte aligned
+	struct ahci_command_table *command_tables;
+
+	bool ncq;			  // issue commands through native command queuing
+	uint32_t queue_depth; // command slots used concurrently
+	bool lba48;
+	uint64_t total_sectors;
+	int sector_size;
+
+	struct disk *disk;
+};
+
+struct ahci_hba
+{
+	struct pci_device *device;
+	volatile uint8_t *base;
+	uint32_t capabilities;
+	uint32_t command_slots;
+
+	struct
+	{
+		int vector;					 // IDT vector of the MSI, zero when polling
+		bool verified;				 // set once a completion interrupt has been observed
+		volatile uint64_t count;	 // total interrupts received
+	} irq;
+
+	struct ahci_port *ports[AHCI_MAX_PORTS];
+};
+
+struct disk_driver *ahci_driver_init();
@@ -5,6 +5,10 @@
 #include "memory/memory.h"
 #include "kernel.h"
 #include "io/pci.h"
+#include "io/apic.h"
+#include "idt/idt.h"
+#include "task/task.h"
+#include "disk/streamer.h"
 
 static uint32_t nvme_disk_driver_read_reg(struct disk *disk, uint32_t off);
 static void nvme_disk_driver_write_reg(struct disk *disk, uint32_t off, uint32_t value);
@@ -33,6 +37,57 @@ static inline void nvme_write64(struct nvme_disk_driver_private *priv, uint32_t
 	nvme_write32(priv, off + 4, (uint32_t)(value >> 32));
 }
 
+static inline bool nvme_completion_posted(volatile struct nvme_completion_queue_entry *cqe, uint8_t phase)
+{
+	return ((cqe->status_phase_and_command_identifier >> 16) & 1u) == phase;
+}
+
+static void nvme_interrupt_handler(struct interrupt_frame *frame, void *private)
+{
+	struct nvme_disk_driver_private *priv = private;
+	priv->irq.count++;
+	task_wakeup(priv);
+}
+
+// hybrid wait, spin on the phase bit for a short while and if the command is still outstanding
+// halt until the completion interrupt wakes us. without working interrupts we keep polling
+static int nvme_wait_for_completion(struct nvme_disk_driver_private *priv, volatile struct nvme_completion_queue_entry *cqe, uint8_t phase)
+{
+	for (uint32_t i = 0; i < NVME_POLL_SPIN_ITERATIONS; i++)
+	{
+		if (nvme_completion_posted(cqe, phase))
+		{
+			return 0;
+		}
+
+		__asm__ volatile("pause");
+	}
+
+	if (priv->irq.verified)
+	{
+		bool were_enabled = interrupts_enabled();
+		disable_interrupts();
+		for (uint32_t i = 0; i < NVME_INTERRUPT_WAIT_MAX_WAKEUPS && !nvme_completion_posted(cqe, phase); i++)
+		{
+			task_wait_for_wakeup(priv);
+		}
+
+		if (were_enabled)
+		{
+			enable_interrupts();
+		}
+	}
+	else
+	{
+		for (uint32_t i = NVME_POLL_SPIN_ITERATIONS; i < NVME_POLL_TIMEOUT_ITERATIONS && !nvme_completion_posted(cqe, phase); i++)
+		{
+			__asm__ volatile("pause");
+		}
+	}
+
+	return nvme_completion_posted(cqe, phase) ? 0 : -ETIMEOUT;
+}
+
 static int nvme_admin_cmd_raw(struct disk *disk, uint8_t opcode, uint32_t nsid, uint64_t prp1, uint32_t cdw10, uint32_t cdw11)
 {
 	struct nvme_disk_driver_private *p = disk_private_data_driver(disk);
@@ -57,22 +112,12 @@ static int nvme_admin_cmd_raw(struct disk *disk, uint8_t opcode, uint32_t nsid,
 	p->submission_queue.tail = new_tail;
 	nvme_disk_driver_write_reg(disk, NVME_SQTDBL_OFFSET(0, p->doorbell_stride), p->submission_queue.tail);
 
-	// poll for completion
+	// wait for completion
 	struct nvme_completion_queue_entry *cqe = p->completion_queue.ptr + p->completion_queue.head;
-	for (int i = 0; i < 1000000; i++)
-	{
-		uint32_t st = cqe->status_phase_and_command_identifier;
-		if (((st >> 16) & 1u) == p->admin_cq_phase)
-		{
-			break; // command completed
-		}
-
-		__asm__ volatile("pause");
-	}
-
-	if (((cqe->status_phase_and_command_identifier >> 16) & 1u) != p->admin_cq_phase)
+	int res = nvme_wait_for_completion(p, cqe, p->admin_cq_phase);
+	if (res < 0)
 	{
-		return -ETIMEOUT; // command did not complete in time
+		return res; // command did not complete in time
 	}
 
 	uint32_t st = cqe->status_phase_and_command_identifier;
@@ -93,16 +138,93 @@ static int nvme_admin_cmd_raw(struct disk *disk, uint8_t opcode, uint32_t nsid,
 
 static int nvme_create_io_cq(struct disk *disk, uint16_t qid, uint16_t qsize, void *cq_virt)
 {
+	struct nvme_disk_driver_private *priv = disk_private_data_driver(disk);
 	uint32_t cdw10 = ((uint32_t)(qsize - 1) << 16) | qid;
-	uint32_t cdw11 = 0x01;
-	return nvme_admin_cmd_raw(disk, 0x05, 0, (uint64_t)cq_virt, cdw10, cdw11);
+	uint32_t cdw11 = NVME_CQ_FLAG_PHYSICALLY_CONTIGUOUS;
+	if (priv->irq.vector)
+	{
+		cdw11 |= ((uint32_t)NVME_MSIX_ENTRY << 16) | NVME_CQ_FLAG_INTERRUPTS_ENABLED;
+	}
+
+	return nvme_admin_cmd_raw(disk, NVME_ADMIN_OPCODE_CREATE_IO_CQ, 0, (uint64_t)cq_virt, cdw10, cdw11);
 }
 
 static int nvme_create_io_sq(struct disk *disk, uint16_t qid, uint16_t qsize, void *sq_virt, uint16_t cqid)
 {
 	uint32_t cdw10 = ((uint32_t)(qsize - 1) << 16) | qid;
 	uint32_t cdw11 = ((uint32_t)cqid << 16) | 0x01;
-	return nvme_admin_cmd_raw(disk, 0x01, 0, (uint64_t)sq_virt, cdw10, cdw11);
+	return nvme_admin_cmd_raw(disk, NVME_ADMIN_OPCODE_CREATE_IO_SQ, 0, (uint64_t)sq_virt, cdw10, cdw11);
+}
+
+// reads the formatted LBA size, capacity and transfer hints of our namespace and publishes them through the disk
+static int nvme_identify(struct disk *disk)
+{
+	int res = 0;
+	struct nvme_disk_driver_private *priv = disk_private_data_driver(disk);
+	struct nvme_identify_controller *controller = kzalloc(sizeof(struct nvme_identify_controller));
+	struct nvme_identify_namespace *namespace = kzalloc(sizeof(struct nvme_identify_namespace));
+	if (!controller || !namespace)
+	{
+		res = -ENOMEM;
+		goto out;
+	}
+
+	res = nvme_admin_cmd_raw(disk, NVME_ADMIN_OPCODE_IDENTIFY, 0, (uint64_t)(uintptr_t)controller, NVME_IDENTIFY_CNS_CONTROLLER, 0);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = nvme_admin_cmd_raw(disk, NVME_ADMIN_OPCODE_IDENTIFY, priv->nsid, (uint64_t)(uintptr_t)namespace, NVME_IDENTIFY_CNS_NAMESPACE, 0);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	uint8_t format = NVME_FLBAS_FORMAT_INDEX(namespace->flbas);
+	if (format > namespace->nlbaf)
+	{
+		res = -EIO;
+		goto out;
+	}
+
+	// the stream cache holds one logical block per cache sector so larger formats cannot be supported
+	uint8_t lba_shift = namespace->lbaf[format].lba_data_size;
+	if (lba_shift < 9 || (1u << lba_shift) > DISK_STREAMER_MAX_CACHE_SECTOR_SIZE)
+	{
+		res = -EUNIMP;
+		goto out;
+	}
+
+	uint32_t lba_size = 1u << lba_shift;
+
+	// MDTS is expressed in units of the controller's minimum memory page size
+	uint64_t cap = nvme_read64(priv, NVME_BASE_REGISTER_CAP);
+	uint64_t min_page_size = 4096ull << ((cap >> 48) & 0xFu);
+	uint64_t max_transfer_bytes = NVME_MAX_TRANSFER_BYTES;
+
+	// the minimum page size is at most 2^27 bytes, an MDTS of 32 or more is far past our own limit and would overflow the shift
+	if (controller->mdts && controller->mdts < 32 && (min_page_size << controller->mdts) < max_transfer_bytes)
+	{
+		max_transfer_bytes = min_page_size << controller->mdts;
+	}
+
+	uint64_t max_transfer_sectors = max_transfer_bytes / lba_size;
+	if (max_transfer_sectors > 0x10000)
+	{
+		max_transfer_sectors = 0x10000; // the block count field is 16 bits wide
+	}
+
+	disk->sector_size = lba_size;
+	disk->limits.total_sectors = namespace->nsze;
+	disk->limits.max_transfer_sectors = max_transfer_sectors ? max_transfer_sectors : 1;
+	disk->limits.boundary_sectors = namespace->noiob;
+	disk->limits.write_granularity_sectors = (namespace->nsfeat & NVME_NSFEAT_OPTPERF) ? namespace->npwg + 1u : 0;
+
+out:
+	kfree(controller);
+	kfree(namespace);
+	return res;
 }
 
 static struct nvme_disk_driver_private *nvme_pci_private_new(struct pci_device *dev)
@@ -254,6 +376,73 @@ static int nvme_admin_send_command(struct disk *disk, uint8_t opcode, uint32_t n
 	return status == 0 ? 0 : -EIO;
 }
 
+// route completions through MSI-X, failure is not fatal as the driver falls back to polling
+static int nvme_interrupts_init(struct nvme_disk_driver_private *priv)
+{
+	int res = 0;
+	if (!apic_enabled())
+	{
+		res = -EUNIMP;
+		goto out;
+	}
+
+	res = pci_msix_init(priv->device, &priv->irq.msix);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	int vector = idt_allocate_vector(nvme_interrupt_handler, priv);
+	if (vector < 0)
+	{
+		res = vector;
+		goto out;
+	}
+
+	res = pci_msix_set_vector(&priv->irq.msix, NVME_MSIX_ENTRY, vector, apic_id());
+	if (res < 0)
+	{
+		idt_free_vector(vector);
+		goto out;
+	}
+
+	pci_msix_enable(&priv->irq.msix);
+	priv->irq.vector = vector;
+
+out:
+	return res;
+}
+
+// the admin commands issued during mount should have raised at least one interrupt by now,
+// give any pending ones a chance to be delivered and only trust interrupts if one arrived
+static void nvme_interrupts_verify(struct nvme_disk_driver_private *priv)
+{
+	if (!priv->irq.vector)
+	{
+		return;
+	}
+
+	bool were_enabled = interrupts_enabled();
+	enable_interrupts();
+	for (uint32_t i = 0; i < NVME_POLL_SPIN_ITERATIONS && priv->irq.count == 0; i++)
+	{
+		__asm__ volatile("pause");
+	}
+
+	if (!were_enabled)
+	{
+		disable_interrupts();
+	}
+
+	priv->irq.verified = priv->irq.count > 0;
+	if (!priv->irq.verified)
+	{
+		pci_msix_disable(&priv->irq.msix);
+		idt_free_vector(priv->irq.vector);
+		priv->irq.vector = 0;
+	}
+}
+
 static void *nvme_pci_mmio_base(struct pci_device *dev)
 {
 	uint64_t lo = ((uint64_t)dev->bars[0].addr) & 0xFFFFFFFF0ull;
@@ -283,6 +472,9 @@ static int nvme_disk_driver_mount_for_device(struct disk_driver *driver, struct
 		return res;
 	}
 
+	// interrupts are optional, on failure completions are polled
+	nvme_interrupts_init(priv);
+
 	uint32_t cc = nvme_disk_driver_read_reg(disk, NVME_BASE_REGISTER_CC);
 	cc &= ~1u; // clear the enable bit
 	nvme_disk_driver_write_reg(disk, NVME_BASE_REGISTER_CC, cc);
@@ -352,6 +544,13 @@ static int nvme_disk_driver_mount_for_device(struct disk_driver *driver, struct
 	priv->admin_cq_phase = 1; // initialize the admin completion queue phase to 1
 	priv->nsid = 1;
 
+	res = nvme_identify(disk);
+	if (res < 0)
+	{
+		nvme_disk_driver_unmount(disk);
+		return res;
+	}
+
 	// create IO queues
 	const uint16_t io_entries = mqes < 64 ? mqes : 64;
 	priv->io_submission_queue.size = io_entries;
@@ -362,7 +561,8 @@ static int nvme_disk_driver_mount_for_device(struct disk_driver *driver, struct
 
 	priv->io_submission_queue.ptr = kzalloc(sizeof(struct nvme_submission_queue_entry) * io_entries);
 	priv->io_completion_queue.ptr = kzalloc(sizeof(struct nvme_completion_queue_entry) * io_entries);
-	if (!priv->io_submission_queue.ptr || !priv->io_completion_queue.ptr)
+	priv->prp_list = kzalloc(NVME_PAGE_SIZE);
+	if (!priv->io_submission_queue.ptr || !priv->io_completion_queue.ptr || !priv->prp_list)
 	{
 		nvme_disk_driver_unmount(disk);
 		return -ENOMEM;
@@ -382,15 +582,20 @@ static int nvme_disk_driver_mount_for_device(struct disk_driver *driver, struct
 		return res;
 	}
 
+	nvme_interrupts_verify(priv);
 	return 0;
 }
 
-static int nvme_io_submit_and_poll(struct disk *disk, uint8_t opcode, uint64_t lba, uint16_t num_blocks, void *buf)
+static int nvme_io_submit_and_poll(struct disk *disk, uint8_t opcode, uint64_t lba, uint32_t num_blocks, void *buf)
 {
 	struct nvme_disk_driver_private *priv = disk_private_data_driver(disk);
-	const uint32_t page_size = 4096;
-	uint32_t bytes = (uint32_t)num_blocks * NVME_SECTOR_SIZE;
+	const uint32_t page_size = NVME_PAGE_SIZE;
+	uint32_t bytes = num_blocks * (uint32_t)disk->sector_size;
 	uintptr_t addr = (uintptr_t)buf;
+	if (num_blocks == 0 || bytes > NVME_MAX_TRANSFER_BYTES)
+	{
+		return -EINVARG;
+	}
 
 	// PRP calculation
 	uint32_t first_span = page_size - (uint32_t)(addr & (page_size - 1)); // bytes until the end of the first page
@@ -404,14 +609,22 @@ static int nvme_io_submit_and_poll(struct disk *disk, uint8_t opcode, uint64_t l
 	if (bytes > first_span)
 	{
 		uint32_t remain = bytes - first_span;
-		if (remain > page_size)
+		uintptr_t next_page = addr + first_span;
+		if (remain <= page_size)
 		{
-			remain = page_size; // we only support up to 2 PRPs, so if the remaining data exceeds one page, we limit it to one page
+			prp2 = (uint64_t)next_page; // the second page is described directly
 		}
+		else
+		{
+			// more than two pages, prp2 points at a list describing every page after the first
+			uint32_t total_entries = (remain + page_size - 1) / page_size;
+			for (uint32_t i = 0; i < total_entries; i++)
+			{
+				priv->prp_list[i] = (uint64_t)(next_page + (uintptr_t)i * page_size);
+			}
 
-		prp2 = (uint64_t)(addr + first_span);
-		uint32_t described = first_span + remain;
-		num_blocks = (uint16_t)((described + NVME_SECTOR_SIZE - 1) / NVME_SECTOR_SIZE); // recalculate num_blocks based on the actual described bytes
+			prp2 = (uint64_t)(uintptr_t)priv->prp_list;
+		}
 	}
 
 	// build the command
@@ -425,7 +638,7 @@ static int nvme_io_submit_and_poll(struct disk *disk, uint8_t opcode, uint64_t l
 	cmd.data_ptr4 = (uint32_t)(prp2 >> 32);
 	cmd.command_cdw[0] = (uint32_t)(lba & 0xFFFFFFFFu);
 	cmd.command_cdw[1] = (uint32_t)(lba >> 32);
-	cmd.command_cdw[2] = (uint32_t)(num_blocks - 1u);
+	cmd.command_cdw[2] = (uint32_t)(num_blocks - 1u) & 0xFFFFu;
 
 	// post the command to the IO submission queue
 	struct nvme_submission_queue_entry *sqe = priv->io_submission_queue.ptr + priv->io_submission_queue.tail;
@@ -439,22 +652,12 @@ static int nvme_io_submit_and_poll(struct disk *disk, uint8_t opcode, uint64_t l
 	priv->io_submission_queue.tail = new_tail;
 	nvme_disk_driver_write_reg(disk, NVME_SQTDBL_OFFSET(1, priv->doorbell_stride), priv->io_submission_queue.tail);
 
-	// poll for completion
+	// wait for completion
 	struct nvme_completion_queue_entry *cqe = priv->io_completion_queue.ptr + priv->io_completion_queue.head;
-	for (int i = 0; i < 1000000; i++)
-	{
-		uint32_t st = cqe->status_phase_and_command_identifier;
-		if (((st >> 16) & 1u) == priv->io_completion_queue.phase)
-		{
-			break; // command completed
-		}
-
-		__asm__ volatile("pause");
-	}
-
-	if (((cqe->status_phase_and_command_identifier >> 16) & 1u) != priv->io_completion_queue.phase)
+	int res = nvme_wait_for_completion(priv, cqe, priv->io_completion_queue.phase);
+	if (res < 0)
 	{
-		return -ETIMEOUT; // command did not complete in time
+		return res; // command did not complete in time
 	}
 
 	uint32_t st2 = cqe->status_phase_and_command_identifier;
@@ -507,35 +710,36 @@ static void nvme_disk_driver_unmount(struct disk *disk)
 	}
 }
 
-static int nvme_disk_driver_read(struct disk *disk, uint64_t lba, uint32_t total_sectors, void *buf)
+// size of the next command, bounded by the transfer limit and never crossing the optimal IO boundary.
+// writes also end on the preferred write granularity so the following command starts aligned
+static uint32_t nvme_transfer_sectors(struct disk *hw, uint64_t lba, uint32_t remaining, bool write)
 {
-	struct disk *hw = disk_hardware_disk(disk);
-	if (!hw)
+	uint32_t total = remaining;
+	if (hw->limits.max_transfer_sectors && total > hw->limits.max_transfer_sectors)
 	{
-		hw = disk;
+		total = hw->limits.max_transfer_sectors;
 	}
 
-	int remaining_sectors = total_sectors;
-	uint64_t current_lba = lba;
-	uint8_t *current_buf = (uint8_t *)buf;
-	while (remaining_sectors > 0)
+	uint32_t boundary = hw->limits.boundary_sectors;
+	if (boundary && total > boundary - (lba % boundary))
 	{
-		uint16_t nlb = (remaining_sectors > 16) ? 16 : (uint16_t)remaining_sectors; // we limit each command to at most 16 sectors to avoid PRP complications
-		int rc = nvme_io_submit_and_poll(hw, NVME_OPCODE_READ, current_lba, nlb, current_buf);
-		if (rc < 0)
+		total = boundary - (lba % boundary);
+	}
+
+	uint32_t granularity = hw->limits.write_granularity_sectors;
+	if (write && granularity > 1 && total < remaining)
+	{
+		uint32_t overhang = (lba + total) % granularity;
+		if (overhang < total)
 		{
-			return rc;
+			total -= overhang;
 		}
-
-		current_lba += nlb;
-		current_buf += (size_t)nlb * NVME_SECTOR_SIZE;
-		remaining_sectors -= nlb;
 	}
 
-	return 0;
+	return total;
 }
 
-static int nvme_disk_driver_write(struct disk *disk, uint64_t lba, uint32_t total_sectors, const void *buf)
+static int nvme_disk_driver_transfer(struct disk *disk, uint8_t opcode, uint64_t lba, uint32_t total_sectors, void *buf)
 {
 	struct disk *hw = disk_hardware_disk(disk);
 	if (!hw)
@@ -543,26 +747,41 @@ static int nvme_disk_driver_write(struct disk *disk, uint64_t lba, uint32_t tota
 		hw = disk;
 	}
 
-	int remaining_sectors = total_sectors;
+	if (hw->limits.total_sectors && lba + total_sectors > hw->limits.total_sectors)
+	{
+		return -EIO;
+	}
+
+	uint32_t remaining_sectors = total_sectors;
 	uint64_t current_lba = lba;
-	const uint8_t *current_buf = (const uint8_t *)buf;
+	uint8_t *current_buf = (uint8_t *)buf;
 	while (remaining_sectors > 0)
 	{
-		uint16_t nlb = (remaining_sectors > 16) ? 16 : (uint16_t)remaining_sectors; // we limit each command to at most 16 sectors to avoid PRP complications
-		int rc = nvme_io_submit_and_poll(hw, NVME_OPCODE_WRITE, current_lba, nlb, (void *)current_buf);
+		uint32_t nlb = nvme_transfer_sectors(hw, current_lba, remaining_sectors, opcode == NVME_OPCODE_WRITE);
+		int rc = nvme_io_submit_and_poll(hw, opcode, current_lba, nlb, current_buf);
 		if (rc < 0)
 		{
 			return rc;
 		}
 
 		current_lba += nlb;
-		current_buf += (size_t)nlb * NVME_SECTOR_SIZE;
+		current_buf += (size_t)nlb * hw->sector_size;
 		remaining_sectors -= nlb;
 	}
 
 	return 0;
 }
 
+static int nvme_disk_driver_read(struct disk *disk, uint64_t lba, uint32_t total_sectors, void *buf)
+{
+	return nvme_disk_driver_transfer(disk, NVME_OPCODE_READ, lba, total_sectors, buf);
+}
+
+static int nvme_disk_driver_write(struct disk *disk, uint64_t lba, uint32_t total_sectors, const void *buf)
+{
+	return nvme_disk_driver_transfer(disk, NVME_OPCODE_WRITE, lba, total_sectors, (void *)buf);
+}
+
 static int nvme_disk_driver_mount_partition(struct disk *disk, uint64_t starting_lba, uint64_t ending_lba, struct disk **partition_disk_out)
 {
 	return disk_create_new(disk->driver, disk->hardware_disk, MYOS_DISK_TYPE_PARTITION, starting_lba, ending_lba, disk->sector_size, NULL, partition_disk_out);
@@ -2,10 +2,18 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include "disk.h"
 #include "driver.h"
+#include "io/pci.h"
 
+// sector size assumed until identify namespace reports the formatted LBA size
 #define NVME_SECTOR_SIZE 512
+#define NVME_PAGE_SIZE 4096u
+
+// a single PRP list page describes this many data pages, which bounds the size of one command
+#define NVME_PRP_LIST_ENTRIES (NVME_PAGE_SIZE / sizeof(uint64_t))
+#define NVME_MAX_TRANSFER_BYTES (NVME_PRP_LIST_ENTRIES * NVME_PAGE_SIZE)
 
 #define NVME_PCI_BASE_CLASS 0x01
 #define NVME_PCI_SUBCLASS 0x08
@@ -27,9 +35,31 @@
 #define NVME_ADMIN_SUBMISSION_QUEUE_TOTAL_ENTRIES 64u
 #define NVME_ADMIN_COMPLETION_QUEUE_TOTAL_ENTRIES 64u
 
+// completions are polled for this many iterations before the waiter halts for the completion interrupt,
+// short commands finish inside this window and never pay for the interrupt round trip
+#define NVME_POLL_SPIN_ITERATIONS 2000u
+#define NVME_POLL_TIMEOUT_ITERATIONS 1000000u
+#define NVME_INTERRUPT_WAIT_MAX_WAKEUPS 100000u
+
+// admin and IO completion queues share MSI-X table entry zero
+#define NVME_MSIX_ENTRY 0
+#define NVME_CQ_FLAG_PHYSICALLY_CONTIGUOUS 0x01u
+#define NVME_CQ_FLAG_INTERRUPTS_ENABLED 0x02u
+
 #define NVME_OPCODE_READ 0x02
 #define NVME_OPCODE_WRITE 0x01
 
+#define NVME_ADMIN_OPCODE_CREATE_IO_SQ 0x01
+#define NVME_ADMIN_OPCODE_CREATE_IO_CQ 0x05
+#define NVME_ADMIN_OPCODE_IDENTIFY 0x06
+
+#define NVME_IDENTIFY_CNS_NAMESPACE 0x00
+#define NVME_IDENTIFY_CNS_CONTROLLER 0x01
+
+// namespace features, NPWG, NPWA, NPDG, NPDA and NOWS are only valid when set
+#define NVME_NSFEAT_OPTPERF 0x10
+#define NVME_FLBAS_FORMAT_INDEX(flbas) (((flbas) & 0x0Fu) | ((((flbas) >> 5) & 0x03u) << 4))
+
 typedef uint32_t NVME_COMMAND_BITS;
 #define NVME_COMMAND_BITS_BUILD(opcode, fused, psdt, iden) \
 	(((uint32_t)(opcode) & 0xFFu) |                        \
@@ -62,7 +92,61 @@ struct nvme_completion_queue_entry
 	uint32_t status_phase_and_command_identifier;
 } __attribute__((packed));
 
-struct pci_device;
+struct nvme_identify_controller
+{
+	uint16_t vid;
+	uint16_t ssvid;
+	char sn[20];
+	char mn[40];
+	char fr[8];
+	uint8_t rab;
+	uint8_t ieee[3];
+	uint8_t cmic;
+	uint8_t mdts; // maximum data transfer size as a power of two in units of the minimum page size, zero means no limit
+	uint16_t cntlid;
+	uint32_t ver;
+	uint8_t reserved[4012];
+} __attribute__((packed));
+
+struct nvme_lba_format
+{
+	uint16_t metadata_size;
+	uint8_t lba_data_size; // power of two
+	uint8_t relative_performance;
+} __attribute__((packed));
+
+struct nvme_identify_namespace
+{
+	uint64_t nsze; // namespace size in logical blocks
+	uint64_t ncap;
+	uint64_t nuse;
+	uint8_t nsfeat;
+	uint8_t nlbaf; // number of LBA formats, zero based
+	uint8_t flbas; // formatted LBA size, index into lbaf
+	uint8_t mc;
+	uint8_t dpc;
+	uint8_t dps;
+	uint8_t nmic;
+	uint8_t rescap;
+	uint8_t fpi;
+	uint8_t dlfeat;
+	uint16_t nawun;
+	uint16_t nawupf;
+	uint16_t nacwu;
+	uint16_t nabsn;
+	uint16_t nabo;
+	uint16_t nabspf;
+	uint16_t noiob; // optimal IO boundary in logical blocks, zero when not reported
+	uint8_t nvmcap[16];
+	uint16_t npwg; // preferred write granularity, zero based
+	uint16_t npwa;
+	uint16_t npdg;
+	uint16_t npda;
+	uint16_t nows;
+	uint8_t reserved1[54];
+	struct nvme_lba_format lbaf[64];
+	uint8_t reserved2[3712];
+} __attribute__((packed));
 
 struct nvme_disk_driver_private
 {
@@ -70,6 +154,9 @@ struct nvme_disk_driver_private
 	void *base_address_nvme;
 	uint8_t doorbell_stride;
 	uint32_t nsid;
+
+	// PRP list used by IO commands spanning more than two pages
+	uint64_t *prp_list;
 	uint8_t admin_cq_phase;
 	struct
 	{
@@ -96,6 +183,14 @@ struct nvme_disk_driver_private
 		uint16_t head, size;
 		uint8_t phase;
 	} io_completion_queue;
+
+	struct
+	{
+		struct pci_msix msix;
+		int vector;				 // IDT vector completions are delivered on, zero when polling
+		bool verified;			 // set once a completion interrupt has actually been observed
+		volatile uint64_t count; // total completion interrupts received
+	} irq;
 };
 
 struct disk_driver *nvme_driver_init(void);
\ No newline at end of file
@@ -3,14 +3,20 @@
 #include "disk/disk.h"
 #include "io/io.h"
 #include "io/pci.h"
+#include "idt/idt.h"
+#include "idt/irq.h"
+#include "task/task.h"
 #include "memory/heap/kheap.h"
 
+// private data of the primary drive, the interrupt callback has no other way to reach it
+static struct pata_driver_private_data *pata_primary_private_data = NULL;
+
 int pata_address(int base, int offset)
 {
 	return base + offset;
 }
 
-static bool pata_pci_device_present()
+static struct pci_device *pata_pci_device_find()
 {
 	size_t total_pci = pci_device_count();
 	for (size_t i = 0; i < total_pci; i++)
@@ -23,11 +29,11 @@ static bool pata_pci_device_present()
 
 		if (device->class.base == PATA_PCI_BASE_CLASS && device->class.subclass == PATA_PCI_SUBCLASS)
 		{
-			return true;
+			return device;
 		}
 	}
 
-	return false;
+	return NULL;
 }
 
 struct pata_driver_private_data *pata_private_new(PATA_DISK_DRIVE type, struct disk *primary_disk)
@@ -98,61 +104,484 @@ out:
 	return drive_address;
 }
 
-int pata_disk_read_sector(struct disk *disk, uint64_t lba, uint32_t total_sectors, void *buf)
+// waits for the drive to drop BSY and reports a failed command
+static int pata_wait_not_busy(int base_address)
 {
-	int base_address = pata_disk_base_drive_address(disk, 0x00);
-	while (insb(pata_address(base_address, 0x07)) & 0x80) // wait until the drive is not busy
+	uint8_t status = 0;
+	while ((status = insb(pata_address(base_address, PATA_REGISTER_STATUS))) & PATA_STATUS_BSY) // wait until the drive is not busy
 		;
-	outb(pata_address(base_address, 0x06), 0xE0 | ((lba >> 24) & 0x0F));		 // set drive and head
-	outb(pata_address(base_address, 0x02), (unsigned char)total_sectors);		 // set total sectors to read
-	outb(pata_address(base_address, 0x03), (unsigned char)(lba & 0xFF));		 // set LBA low byte
-	outb(pata_address(base_address, 0x04), (unsigned char)((lba >> 8) & 0xFF));	 // set LBA mid byte
-	outb(pata_address(base_address, 0x05), (unsigned char)((lba >> 16) & 0xFF)); // set LBA high byte
-	outb(pata_address(base_address, 0x07), 0x20);								 // send read command
 
-	unsigned short *ptr = (unsigned short *)buf;
-	for (uint32_t i = 0; i < total_sectors; i++)
+	return (status & (PATA_STATUS_ERR | PATA_STATUS_DF)) ? -EIO : 0;
+}
+
+// waits until the drive is ready to move the next block of data
+static int pata_wait_data_request(int base_address)
+{
+	int res = pata_wait_not_busy(base_address);
+	if (res < 0)
 	{
-		while (insb(pata_address(base_address, 0x07)) & 0x80) // wait until the drive is not busy
-			;
+		return res;
+	}
 
-		// check for error bit
-		char status = insb(pata_address(base_address, 0x07));
-		if (status & 0x01)
+	uint8_t status = 0;
+	while (!((status = insb(pata_address(base_address, PATA_REGISTER_STATUS))) & PATA_STATUS_DRQ)) // wait until data is ready
+	{
+		if (status & (PATA_STATUS_ERR | PATA_STATUS_DF))
 		{
 			return -EIO;
 		}
+	}
+
+	return 0;
+}
+
+// programs the task file, 48 bit commands take the high order bytes first
+static void pata_disk_task_file_set(int base_address, uint64_t lba, uint32_t total_sectors, bool lba48)
+{
+	if (lba48)
+	{
+		outb(pata_address(base_address, PATA_REGISTER_DRIVE_HEAD), 0xE0);
+		outb(pata_address(base_address, PATA_REGISTER_SECTOR_COUNT), (unsigned char)((total_sectors >> 8) & 0xFF));
+		outb(pata_address(base_address, PATA_REGISTER_LBA_LOW), (unsigned char)((lba >> 24) & 0xFF));
+		outb(pata_address(base_address, PATA_REGISTER_LBA_MID), (unsigned char)((lba >> 32) & 0xFF));
+		outb(pata_address(base_address, PATA_REGISTER_LBA_HIGH), (unsigned char)((lba >> 40) & 0xFF));
+	}
+	else
+	{
+		outb(pata_address(base_address, PATA_REGISTER_DRIVE_HEAD), 0xE0 | ((lba >> 24) & 0x0F)); // set drive and head
+	}
+
+	outb(pata_address(base_address, PATA_REGISTER_SECTOR_COUNT), (unsigned char)(total_sectors & 0xFF)); // set total sectors
+	outb(pata_address(base_address, PATA_REGISTER_LBA_LOW), (unsigned char)(lba & 0xFF));				  // set LBA low byte
+	outb(pata_address(base_address, PATA_REGISTER_LBA_MID), (unsigned char)((lba >> 8) & 0xFF));		  // set LBA mid byte
+	outb(pata_address(base_address, PATA_REGISTER_LBA_HIGH), (unsigned char)((lba >> 16) & 0xFF));		  // set LBA high byte
+}
+
+static uint8_t pata_pio_command(struct pata_driver_private_data *private_data, bool lba48, bool write)
+{
+	if (private_data->features.multiple_sectors > 1)
+	{
+		if (write)
+		{
+			return lba48 ? PATA_COMMAND_WRITE_MULTIPLE_EXT : PATA_COMMAND_WRITE_MULTIPLE;
+		}
+
+		return lba48 ? PATA_COMMAND_READ_MULTIPLE_EXT : PATA_COMMAND_READ_MULTIPLE;
+	}
+
+	if (write)
+	{
+		return lba48 ? PATA_COMMAND_WRITE_SECTORS_EXT : PATA_COMMAND_WRITE_SECTORS;
+	}
+
+	return lba48 ? PATA_COMMAND_READ_SECTORS_EXT : PATA_COMMAND_READ_SECTORS;
+}
+
+// one PIO command, the data moves in DRQ blocks of up to multiple_sectors sectors per rep insw/outsw
+static int pata_disk_pio_command(struct disk *disk, uint64_t lba, uint32_t total_sectors, void *buf, bool write)
+{
+	int res = 0;
+	struct pata_driver_private_data *private_data = disk_private_data_driver(disk);
+	int base_address = pata_disk_base_drive_address(disk, 0x00);
+	bool lba48 = private_data->features.lba48;
+	uint32_t block_sectors = private_data->features.multiple_sectors > 1 ? private_data->features.multiple_sectors : 1;
+
+	res = pata_wait_not_busy(base_address);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	pata_disk_task_file_set(base_address, lba, total_sectors, lba48);
+	outb(pata_address(base_address, PATA_REGISTER_COMMAND), pata_pio_command(private_data, lba48, write));
+
+	uint16_t *ptr = (uint16_t *)buf;
+	while (total_sectors > 0)
+	{
+		uint32_t sectors = total_sectors < block_sectors ? total_sectors : block_sectors;
+		res = pata_wait_data_request(base_address);
+		if (res < 0)
+		{
+			goto out;
+		}
 
-		while (!(insb(pata_address(base_address, 0x07)) & 0x08)) // wait until data is ready
-			;
+		size_t total_words = (size_t)sectors * (KERNEL_PATA_SECTOR_SIZE / sizeof(uint16_t));
+		if (write)
+		{
+			outsw_block(pata_address(base_address, PATA_REGISTER_DATA), ptr, total_words);
+		}
+		else
+		{
+			insw_block(pata_address(base_address, PATA_REGISTER_DATA), ptr, total_words);
+		}
 
-		for (int word = 0; word < 256; word++) // read 256 words (512 bytes) per sector
+		ptr += total_words;
+		total_sectors -= sectors;
+	}
+
+	if (write)
+	{
+		// the data only counts as written once the drive has flushed its write cache
+		res = pata_wait_not_busy(base_address);
+		if (res < 0)
 		{
-			*ptr++ = insw(pata_address(base_address, 0x00));
+			goto out;
 		}
+
+		outb(pata_address(base_address, PATA_REGISTER_COMMAND), lba48 ? PATA_COMMAND_FLUSH_CACHE_EXT : PATA_COMMAND_FLUSH_CACHE);
+		res = pata_wait_not_busy(base_address);
 	}
 
+out:
+	return res;
+}
+
+// splits the request into the largest commands the addressing mode allows
+static int pata_disk_pio_transfer(struct disk *disk, uint64_t lba, uint32_t total_sectors, void *buf, bool write)
+{
+	int res = 0;
+	struct pata_driver_private_data *private_data = disk_private_data_driver(disk);
+	bool lba48 = private_data->features.lba48;
+	uint32_t max_sectors = lba48 ? PATA_LBA48_MAX_SECTORS : PATA_LBA28_MAX_SECTORS;
+	if (!lba48 && lba + total_sectors > PATA_LBA28_MAX_LBA + 1)
+	{
+		return -EIO; // beyond what 28 bit addressing can reach
+	}
+
+	uint8_t *current_buf = buf;
+	while (total_sectors > 0)
+	{
+		uint32_t chunk = total_sectors > max_sectors ? max_sectors : total_sectors;
+		res = pata_disk_pio_command(disk, lba, chunk, current_buf, write);
+		if (res < 0)
+		{
+			break;
+		}
+
+		lba += chunk;
+		current_buf += (size_t)chunk * KERNEL_PATA_SECTOR_SIZE;
+		total_sectors -= chunk;
+	}
+
+	return res;
+}
+
+int pata_disk_read_sector(struct disk *disk, uint64_t lba, uint32_t total_sectors, void *buf)
+{
+	return pata_disk_pio_transfer(disk, lba, total_sectors, buf, false);
+}
+
+int pata_disk_write_sector(struct disk *disk, uint64_t lba, uint32_t total_sectors, const void *buf)
+{
+	return pata_disk_pio_transfer(disk, lba, total_sectors, (void *)buf, true);
+}
+
+// reads IDENTIFY DEVICE and enables the largest READ/WRITE MULTIPLE block the drive supports
+static int pata_disk_identify(struct disk *disk)
+{
+	int res = 0;
+	struct pata_driver_private_data *private_data = disk_private_data_driver(disk);
+	int base_address = pata_disk_base_drive_address(disk, 0x00);
+	uint16_t *identify = kzalloc(KERNEL_PATA_SECTOR_SIZE);
+	if (!identify)
+	{
+		res = -ENOMEM;
+		goto out;
+	}
+
+	outb(pata_address(base_address, PATA_REGISTER_DRIVE_HEAD), 0xA0);
+	outb(pata_address(base_address, PATA_REGISTER_SECTOR_COUNT), 0x00);
+	outb(pata_address(base_address, PATA_REGISTER_LBA_LOW), 0x00);
+	outb(pata_address(base_address, PATA_REGISTER_LBA_MID), 0x00);
+	outb(pata_address(base_address, PATA_REGISTER_LBA_HIGH), 0x00);
+	outb(pata_address(base_address, PATA_REGISTER_COMMAND), PATA_COMMAND_IDENTIFY);
+	if (insb(pata_address(base_address, PATA_REGISTER_STATUS)) == 0)
+	{
+		res = -ENOENT; // no drive attached
+		goto out;
+	}
+
+	res = pata_wait_data_request(base_address);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	insw_block(pata_address(base_address, PATA_REGISTER_DATA), identify, KERNEL_PATA_SECTOR_SIZE / sizeof(uint16_t));
+
+	private_data->features.lba48 = (identify[PATA_IDENTIFY_WORD_COMMAND_SETS] & PATA_IDENTIFY_COMMAND_SETS_LBA48) != 0;
+	if (private_data->features.lba48)
+	{
+		private_data->features.total_sectors = (uint64_t)identify[PATA_IDENTIFY_WORD_LBA48_SECTORS] |
+											   ((uint64_t)identify[PATA_IDENTIFY_WORD_LBA48_SECTORS + 1] << 16) |
+											   ((uint64_t)identify[PATA_IDENTIFY_WORD_LBA48_SECTORS + 2] << 32) |
+											   ((uint64_t)identify[PATA_IDENTIFY_WORD_LBA48_SECTORS + 3] << 48);
+	}
+	else
+	{
+		private_data->features.total_sectors = (uint64_t)identify[PATA_IDENTIFY_WORD_LBA28_SECTORS] |
+											   ((uint64_t)identify[PATA_IDENTIFY_WORD_LBA28_SECTORS + 1] << 16);
+	}
+
+	disk->limits.total_sectors = private_data->features.total_sectors;
+	disk->limits.max_transfer_sectors = private_data->features.lba48 ? PATA_LBA48_MAX_SECTORS : PATA_LBA28_MAX_SECTORS;
+
+	uint16_t max_multiple = identify[PATA_IDENTIFY_WORD_MAX_MULTIPLE] & 0xFF;
+	if (max_multiple > 1)
+	{
+		res = pata_wait_not_busy(base_address);
+		if (res < 0)
+		{
+			goto out;
+		}
+
+		outb(pata_address(base_address, PATA_REGISTER_DRIVE_HEAD), 0xE0);
+		outb(pata_address(base_address, PATA_REGISTER_SECTOR_COUNT), (unsigned char)max_multiple);
+		outb(pata_address(base_address, PATA_REGISTER_COMMAND), PATA_COMMAND_SET_MULTIPLE_MODE);
+
+		// a drive that rejects the block size keeps transferring one sector per DRQ block
+		if (pata_wait_not_busy(base_address) == 0)
+		{
+			private_data->features.multiple_sectors = max_multiple;
+		}
+	}
+
+out:
+	kfree(identify);
+	return res;
+}
+
+static void pata_handle_interrupt()
+{
+	struct pata_driver_private_data *private_data = pata_primary_private_data;
+	if (!private_data)
+	{
+		return;
+	}
+
+	insb(pata_address(PATA_PRIMARY_DRIVE_BASE_ADDRESS, PATA_REGISTER_STATUS)); // reading the status acknowledges the drive interrupt
+	private_data->dma.irq_count++;
+	task_wakeup(private_data);
+}
+
+// locates the bus master registers through BAR4 of the IDE controller, DMA stays disabled on failure
+static int pata_dma_init(struct pata_driver_private_data *private_data, struct pci_device *device)
+{
+	int res = 0;
+	struct pci_device_bar *bar = &device->bars[PATA_BUS_MASTER_BAR];
+	uint64_t bus_master_base = pci_device_bar_address(device, PATA_BUS_MASTER_BAR);
+	if (bar->type != PCI_DEVICE_IO_PORT || !bar->size || !bus_master_base)
+	{
+		res = -EUNIMP;
+		goto out;
+	}
+
+	private_data->dma.prdt = kzalloc(PATA_PRD_TABLE_SIZE);
+	if (!private_data->dma.prdt)
+	{
+		res = -ENOMEM;
+		goto out;
+	}
+
+	pci_enable_bus_master(device);
+
+	// the primary channel registers come first, the secondary channel is at offset 8
+	private_data->dma.bus_master_base = (uint16_t)bus_master_base;
+	pata_primary_private_data = private_data;
+	idt_register_interrupt_callback(PATA_PRIMARY_INTERRUPT, pata_handle_interrupt);
+
+	// clear nIEN so the drive raises its interrupt line on completion
+	outb(PATA_PRIMARY_DRIVE_CTRL_ADDRESS, 0x00);
+	irq_enable(IRQ_PRIMARY_ATA_HDD);
+
+out:
+	return res;
+}
+
+// describes the buffer with physical region descriptors, every region is identity mapped kernel memory
+static int pata_dma_prdt_build(struct pata_driver_private_data *private_data, void *buf, size_t total_bytes)
+{
+	uintptr_t addr = (uintptr_t)buf;
+	if ((addr & 0x01) || addr + total_bytes > 0x100000000ull)
+	{
+		return -EUNIMP; // descriptors hold word aligned 32 bit addresses
+	}
+
+	size_t max_entries = PATA_PRD_TABLE_SIZE / sizeof(struct pata_prd);
+	size_t index = 0;
+	while (total_bytes > 0)
+	{
+		if (index >= max_entries)
+		{
+			return -EINVARG;
+		}
+
+		size_t chunk = PATA_PRD_MAX_BYTES - (addr & (PATA_PRD_MAX_BYTES - 1));
+		if (chunk > total_bytes)
+		{
+			chunk = total_bytes;
+		}
+
+		private_data->dma.prdt[index].address = (uint32_t)addr;
+		private_data->dma.prdt[index].byte_count = (uint16_t)chunk; // 64KB wraps to zero which is what the controller expects
+		private_data->dma.prdt[index].flags = 0;
+		addr += chunk;
+		total_bytes -= chunk;
+		index++;
+	}
+
+	private_data->dma.prdt[index - 1].flags = PATA_PRD_END_OF_TABLE;
 	return 0;
 }
 
-int pata_driver_read(struct disk *disk, uint64_t lba, uint32_t total_sectors, void *buf)
+static bool pata_dma_finished(struct pata_driver_private_data *private_data)
+{
+	uint8_t status = insb(private_data->dma.bus_master_base + PATA_BUS_MASTER_REGISTER_STATUS);
+	return (status & (PATA_BUS_MASTER_STATUS_INTERRUPT | PATA_BUS_MASTER_STATUS_ERROR)) != 0;
+}
+
+// spin briefly, then halt until the drive interrupt arrives. until an interrupt has been seen we keep polling
+static int pata_dma_wait(struct pata_driver_private_data *private_data)
+{
+	for (uint32_t i = 0; i < PATA_POLL_SPIN_ITERATIONS; i++)
+	{
+		if (pata_dma_finished(private_data))
+		{
+			return 0;
+		}
+
+		__asm__ volatile("pause");
+	}
+
+	if (private_data->dma.irq_verified)
+	{
+		bool were_enabled = interrupts_enabled();
+		disable_interrupts();
+		for (uint32_t i = 0; i < PATA_INTERRUPT_WAIT_MAX_WAKEUPS && !pata_dma_finished(private_data); i++)
+		{
+			task_wait_for_wakeup(private_data);
+		}
+
+		if (were_enabled)
+		{
+			enable_interrupts();
+		}
+	}
+	else
+	{
+		for (uint32_t i = PATA_POLL_SPIN_ITERATIONS; i < PATA_POLL_TIMEOUT_ITERATIONS && !pata_dma_finished(private_data); i++)
+		{
+			__asm__ volatile("pause");
+		}
+	}
+
+	return pata_dma_finished(private_data) ? 0 : -ETIMEOUT;
+}
+
+static int pata_disk_read_dma_command(struct disk *disk, uint64_t lba, uint32_t total_sectors, void *buf)
 {
 	int res = 0;
-	struct disk *hardware_disk = disk_hardware_disk(disk);
-	res = pata_disk_read_sector(hardware_disk, lba, total_sectors, buf);
+	struct pata_driver_private_data *private_data = disk_private_data_driver(disk);
+	uint16_t bus_master = private_data->dma.bus_master_base;
+	int base_address = pata_disk_base_drive_address(disk, 0x00);
+
+	res = pata_dma_prdt_build(private_data, buf, (size_t)total_sectors * KERNEL_PATA_SECTOR_SIZE);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	// stop the engine, load the descriptor table, clear stale status and set the direction
+	outb(bus_master + PATA_BUS_MASTER_REGISTER_COMMAND, 0x00);
+	outdw(bus_master + PATA_BUS_MASTER_REGISTER_PRDT, (uint32_t)(uintptr_t)private_data->dma.prdt);
+	outb(bus_master + PATA_BUS_MASTER_REGISTER_STATUS, insb(bus_master + PATA_BUS_MASTER_REGISTER_STATUS) | PATA_BUS_MASTER_STATUS_INTERRUPT | PATA_BUS_MASTER_STATUS_ERROR);
+	outb(bus_master + PATA_BUS_MASTER_REGISTER_COMMAND, PATA_BUS_MASTER_COMMAND_READ);
+
+	while (insb(pata_address(base_address, PATA_REGISTER_STATUS)) & PATA_STATUS_BSY) // wait until the drive is not busy
+		;
+
+	pata_disk_task_file_set(base_address, lba, total_sectors, true);
+	outb(pata_address(base_address, PATA_REGISTER_COMMAND), PATA_COMMAND_READ_DMA_EXT);
+	outb(bus_master + PATA_BUS_MASTER_REGISTER_COMMAND, PATA_BUS_MASTER_COMMAND_READ | PATA_BUS_MASTER_COMMAND_START);
+
+	res = pata_dma_wait(private_data);
+
+	// the engine must be stopped even when the transfer failed
+	outb(bus_master + PATA_BUS_MASTER_REGISTER_COMMAND, 0x00);
+	uint8_t bus_master_status = insb(bus_master + PATA_BUS_MASTER_REGISTER_STATUS);
+	uint8_t drive_status = insb(pata_address(base_address, PATA_REGISTER_STATUS));
+	outb(bus_master + PATA_BUS_MASTER_REGISTER_STATUS, bus_master_status | PATA_BUS_MASTER_STATUS_INTERRUPT | PATA_BUS_MASTER_STATUS_ERROR);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	if ((bus_master_status & PATA_BUS_MASTER_STATUS_ERROR) || (drive_status & (PATA_STATUS_ERR | PATA_STATUS_DF)))
+	{
+		res = -EIO;
+		goto out;
+	}
+
+	if (private_data->dma.irq_count)
+	{
+		private_data->dma.irq_verified = true;
+	}
+
+out:
 	return res;
 }
 
-int pata_driver_write(struct disk *disk, uint64_t lba, uint32_t total_sectors, const void *buf)
+static int pata_disk_read_dma(struct disk *disk, uint64_t lba, uint32_t total_sectors, void *buf)
+{
+	int res = 0;
+	uint8_t *current_buf = buf;
+	while (total_sectors > 0)
+	{
+		uint32_t chunk = total_sectors > PATA_DMA_MAX_SECTORS ? PATA_DMA_MAX_SECTORS : total_sectors;
+		res = pata_disk_read_dma_command(disk, lba, chunk, current_buf);
+		if (res < 0)
+		{
+			break;
+		}
+
+		lba += chunk;
+		current_buf += (size_t)chunk * KERNEL_PATA_SECTOR_SIZE;
+		total_sectors -= chunk;
+	}
+
+	return res;
+}
+
+int pata_driver_read(struct disk *disk, uint64_t lba, uint32_t total_sectors, void *buf)
 {
 	int res = -EUNIMP;
+	struct disk *hardware_disk = disk_hardware_disk(disk);
+	struct pata_driver_private_data *private_data = disk_private_data_driver(hardware_disk);
+	if (private_data && private_data->dma.bus_master_base && private_data->features.lba48)
+	{
+		res = pata_disk_read_dma(hardware_disk, lba, total_sectors, buf);
+	}
+
+	// buffers the bus master cannot reach and controllers without DMA use programmed IO
+	if (res == -EUNIMP)
+	{
+		res = pata_disk_read_sector(hardware_disk, lba, total_sectors, buf);
+	}
+
 	return res;
 }
 
+int pata_driver_write(struct disk *disk, uint64_t lba, uint32_t total_sectors, const void *buf)
+{
+	struct disk *hardware_disk = disk_hardware_disk(disk);
+	return pata_disk_write_sector(hardware_disk, lba, total_sectors, buf);
+}
+
 int pata_driver_mount(struct disk_driver *driver)
 {
 	int res = 0;
-	if (!pata_pci_device_present())
+	struct pci_device *device = pata_pci_device_find();
+	if (!device)
 	{
 		res = -ENOENT;
 		goto out;
@@ -172,6 +601,12 @@ int pata_driver_mount(struct disk_driver *driver)
 		goto out;
 	}
 
+	// without IDENTIFY data the drive is driven with single sector 28 bit commands
+	pata_disk_identify(primary_private_data->real_disk);
+
+	// DMA is optional, programmed IO is used when the bus master is unavailable
+	pata_dma_init(primary_private_data, device);
+
 	// TODO: detect if secondary drive exists and create disk for it as well
 
 out:
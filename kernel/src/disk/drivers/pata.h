@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
 #include "disk.h"
 #include "driver.h"
 
@@ -11,6 +13,69 @@
 #define PATA_SECONDARY_DRIVE_BASE_ADDRESS 0x170
 #define PATA_PRIMARY_DRIVE_CTRL_ADDRESS 0x3F6
 #define PATA_SECONDARY_DRIVE_CTRL_ADDRESS 0x376
+#define PATA_PRIMARY_INTERRUPT 0x2E
+
+// task file registers, relative to the drive base address
+#define PATA_REGISTER_DATA 0x00
+#define PATA_REGISTER_SECTOR_COUNT 0x02
+#define PATA_REGISTER_LBA_LOW 0x03
+#define PATA_REGISTER_LBA_MID 0x04
+#define PATA_REGISTER_LBA_HIGH 0x05
+#define PATA_REGISTER_DRIVE_HEAD 0x06
+#define PATA_REGISTER_STATUS 0x07
+#define PATA_REGISTER_COMMAND 0x07
+
+#define PATA_STATUS_ERR 0x01
+#define PATA_STATUS_DRQ 0x08
+#define PATA_STATUS_DF 0x20
+#define PATA_STATUS_BSY 0x80
+
+#define PATA_COMMAND_READ_SECTORS 0x20
+#define PATA_COMMAND_READ_SECTORS_EXT 0x24
+#define PATA_COMMAND_READ_DMA_EXT 0x25
+#define PATA_COMMAND_READ_MULTIPLE_EXT 0x29
+#define PATA_COMMAND_WRITE_SECTORS 0x30
+#define PATA_COMMAND_WRITE_SECTORS_EXT 0x34
+#define PATA_COMMAND_WRITE_MULTIPLE_EXT 0x39
+#define PATA_COMMAND_READ_MULTIPLE 0xC4
+#define PATA_COMMAND_WRITE_MULTIPLE 0xC5
+#define PATA_COMMAND_SET_MULTIPLE_MODE 0xC6
+#define PATA_COMMAND_FLUSH_CACHE 0xE7
+#define PATA_COMMAND_FLUSH_CACHE_EXT 0xEA
+#define PATA_COMMAND_IDENTIFY 0xEC
+
+// IDENTIFY DEVICE words we care about
+#define PATA_IDENTIFY_WORD_MAX_MULTIPLE 47
+#define PATA_IDENTIFY_WORD_LBA28_SECTORS 60
+#define PATA_IDENTIFY_WORD_COMMAND_SETS 83
+#define PATA_IDENTIFY_WORD_LBA48_SECTORS 100
+#define PATA_IDENTIFY_COMMAND_SETS_LBA48 0x0400
+
+// sector count register limits, a count of zero means the maximum
+#define PATA_LBA28_MAX_SECTORS 256
+#define PATA_LBA48_MAX_SECTORS 65536
+#define PATA_LBA28_MAX_LBA 0x0FFFFFFFull
+
+// bus master IDE registers, relative to BAR4 of the IDE controller
+#define PATA_BUS_MASTER_BAR 4
+#define PATA_BUS_MASTER_REGISTER_COMMAND 0x00
+#define PATA_BUS_MASTER_REGISTER_STATUS 0x02
+#define PATA_BUS_MASTER_REGISTER_PRDT 0x04
+#define PATA_BUS_MASTER_COMMAND_START 0x01
+#define PATA_BUS_MASTER_COMMAND_READ 0x08 // the bus master writes into memory
+#define PATA_BUS_MASTER_STATUS_ACTIVE 0x01
+#define PATA_BUS_MASTER_STATUS_ERROR 0x02
+#define PATA_BUS_MASTER_STATUS_INTERRUPT 0x04
+
+// a physical region may not cross a 64KB boundary, a byte count of zero means 64KB
+#define PATA_PRD_END_OF_TABLE 0x8000
+#define PATA_PRD_MAX_BYTES 0x10000
+#define PATA_PRD_TABLE_SIZE 4096
+#define PATA_DMA_MAX_SECTORS 2048
+
+#define PATA_POLL_SPIN_ITERATIONS 2000u
+#define PATA_POLL_TIMEOUT_ITERATIONS 10000000u
+#define PATA_INTERRUPT_WAIT_MAX_WAKEUPS 100000u
 
 enum
 {
@@ -22,10 +87,35 @@ enum
 
 typedef int PATA_DISK_DRIVE;
 struct disk;
+
+// physical region descriptor, one contiguous chunk of a DMA transfer
+struct pata_prd
+{
+	uint32_t address;
+	uint16_t byte_count;
+	uint16_t flags;
+} __attribute__((packed));
+
 struct pata_driver_private_data
 {
 	PATA_DISK_DRIVE disk_drive; // which drive this is for
 	struct disk *real_disk;		// the real disk this partition belongs to
+
+	// capabilities reported by IDENTIFY DEVICE
+	struct
+	{
+		bool lba48;				   // supports the 48 bit EXT commands
+		uint16_t multiple_sectors; // sectors per DRQ block in READ/WRITE MULTIPLE, zero when disabled
+		uint64_t total_sectors;
+	} features;
+
+	struct
+	{
+		uint16_t bus_master_base;	 // bus master registers of our channel, zero when DMA is unavailable
+		struct pata_prd *prdt;		 // physical region descriptor table
+		bool irq_verified;			 // set once a completion interrupt has been observed
+		volatile uint64_t irq_count; // total completion interrupts received
+	} dma;
 };
 
 struct disk_driver *pata_driver_init();
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include "ramdisk.h"
+#include "bio.h"
+#include "gpt.h"
+#include "config.h"
+#include "status.h"
+#include "kernel.h"
+#include "memory/heap/kheap.h"
+#include "memory/memory.h"
+#include "memory/paging/paging.h"
+
+static struct disk_driver ramdisk_driver;
+
+// the transfer must lie entirely inside the image
+static int ramdisk_bounds_check(struct ramdisk_private *priv, uint64_t lba, uint32_t total_sectors)
+{
+	if (lba > priv->total_sectors || total_sectors > priv->total_sectors - lba)
+	{
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int ramdisk_disk_driver_read(struct disk *disk, uint64_t lba, uint32_t total_sectors, void *buf)
+{
+	struct ramdisk_private *priv = disk_private_data_driver(disk_hardware_disk(disk));
+	int res = ramdisk_bounds_check(priv, lba, total_sectors);
+	if (res < 0)
+	{
+		return res;
+	}
+
+	memcpy(buf, priv->base + lba * RAMDISK_SECTOR_SIZE, (size_t)total_sectors * RAMDISK_SECTOR_SIZE);
+	return 0;
+}
+
+static int ramdisk_disk_driver_write(struct disk *disk, uint64_t lba, uint32_t total_sectors, const void *buf)
+{
+	struct ramdisk_private *priv = disk_private_data_driver(disk_hardware_disk(disk));
+	int res = ramdisk_bounds_check(priv, lba, total_sectors);
+	if (res < 0)
+	{
+		return res;
+	}
+
+	memcpy(priv->base + lba * RAMDISK_SECTOR_SIZE, (void *)buf, (size_t)total_sectors * RAMDISK_SECTOR_SIZE);
+	return 0;
+}
+
+// copies every segment in place and completes before returning, so merged requests never need the queue bounce buffer
+static int ramdisk_disk_driver_submit(struct disk *disk, struct bio *bio)
+{
+	int res = 0;
+	uint64_t sector = bio->sector;
+	for (int i = 0; i < bio->total_segments && res == 0; i++)
+	{
+		struct bio_segment *segment = &bio->segments[i];
+		if (bio->direction == BIO_WRITE)
+		{
+			res = ramdisk_disk_driver_write(disk, sector, segment->total_sectors, segment->buf);
+		}
+		else
+		{
+			res = ramdisk_disk_driver_read(disk, sector, segment->total_sectors, segment->buf);
+		}
+
+		sector += segment->total_sectors;
+	}
+
+	bio_complete(bio, res);
+	return 0;
+}
+
+static int ramdisk_disk_driver_mount_partition(struct disk *disk, uint64_t starting_lba, uint64_t ending_lba, struct disk **partition_disk_out)
+{
+	return disk_create_new(disk->driver, disk->hardware_disk, MYOS_DISK_TYPE_PARTITION, starting_lba, ending_lba, disk->sector_size, NULL, partition_disk_out);
+}
+
+static void ramdisk_disk_driver_unmount(struct disk *disk)
+{
+	struct ramdisk_private *priv = disk_private_data_driver(disk);
+	if (!priv || disk->type != MYOS_DISK_TYPE_REAL)
+	{
+		return;
+	}
+
+	if (priv->heap)
+	{
+		kfree(priv->base);
+	}
+
+	kfree(priv);
+	disk->driver_private = NULL;
+}
+
+static struct disk_driver ramdisk_driver = {
+	.name = "RAMDISK",
+	.functions = {
+		.loaded = NULL,
+		.unloaded = NULL,
+		.mount = NULL, // ramdisks are created on demand rather than probed
+		.unmount = ramdisk_disk_driver_unmount,
+		.read = ramdisk_disk_driver_read,
+		.write = ramdisk_disk_driver_write,
+		.submit = ramdisk_disk_driver_submit,
+		.mount_partition = ramdisk_disk_driver_mount_partition,
+	},
+};
+
+struct disk_driver *ramdisk_driver_init()
+{
+	return &ramdisk_driver;
+}
+
+static int ramdisk_create_internal(void *base, size_t size, bool heap, struct disk **disk_out)
+{
+	int res = 0;
+	if (!base || size < RAMDISK_SECTOR_SIZE)
+	{
+		return -EINVARG;
+	}
+
+	struct ramdisk_private *priv = kzalloc(sizeof(struct ramdisk_private));
+	if (!priv)
+	{
+		return -ENOMEM;
+	}
+
+	priv->base = base;
+	priv->total_sectors = size / RAMDISK_SECTOR_SIZE;
+	priv->heap = heap;
+
+	struct disk *disk = NULL;
+	res = disk_create_new(&ramdisk_driver, NULL, MYOS_DISK_TYPE_REAL, 0, 0, RAMDISK_SECTOR_SIZE, priv, &disk);
+	if (res < 0)
+	{
+		kfree(priv);
+		return res;
+	}
+
+	disk->limits.total_sectors = priv->total_sectors;
+	if (disk_out)
+	{
+		*disk_out = disk;
+	}
+
+	return 0;
+}
+
+// wraps memory that is already identity mapped, the caller keeps ownership
+int ramdisk_create(void *base, size_t size, struct disk **disk_out)
+{
+	return ramdisk_create_internal(base, size, false, disk_out);
+}
+
+// creates a zero filled ramdisk of size bytes
+int ramdisk_create_from_heap(size_t size, struct disk **disk_out)
+{
+	void *base = kzalloc(size);
+	if (!base)
+	{
+		return -ENOMEM;
+	}
+
+	int res = ramdisk_create_internal(base, size, true, disk_out);
+	if (res < 0)
+	{
+		kfree(base);
+	}
+
+	return res;
+}
+
+// copies a whole disk or partition into memory, e.g. to serve a hot working set from RAM
+int ramdisk_create_from_disk(struct disk *source, struct disk **disk_out)
+{
+	int res = 0;
+	if (source->sector_size != RAMDISK_SECTOR_SIZE)
+	{
+		return -EUNIMP;
+	}
+
+	uint64_t total_sectors = source->type == MYOS_DISK_TYPE_PARTITION ? source->ending_lba - source->starting_lba : source->limits.total_sectors;
+	if (total_sectors == 0)
+	{
+		return -EINVARG;
+	}
+
+	uint8_t *base = kzalloc(total_sectors * RAMDISK_SECTOR_SIZE);
+	if (!base)
+	{
+		return -ENOMEM;
+	}
+
+	for (uint64_t lba = 0; lba < total_sectors; lba += RAMDISK_COPY_CHUNK_SECTORS)
+	{
+		uint64_t chunk = total_sectors - lba > RAMDISK_COPY_CHUNK_SECTORS ? RAMDISK_COPY_CHUNK_SECTORS : total_sectors - lba;
+		res = disk_read_block(source, lba, chunk, base + lba * RAMDISK_SECTOR_SIZE);
+		if (res < 0)
+		{
+			kfree(base);
+			return res;
+		}
+	}
+
+	res = ramdisk_create_internal(base, total_sectors * RAMDISK_SECTOR_SIZE, true, disk_out);
+	if (res < 0)
+	{
+		kfree(base);
+	}
+
+	return res;
+}
+
+// a partitioned image mounts each GPT partition, anything else is tried as a bare filesystem
+int ramdisk_mount_filesystems(struct disk *disk)
+{
+	int res = gpt_mount_disk(disk);
+	if (res == -EINFORMAT)
+	{
+		res = disk_filesystem_mount(disk);
+	}
+
+	return res;
+}
+
+// picks up the image the bootloader left in memory, if any
+int ramdisk_boot_init()
+{
+	int res = 0;
+	const int flags = PAGING_IS_PRESENT | PAGING_IS_WRITEABLE;
+	void *descriptor_page = (void *)MYOS_RAMDISK_DESCRIPTOR_LOCATION;
+	paging_map(kernel_desc(), descriptor_page, descriptor_page, flags);
+
+	struct ramdisk_boot_descriptor *descriptor = descriptor_page;
+	if (descriptor->magic != MYOS_RAMDISK_DESCRIPTOR_MAGIC || descriptor->size == 0)
+	{
+		res = -ENOENT;
+		goto out;
+	}
+
+	// the bootloader reserves the image, it is not part of the memory we map at boot
+	void *base = (void *)descriptor->base;
+	void *end = (void *)paging_align_value_to_upper_page(descriptor->base + descriptor->size);
+	res = paging_map_to(kernel_desc(), base, base, end, flags);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	struct disk *disk = NULL;
+	res = ramdisk_create(base, descriptor->size, &disk);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = ramdisk_mount_filesystems(disk);
+
+out:
+	return res;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "disk/disk.h"
+#include "disk/driver.h"
+
+#define RAMDISK_SECTOR_SIZE 512
+
+// transfer size used when copying a disk into a ramdisk
+#define RAMDISK_COPY_CHUNK_SECTORS 256
+
+// written by the bootloader at MYOS_RAMDISK_DESCRIPTOR_LOCATION
+struct ramdisk_boot_descriptor
+{
+	uint64_t magic;
+	uint64_t base;
+	uint64_t size;
+} __attribute__((packed));
+
+struct ramdisk_private
+{
+	uint8_t *base;
+	uint64_t total_sectors;
+	bool heap; // memory is owned by the kernel heap rather than the bootloader
+};
+
+struct disk_driver *ramdisk_driver_init();
+int ramdisk_create(void *base, size_t size, struct disk **disk_out);
+int ramdisk_create_from_heap(size_t size, struct disk **disk_out);
+int ramdisk_create_from_disk(struct disk *source, struct disk **disk_out);
+int ramdisk_mount_filesystems(struct disk *disk);
+int ramdisk_boot_init();
@@ -0,0 +1,634 @@
+#include "virtio_blk.h"
+#include "status.h"
+#include "kernel.h"
+#include "io/apic.h"
+#include "idt/idt.h"
+#include "task/task.h"
+#include "memory/heap/kheap.h"
+#include "memory/memory.h"
+
+static inline uint8_t virtio_read8(volatile uint8_t *base, uint32_t off)
+{
+	return *((volatile uint8_t *)(base + off));
+}
+
+static inline uint16_t virtio_read16(volatile uint8_t *base, uint32_t off)
+{
+	return *((volatile uint16_t *)(base + off));
+}
+
+static inline uint32_t virtio_read32(volatile uint8_t *base, uint32_t off)
+{
+	return *((volatile uint32_t *)(base + off));
+}
+
+static inline void virtio_write8(volatile uint8_t *base, uint32_t off, uint8_t value)
+{
+	*((volatile uint8_t *)(base + off)) = value;
+}
+
+static inline void virtio_write16(volatile uint8_t *base, uint32_t off, uint16_t value)
+{
+	*((volatile uint16_t *)(base + off)) = value;
+}
+
+static inline void virtio_write32(volatile uint8_t *base, uint32_t off, uint32_t value)
+{
+	*((volatile uint32_t *)(base + off)) = value;
+}
+
+static inline void virtio_write64(volatile uint8_t *base, uint32_t off, uint64_t value)
+{
+	virtio_write32(base, off, (uint32_t)(value & 0xFFFFFFFFu));
+	virtio_write32(base, off + 4, (uint32_t)(value >> 32));
+}
+
+static inline void virtio_memory_barrier()
+{
+	__asm__ volatile("mfence" ::: "memory");
+}
+
+static bool virtio_blk_pci_device(struct pci_device *dev)
+{
+	// virtio-scsi shares the mass storage class code, so match on the device id
+	if (dev->vendor != VIRTIO_PCI_VENDOR_ID)
+	{
+		return false;
+	}
+
+	return dev->device_id == VIRTIO_PCI_DEVICE_ID_BLOCK || dev->device_id == VIRTIO_PCI_DEVICE_ID_BLOCK_LEGACY;
+}
+
+// locates the common, notify and device configuration structures through the vendor capabilities
+static int virtio_blk_capabilities_map(struct virtio_blk_private *priv)
+{
+	struct pci_device *dev = priv->device;
+	uint8_t bus = dev->addr.bus;
+	uint8_t slot = dev->addr.slot;
+	uint8_t func = dev->addr.function;
+	for (uint8_t cap = pci_capability_find(dev, PCI_CAPABILITY_ID_VENDOR); cap; cap = pci_capability_find_next(dev, PCI_CAPABILITY_ID_VENDOR, cap))
+	{
+		uint8_t type = pci_cfg_read_byte(bus, slot, func, cap + VIRTIO_PCI_CAP_CFG_TYPE);
+		uint8_t bar = pci_cfg_read_byte(bus, slot, func, cap + VIRTIO_PCI_CAP_BAR);
+		uint32_t offset = pci_cfg_read_dword(bus, slot, func, cap + VIRTIO_PCI_CAP_OFFSET);
+		uint32_t length = pci_cfg_read_dword(bus, slot, func, cap + VIRTIO_PCI_CAP_LENGTH);
+		if (bar >= 6)
+		{
+			continue;
+		}
+
+		if (type == VIRTIO_PCI_CAP_COMMON_CFG && !priv->common)
+		{
+			priv->common = pci_device_bar_map(dev, bar, offset, length);
+		}
+		else if (type == VIRTIO_PCI_CAP_NOTIFY_CFG && !priv->notify)
+		{
+			priv->notify = pci_device_bar_map(dev, bar, offset, length);
+			priv->notify_multiplier = pci_cfg_read_dword(bus, slot, func, cap + VIRTIO_PCI_CAP_NOTIFY_MULTIPLIER);
+		}
+		else if (type == VIRTIO_PCI_CAP_DEVICE_CFG && !priv->config)
+		{
+			priv->config = pci_device_bar_map(dev, bar, offset, length);
+		}
+	}
+
+	// legacy only devices lack the vendor capabilities
+	return (priv->common && priv->notify && priv->config) ? 0 : -EUNIMP;
+}
+
+static int virtio_blk_reset(struct virtio_blk_private *priv)
+{
+	virtio_write8(priv->common, VIRTIO_COMMON_DEVICE_STATUS, 0);
+	for (uint32_t i = 0; i < VIRTIO_BLK_RESET_TIMEOUT_ITERATIONS; i++)
+	{
+		if (virtio_read8(priv->common, VIRTIO_COMMON_DEVICE_STATUS) == 0)
+		{
+			return 0;
+		}
+
+		__asm__ volatile("pause");
+	}
+
+	return -ETIMEOUT;
+}
+
+static void virtio_blk_status_set(struct virtio_blk_private *priv, uint8_t status)
+{
+	virtio_write8(priv->common, VIRTIO_COMMON_DEVICE_STATUS, virtio_read8(priv->common, VIRTIO_COMMON_DEVICE_STATUS) | status);
+}
+
+static int virtio_blk_features_negotiate(struct virtio_blk_private *priv)
+{
+	virtio_write32(priv->common, VIRTIO_COMMON_DEVICE_FEATURE_SELECT, 0);
+	uint64_t offered = virtio_read32(priv->common, VIRTIO_COMMON_DEVICE_FEATURE);
+	virtio_write32(priv->common, VIRTIO_COMMON_DEVICE_FEATURE_SELECT, 1);
+	offered |= (uint64_t)virtio_read32(priv->common, VIRTIO_COMMON_DEVICE_FEATURE) << 32;
+	if (!(offered & VIRTIO_F_VERSION_1))
+	{
+		return -EUNIMP;
+	}
+
+	const uint64_t wanted = VIRTIO_F_VERSION_1 | VIRTIO_F_INDIRECT_DESC | VIRTIO_BLK_F_SIZE_MAX | VIRTIO_BLK_F_SEG_MAX |
+							VIRTIO_BLK_F_RO | VIRTIO_BLK_F_BLK_SIZE | VIRTIO_BLK_F_FLUSH;
+	priv->features = offered & wanted;
+	virtio_write32(priv->common, VIRTIO_COMMON_DRIVER_FEATURE_SELECT, 0);
+	virtio_write32(priv->common, VIRTIO_COMMON_DRIVER_FEATURE, (uint32_t)(priv->features & 0xFFFFFFFFu));
+	virtio_write32(priv->common, VIRTIO_COMMON_DRIVER_FEATURE_SELECT, 1);
+	virtio_write32(priv->common, VIRTIO_COMMON_DRIVER_FEATURE, (uint32_t)(priv->features >> 32));
+
+	virtio_blk_status_set(priv, VIRTIO_STATUS_FEATURES_OK);
+	if (!(virtio_read8(priv->common, VIRTIO_COMMON_DEVICE_STATUS) & VIRTIO_STATUS_FEATURES_OK))
+	{
+		return -EUNIMP; // the device rejected our feature subset
+	}
+
+	return 0;
+}
+
+static void virtio_blk_interrupt_handler(struct interrupt_frame *frame, void *private)
+{
+	struct virtio_blk_private *priv = private;
+	priv->irq.count++;
+	task_wakeup(priv);
+}
+
+// route the request queue through MSI-X entry zero, failure is not fatal as the driver falls back to polling
+static int virtio_blk_interrupts_init(struct virtio_blk_private *priv)
+{
+	int res = 0;
+	if (!apic_enabled())
+	{
+		res = -EUNIMP;
+		goto out;
+	}
+
+	res = pci_msix_init(priv->device, &priv->irq.msix);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	int vector = idt_allocate_vector(virtio_blk_interrupt_handler, priv);
+	if (vector < 0)
+	{
+		res = vector;
+		goto out;
+	}
+
+	res = pci_msix_set_vector(&priv->irq.msix, 0, vector, apic_id());
+	if (res < 0)
+	{
+		idt_free_vector(vector);
+		goto out;
+	}
+
+	pci_msix_enable(&priv->irq.msix);
+	priv->irq.vector = vector;
+
+out:
+	return res;
+}
+
+static int virtio_blk_queue_init(struct virtio_blk_private *priv)
+{
+	virtio_write16(priv->common, VIRTIO_COMMON_QUEUE_SELECT, 0);
+	uint16_t size = virtio_read16(priv->common, VIRTIO_COMMON_QUEUE_SIZE);
+	if (size == 0)
+	{
+		return -EIO;
+	}
+
+	if (size > VIRTIO_BLK_QUEUE_MAX_SIZE)
+	{
+		size = VIRTIO_BLK_QUEUE_MAX_SIZE;
+	}
+
+	// with indirect descriptors every request occupies a single ring descriptor, otherwise a fixed run of them
+	priv->queue.size = size;
+	priv->queue.slots = (priv->features & VIRTIO_F_INDIRECT_DESC) ? size : size / VIRTIO_BLK_DESCRIPTORS_PER_REQUEST;
+	if (priv->queue.slots == 0)
+	{
+		return -EUNIMP;
+	}
+
+	priv->queue.desc = kzalloc(sizeof(struct virtq_desc) * size);
+	priv->queue.avail = kzalloc(sizeof(struct virtq_avail) + sizeof(uint16_t) * (size + 1));
+	priv->queue.used = kzalloc(sizeof(struct virtq_used) + sizeof(struct virtq_used_elem) * size + sizeof(uint16_t));
+	priv->queue.requests = kzalloc(sizeof(struct virtio_blk_request) * priv->queue.slots);
+	if (!priv->queue.desc || !priv->queue.avail || !priv->queue.used || !priv->queue.requests)
+	{
+		return -ENOMEM;
+	}
+
+	virtio_write16(priv->common, VIRTIO_COMMON_QUEUE_SIZE, size);
+	virtio_write64(priv->common, VIRTIO_COMMON_QUEUE_DESC, (uint64_t)(uintptr_t)priv->queue.desc);
+	virtio_write64(priv->common, VIRTIO_COMMON_QUEUE_DRIVER, (uint64_t)(uintptr_t)priv->queue.avail);
+	virtio_write64(priv->common, VIRTIO_COMMON_QUEUE_DEVICE, (uint64_t)(uintptr_t)priv->queue.used);
+
+	virtio_write16(priv->common, VIRTIO_COMMON_MSIX_CONFIG, VIRTIO_MSI_NO_VECTOR);
+	if (priv->irq.vector)
+	{
+		virtio_write16(priv->common, VIRTIO_COMMON_QUEUE_MSIX_VECTOR, 0);
+		if (virtio_read16(priv->common, VIRTIO_COMMON_QUEUE_MSIX_VECTOR) == VIRTIO_MSI_NO_VECTOR)
+		{
+			// the device could not allocate the vector, poll instead
+			pci_msix_disable(&priv->irq.msix);
+			idt_free_vector(priv->irq.vector);
+			priv->irq.vector = 0;
+		}
+	}
+
+	priv->queue.notify_off = virtio_read16(priv->common, VIRTIO_COMMON_QUEUE_NOTIFY_OFF);
+	virtio_write16(priv->common, VIRTIO_COMMON_QUEUE_ENABLE, 1);
+	return 0;
+}
+
+// resets the device so it stops using the rings, then releases them and the interrupt vector
+static void virtio_blk_free(struct virtio_blk_private *priv)
+{
+	if (priv->common)
+	{
+		virtio_blk_reset(priv);
+	}
+
+	if (priv->irq.vector)
+	{
+		pci_msix_disable(&priv->irq.msix);
+		idt_free_vector(priv->irq.vector);
+		priv->irq.vector = 0;
+	}
+
+	kfree(priv->queue.desc);
+	kfree(priv->queue.avail);
+	kfree(priv->queue.used);
+	kfree(priv->queue.requests);
+	kfree(priv);
+}
+
+// describes one request in its slot and returns the head descriptor to publish in the available ring
+static int virtio_blk_request_prepare(struct virtio_blk_private *priv, uint16_t slot, uint32_t type, uint64_t sector, void *buf, size_t total_bytes, uint16_t *head_out)
+{
+	struct virtio_blk_request *request = &priv->queue.requests[slot];
+	bool indirect = (priv->features & VIRTIO_F_INDIRECT_DESC) != 0;
+	uint16_t base = indirect ? 0 : (uint16_t)(slot * VIRTIO_BLK_DESCRIPTORS_PER_REQUEST);
+	struct virtq_desc *table = indirect ? request->indirect : &priv->queue.desc[base];
+
+	request->header.type = type;
+	request->header.reserved = 0;
+	request->header.sector = sector;
+	request->status = 0xFF;
+
+	uint16_t total = 0;
+	table[total].addr = (uint64_t)(uintptr_t)&request->header;
+	table[total].len = sizeof(struct virtio_blk_outhdr);
+	table[total].flags = 0;
+	total++;
+
+	uintptr_t addr = (uintptr_t)buf;
+	while (total_bytes > 0)
+	{
+		if (total > priv->max_segments)
+		{
+			return -EINVARG;
+		}
+
+		size_t chunk = total_bytes > priv->max_segment_size ? priv->max_segment_size : total_bytes;
+		table[total].addr = (uint64_t)addr;
+		table[total].len = (uint32_t)chunk;
+		table[total].flags = type == VIRTIO_BLK_T_IN ? VIRTQ_DESC_F_WRITE : 0; // the device writes into read buffers
+		addr += chunk;
+		total_bytes -= chunk;
+		total++;
+	}
+
+	table[total].addr = (uint64_t)(uintptr_t)&request->status;
+	table[total].len = 1;
+	table[total].flags = VIRTQ_DESC_F_WRITE;
+	total++;
+
+	for (uint16_t i = 0; i + 1 < total; i++)
+	{
+		table[i].flags |= VIRTQ_DESC_F_NEXT;
+		table[i].next = (uint16_t)(base + i + 1);
+	}
+
+	if (indirect)
+	{
+		priv->queue.desc[slot].addr = (uint64_t)(uintptr_t)request->indirect;
+		priv->queue.desc[slot].len = (uint32_t)(sizeof(struct virtq_desc) * total);
+		priv->queue.desc[slot].flags = VIRTQ_DESC_F_INDIRECT;
+		priv->queue.desc[slot].next = 0;
+		*head_out = slot;
+	}
+	else
+	{
+		*head_out = base;
+	}
+
+	return 0;
+}
+
+static bool virtio_blk_requests_finished(struct virtio_blk_private *priv, uint16_t total)
+{
+	return (uint16_t)(priv->queue.used->idx - priv->queue.last_used_idx) >= total;
+}
+
+// spin briefly, then halt until the queue interrupt arrives. until an interrupt has been seen we keep polling
+static int virtio_blk_wait(struct virtio_blk_private *priv, uint16_t total)
+{
+	for (uint32_t i = 0; i < VIRTIO_BLK_POLL_SPIN_ITERATIONS; i++)
+	{
+		if (virtio_blk_requests_finished(priv, total))
+		{
+			return 0;
+		}
+
+		__asm__ volatile("pause");
+	}
+
+	if (priv->irq.verified)
+	{
+		bool were_enabled = interrupts_enabled();
+		disable_interrupts();
+		for (uint32_t i = 0; i < VIRTIO_BLK_INTERRUPT_WAIT_MAX_WAKEUPS && !virtio_blk_requests_finished(priv, total); i++)
+		{
+			task_wait_for_wakeup(priv);
+		}
+
+		if (were_enabled)
+		{
+			enable_interrupts();
+		}
+	}
+	else
+	{
+		for (uint32_t i = VIRTIO_BLK_POLL_SPIN_ITERATIONS; i < VIRTIO_BLK_POLL_TIMEOUT_ITERATIONS && !virtio_blk_requests_finished(priv, total); i++)
+		{
+			__asm__ volatile("pause");
+		}
+	}
+
+	return virtio_blk_requests_finished(priv, total) ? 0 : -ETIMEOUT;
+}
+
+// publishes every prepared request with a single index update and doorbell kick, then waits for all of them
+static int virtio_blk_submit_batch(struct virtio_blk_private *priv, uint16_t *heads, uint16_t total)
+{
+	int res = 0;
+	uint16_t avail_idx = priv->queue.avail->idx;
+	for (uint16_t i = 0; i < total; i++)
+	{
+		priv->queue.avail->ring[(uint16_t)(avail_idx + i) % priv->queue.size] = heads[i];
+	}
+
+	virtio_memory_barrier();
+	priv->queue.avail->idx = (uint16_t)(avail_idx + total);
+	virtio_memory_barrier();
+	virtio_write16(priv->notify, priv->queue.notify_off * priv->notify_multiplier, 0);
+
+	res = virtio_blk_wait(priv, total);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	priv->queue.last_used_idx = (uint16_t)(priv->queue.last_used_idx + total);
+	for (uint16_t i = 0; i < total; i++)
+	{
+		if (priv->queue.requests[i].status != VIRTIO_BLK_S_OK)
+		{
+			res = -EIO;
+		}
+	}
+
+	if (priv->irq.count)
+	{
+		priv->irq.verified = true;
+	}
+
+out:
+	return res;
+}
+
+static int virtio_blk_transfer(struct virtio_blk_private *priv, uint64_t lba, uint32_t total_sectors, void *buf, bool write)
+{
+	int res = 0;
+	if (lba + total_sectors > priv->capacity)
+	{
+		return -EIO;
+	}
+
+	if (write && (priv->features & VIRTIO_BLK_F_RO))
+	{
+		return -EIO;
+	}
+
+	uint64_t max_request_bytes = (uint64_t)priv->max_segments * priv->max_segment_size;
+	uint32_t max_request_sectors = VIRTIO_BLK_MAX_REQUEST_SECTORS;
+	if (max_request_bytes / VIRTIO_BLK_SECTOR_SIZE < max_request_sectors)
+	{
+		max_request_sectors = (uint32_t)(max_request_bytes / VIRTIO_BLK_SECTOR_SIZE);
+	}
+
+	uint16_t heads[VIRTIO_BLK_QUEUE_MAX_SIZE];
+	uint8_t *current_buf = buf;
+	while (total_sectors > 0)
+	{
+		uint16_t total = 0;
+		while (total < priv->queue.slots && total_sectors > 0)
+		{
+			uint32_t chunk = total_sectors > max_request_sectors ? max_request_sectors : total_sectors;
+			size_t total_bytes = (size_t)chunk * VIRTIO_BLK_SECTOR_SIZE;
+			res = virtio_blk_request_prepare(priv, total, write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN, lba, current_buf, total_bytes, &heads[total]);
+			if (res < 0)
+			{
+				goto out;
+			}
+
+			total++;
+			lba += chunk;
+			current_buf += total_bytes;
+			total_sectors -= chunk;
+		}
+
+		res = virtio_blk_submit_batch(priv, heads, total);
+		if (res < 0)
+		{
+			goto out;
+		}
+	}
+
+	if (write && (priv->features & VIRTIO_BLK_F_FLUSH))
+	{
+		res = virtio_blk_request_prepare(priv, 0, VIRTIO_BLK_T_FLUSH, 0, NULL, 0, &heads[0]);
+		if (res < 0)
+		{
+			goto out;
+		}
+
+		res = virtio_blk_submit_batch(priv, heads, 1);
+	}
+
+out:
+	return res;
+}
+
+static int virtio_blk_disk_driver_mount_for_device(struct disk_driver *driver, struct pci_device *dev)
+{
+	int res = 0;
+	struct virtio_blk_private *priv = kzalloc(sizeof(struct virtio_blk_private));
+	if (!priv)
+	{
+		return -ENOMEM;
+	}
+
+	priv->device = dev;
+	pci_enable_bus_master(dev);
+	res = virtio_blk_capabilities_map(priv);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = virtio_blk_reset(priv);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	virtio_blk_status_set(priv, VIRTIO_STATUS_ACKNOWLEDGE);
+	virtio_blk_status_set(priv, VIRTIO_STATUS_DRIVER);
+	res = virtio_blk_features_negotiate(priv);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	priv->capacity = (uint64_t)virtio_read32(priv->config, VIRTIO_BLK_CONFIG_CAPACITY) |
+					 ((uint64_t)virtio_read32(priv->config, VIRTIO_BLK_CONFIG_CAPACITY + 4) << 32);
+	priv->max_segments = VIRTIO_BLK_MAX_SEGMENTS;
+	if (priv->features & VIRTIO_BLK_F_SEG_MAX)
+	{
+		uint32_t seg_max = virtio_read32(priv->config, VIRTIO_BLK_CONFIG_SEG_MAX);
+		if (seg_max && seg_max < priv->max_segments)
+		{
+			priv->max_segments = seg_max;
+		}
+	}
+
+	priv->max_segment_size = VIRTIO_BLK_MAX_REQUEST_SECTORS * VIRTIO_BLK_SECTOR_SIZE;
+	if (priv->features & VIRTIO_BLK_F_SIZE_MAX)
+	{
+		uint32_t size_max = virtio_read32(priv->config, VIRTIO_BLK_CONFIG_SIZE_MAX);
+		if (size_max >= VIRTIO_BLK_SECTOR_SIZE && size_max < priv->max_segment_size)
+		{
+			priv->max_segment_size = size_max & ~(VIRTIO_BLK_SECTOR_SIZE - 1); // keep segments whole sectors
+		}
+	}
+
+	// interrupts are optional, on failure completions are polled
+	virtio_blk_interrupts_init(priv);
+
+	res = virtio_blk_queue_init(priv);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	virtio_blk_status_set(priv, VIRTIO_STATUS_DRIVER_OK);
+
+	struct disk *disk = NULL;
+	res = disk_create_new(driver, NULL, MYOS_DISK_TYPE_REAL, 0, 0, VIRTIO_BLK_SECTOR_SIZE, priv, &disk);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	disk->limits.total_sectors = priv->capacity;
+	disk->limits.max_transfer_sectors = VIRTIO_BLK_MAX_REQUEST_SECTORS * priv->queue.slots;
+	if (priv->features & VIRTIO_BLK_F_BLK_SIZE)
+	{
+		disk->limits.write_granularity_sectors = virtio_read32(priv->config, VIRTIO_BLK_CONFIG_BLK_SIZE) / VIRTIO_BLK_SECTOR_SIZE;
+	}
+
+out:
+	if (res < 0)
+	{
+		virtio_blk_free(priv);
+	}
+
+	return res;
+}
+
+static int virtio_blk_disk_driver_mount(struct disk_driver *driver)
+{
+	int res = 0;
+	size_t total_pci = pci_device_count();
+	for (size_t i = 0; i < total_pci; i++)
+	{
+		struct pci_device *dev = NULL;
+		res = pci_device_get(i, &dev);
+		if (res < 0)
+		{
+			break;
+		}
+
+		if (virtio_blk_pci_device(dev))
+		{
+			res = virtio_blk_disk_driver_mount_for_device(driver, dev);
+			if (res < 0)
+			{
+				break;
+			}
+		}
+	}
+
+	return res;
+}
+
+static void virtio_blk_disk_driver_unmount(struct disk *disk)
+{
+	struct virtio_blk_private *priv = disk_private_data_driver(disk);
+	if (!priv || disk->type != MYOS_DISK_TYPE_REAL)
+	{
+		return;
+	}
+
+	virtio_blk_free(priv);
+	disk->driver_private = NULL;
+}
+
+static int virtio_blk_disk_driver_read(struct disk *disk, uint64_t lba, uint32_t total_sectors, void *buf)
+{
+	struct disk *hw = disk_hardware_disk(disk);
+	return virtio_blk_transfer(disk_private_data_driver(hw), lba, total_sectors, buf, false);
+}
+
+static int virtio_blk_disk_driver_write(struct disk *disk, uint64_t lba, uint32_t total_sectors, const void *buf)
+{
+	struct disk *hw = disk_hardware_disk(disk);
+	return virtio_blk_transfer(disk_private_data_driver(hw), lba, total_sectors, (void *)buf, true);
+}
+
+static int virtio_blk_disk_driver_mount_partition(struct disk *disk, uint64_t starting_lba, uint64_t ending_lba, struct disk **partition_disk_out)
+{
+	return disk_create_new(disk->driver, disk->hardware_disk, MYOS_DISK_TYPE_PARTITION, starting_lba, ending_lba, disk->sector_size, NULL, partition_disk_out);
+}
+
+static struct disk_driver virtio_blk_driver = {
+	.name = "VIRTIO-BLK",
+	.functions = {
+		.loaded = NULL,
+		.unloaded = NULL,
+		.mount = virtio_blk_disk_driver_mount,
+		.unmount = virtio_blk_disk_driver_unmount,
+		.read = virtio_blk_disk_driver_read,
+		.write = virtio_blk_disk_driver_write,
+		.mount_partition = virtio_blk_disk_driver_mount_partition,
+	},
+};
+
+struct disk_driver *virtio_blk_driver_init()
+{
+	return &virtio_blk_driver;
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "disk.h"
+#include "driver.h"
+#include "io/pci.h"
+
+#define VIRTIO_BLK_SECTOR_SIZE 512 // virtio-blk always addresses the device in 512 byte sectors
+
+#define VIRTIO_PCI_VENDOR_ID 0x1AF4
+#define VIRTIO_PCI_DEVICE_ID_BLOCK_LEGACY 0x1001
+#define VIRTIO_PCI_DEVICE_ID_BLOCK 0x1042
+
+// virtio vendor capability layout and structure types
+#define VIRTIO_PCI_CAP_CFG_TYPE 3
+#define VIRTIO_PCI_CAP_BAR 4
+#define VIRTIO_PCI_CAP_OFFSET 8
+#define VIRTIO_PCI_CAP_LENGTH 12
+#define VIRTIO_PCI_CAP_NOTIFY_MULTIPLIER 16
+
+#define VIRTIO_PCI_CAP_COMMON_CFG 1
+#define VIRTIO_PCI_CAP_NOTIFY_CFG 2
+#define VIRTIO_PCI_CAP_ISR_CFG 3
+#define VIRTIO_PCI_CAP_DEVICE_CFG 4
+
+// common configuration structure
+#define VIRTIO_COMMON_DEVICE_FEATURE_SELECT 0x00
+#define VIRTIO_COMMON_DEVICE_FEATURE 0x04
+#define VIRTIO_COMMON_DRIVER_FEATURE_SELECT 0x08
+#define VIRTIO_COMMON_DRIVER_FEATURE 0x0C
+#define VIRTIO_COMMON_MSIX_CONFIG 0x10
+#define VIRTIO_COMMON_NUM_QUEUES 0x12
+#define VIRTIO_COMMON_DEVICE_STATUS 0x14
+#define VIRTIO_COMMON_QUEUE_SELECT 0x16
+#define VIRTIO_COMMON_QUEUE_SIZE 0x18
+#define VIRTIO_COMMON_QUEUE_MSIX_VECTOR 0x1A
+#define VIRTIO_COMMON_QUEUE_ENABLE 0x1C
+#define VIRTIO_COMMON_QUEUE_NOTIFY_OFF 0x1E
+#define VIRTIO_COMMON_QUEUE_DESC 0x20
+#define VIRTIO_COMMON_QUEUE_DRIVER 0x28
+#define VIRTIO_COMMON_QUEUE_DEVICE 0x30
+
+#define VIRTIO_STATUS_ACKNOWLEDGE 0x01
+#define VIRTIO_STATUS_DRIVER 0x02
+#define VIRTIO_STATUS_DRIVER_OK 0x04
+#define VIRTIO_STATUS_FEATURES_OK 0x08
+#define VIRTIO_STATUS_FAILED 0x80
+
+#define VIRTIO_MSI_NO_VECTOR 0xFFFF
+
+// feature bits
+#define VIRTIO_BLK_F_SIZE_MAX (1ull << 1)
+#define VIRTIO_BLK_F_SEG_MAX (1ull << 2)
+#define VIRTIO_BLK_F_RO (1ull << 5)
+#define VIRTIO_BLK_F_BLK_SIZE (1ull << 6)
+#define VIRTIO_BLK_F_FLUSH (1ull << 9)
+#define VIRTIO_F_INDIRECT_DESC (1ull << 28)
+#define VIRTIO_F_VERSION_1 (1ull << 32)
+
+// device specific configuration
+#define VIRTIO_BLK_CONFIG_CAPACITY 0x00
+#define VIRTIO_BLK_CONFIG_SIZE_MAX 0x08
+#define VIRTIO_BLK_CONFIG_SEG_MAX 0x0C
+#define VIRTIO_BLK_CONFIG_BLK_SIZE 0x14
+
+#define VIRTIO_BLK_T_IN 0
+#define VIRTIO_BLK_T_OUT 1
+#define VIRTIO_BLK_T_FLUSH 4
+#define VIRTIO_BLK_S_OK 0
+
+#define VIRTQ_DESC_F_NEXT 1
+#define VIRTQ_DESC_F_WRITE 2
+#define VIRTQ_DESC_F_INDIRECT 4
+
+#define VIRTIO_BLK_QUEUE_MAX_SIZE 128
+#define VIRTIO_BLK_MAX_SEGMENTS 16
+#define VIRTIO_BLK_MAX_REQUEST_SECTORS 256
+
+// header and status descriptors around the data segments of a request
+#define VIRTIO_BLK_DESCRIPTORS_PER_REQUEST (VIRTIO_BLK_MAX_SEGMENTS + 2)
+
+#define VIRTIO_BLK_RESET_TIMEOUT_ITERATIONS 1000000u
+#define VIRTIO_BLK_POLL_SPIN_ITERATIONS 2000u
+#define VIRTIO_BLK_POLL_TIMEOUT_ITERATIONS 10000000u
+#define VIRTIO_BLK_INTERRUPT_WAIT_MAX_WAKEUPS 100000u
+
+struct virtq_desc
+{
+	uint64_t addr;
+	uint32_t len;
+	uint16_t flags;
+	uint16_t next;
+} __attribute__((packed));
+
+struct virtq_avail
+{
+	uint16_t flags;
+	volatile uint16_t idx;
+	uint16_t ring[];
+} __attribute__((packed));
+
+struct virtq_used_elem
+{
+	uint32_t id;
+	uint32_t len;
+} __attribute__((packed));
+
+struct virtq_used
+{
+	uint16_t flags;
+	volatile uint16_t idx;
+	struct virtq_used_elem ring[];
+} __attribute__((packed));
+
+struct virtio_blk_outhdr
+{
+	uint32_t type;
+	uint32_t reserved;
+	uint64_t sector;
+} __attribute__((packed));
+
+// per slot request state, the indirect table must stay 16 byte aligned
+struct virtio_blk_request
+{
+	struct virtq_desc indirect[VIRTIO_BLK_DESCRIPTORS_PER_REQUEST];
+	struct virtio_blk_outhdr header;
+	volatile uint8_t status;
+	uint8_t reserved[7];
+} __attribute__((aligned(16)));
+
+struct virtio_blk_private
+{
+	struct pci_device *device;
+	volatile uint8_t *common;
+	volatile uint8_t *notify;
+	volatile uint8_t *config;
+	uint32_t notify_multiplier;
+
+	uint64_t features;
+	uint64_t capacity;		 // in 512 byte sectors
+	uint32_t max_segments;	 // data segments per request
+	uint32_t max_segment_size;
+
+	struct
+	{
+		uint16_t size;
+		uint16_t slots;		  // requests that can be in flight at once
+		uint16_t last_used_idx;
+		uint16_t notify_off;
+		struct virtq_desc *desc;
+		struct virtq_avail *avail;
+		struct virtq_used *used;
+		struct virtio_blk_request *requests;
+	} queue;
+
+	struct
+	{
+		struct pci_msix msix;
+		int vector;				 // IDT vector of the queue interrupt, zero when polling
+		bool verified;			 // set once a completion interrupt has been observed
+		volatile uint64_t count; // total completion interrupts received
+	} irq;
+};
+
+struct disk_driver *virtio_blk_driver_init();
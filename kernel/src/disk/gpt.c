@@ -12,11 +12,11 @@ size_t gpt_partition_table_header_real_size(struct gpt_partition_table_header *h
 	return sizeof(*header) + (header->header_size - offsetof(struct gpt_partition_table_header, reserved2));
 }
 
-int gpt_partition_table_header_read(struct gpt_partition_table_header *header_out)
+int gpt_partition_table_header_read(struct disk *disk, struct gpt_partition_table_header *header_out)
 {
 	int res = 0;
-	char sector[gpt_primary_disk->sector_size];
-	res = disk_read_block(gpt_primary_disk, GPT_PARTITION_TABLE_HEADER_LBA, 1, sector);
+	char sector[disk->sector_size];
+	res = disk_read_block(disk, GPT_PARTITION_TABLE_HEADER_LBA, 1, sector);
 	if (res < 0)
 	{
 		goto out;
@@ -27,21 +27,21 @@ out:
 	return res;
 }
 
-int gpt_mount_partitions(struct gpt_partition_table_header *partition_header)
+int gpt_mount_partitions(struct disk *disk, struct gpt_partition_table_header *partition_header)
 {
 	int res = 0;
 	size_t total_entries = partition_header->total_array_entries;
 	uint64_t starting_lba = partition_header->guid_array_lba_start;
-	uint64_t starting_byte = starting_lba * gpt_primary_disk->sector_size;
+	uint64_t starting_byte = starting_lba * disk->sector_size;
 	size_t entry_size = partition_header->array_entry_size;
-	struct disk_stream *streamer = diskstreamer_new(gpt_primary_disk->id);
+	struct disk_stream *streamer = diskstreamer_new_from_disk(disk);
 	if (!streamer)
 	{
 		res = -EINVARG;
 		goto out;
 	}
 
-	res = diskstreamer_seek(streamer, (int)starting_byte);
+	res = diskstreamer_seek(streamer, (long)starting_byte);
 	if (res < 0)
 	{
 		goto out;
@@ -65,7 +65,7 @@ int gpt_mount_partitions(struct gpt_partition_table_header *partition_header)
 			continue;
 		}
 
-		res = disk_create_partition(gpt_primary_disk, entry->starting_lba, entry->ending_lba, &partition_virtual_disk);
+		res = disk_create_partition(disk, entry->starting_lba, entry->ending_lba, &partition_virtual_disk);
 		if (res < 0)
 		{
 			goto out;
@@ -81,18 +81,12 @@ out:
 	return res;
 }
 
-int gpt_init()
+// mounts the filesystem of every partition listed in the GPT of a hardware disk
+int gpt_mount_disk(struct disk *disk)
 {
 	int res = 0;
 	struct gpt_partition_table_header partition_header = {0};
-	gpt_primary_disk = disk_get(0); // needs hard disk 0 to be GPT
-	if (!gpt_primary_disk)
-	{
-		res = -EINVARG;
-		goto out;
-	}
-
-	res = gpt_partition_table_header_read(&partition_header);
+	res = gpt_partition_table_header_read(disk, &partition_header);
 	if (res < 0)
 	{
 		goto out;
@@ -105,7 +99,7 @@ int gpt_init()
 		goto out;
 	}
 
-	res = gpt_mount_partitions(&partition_header);
+	res = gpt_mount_partitions(disk, &partition_header);
 	if (res < 0)
 	{
 		goto out;
@@ -113,3 +107,14 @@ int gpt_init()
 out:
 	return res;
 }
+
+int gpt_init()
+{
+	gpt_primary_disk = disk_get(0); // needs hard disk 0 to be GPT
+	if (!gpt_primary_disk)
+	{
+		return -EINVARG;
+	}
+
+	return gpt_mount_disk(gpt_primary_disk);
+}
@@ -36,4 +36,7 @@ struct gpt_partition_entry
 	char partition_name[72];		// partition name (UTF-16LE)
 };
 
+struct disk;
+
 int gpt_init();
+int gpt_mount_disk(struct disk *disk);
@@ -0,0 +1,456 @@
+#include "queue.h"
+#include "disk.h"
+#include "driver.h"
+#include "status.h"
+#include "idt/idt.h"
+#include "memory/heap/kheap.h"
+#include "memory/memory.h"
+
+// completions may arrive from interrupt handlers, so list updates run with interrupts off
+static bool disk_queue_lock()
+{
+	bool were_enabled = interrupts_enabled();
+	disable_interrupts();
+	return were_enabled;
+}
+
+static void disk_queue_unlock(bool were_enabled)
+{
+	if (were_enabled)
+	{
+		enable_interrupts();
+	}
+}
+
+static struct disk_queue *disk_queue_get(struct disk *disk)
+{
+	struct disk *hw = disk_hardware_disk(disk);
+	return hw ? hw->queue : NULL;
+}
+
+struct disk_queue *disk_queue_new(struct disk *disk)
+{
+	struct disk_queue *queue = kzalloc(sizeof(struct disk_queue));
+	if (!queue)
+	{
+		return NULL;
+	}
+
+	queue->disk = disk;
+	for (int i = DISK_QUEUE_MAX_REQUESTS - 1; i >= 0; i--)
+	{
+		queue->requests[i].queue = queue;
+		queue->requests[i].fifo_next = queue->free;
+		queue->free = &queue->requests[i];
+	}
+
+	return queue;
+}
+
+static uint32_t disk_queue_max_sectors(struct disk_queue *queue)
+{
+	if (queue->max_sectors)
+	{
+		return queue->max_sectors;
+	}
+
+	uint32_t max_sectors = DISK_QUEUE_DEFAULT_MAX_SECTORS;
+	if (queue->disk->limits.max_transfer_sectors && queue->disk->limits.max_transfer_sectors < max_sectors)
+	{
+		max_sectors = queue->disk->limits.max_transfer_sectors;
+	}
+
+	return max_sectors;
+}
+
+int disk_queue_set_max_sectors(struct disk *disk, uint32_t max_sectors)
+{
+	struct disk_queue *queue = disk_queue_get(disk);
+	if (!queue)
+	{
+		return -EINVARG;
+	}
+
+	queue->max_sectors = max_sectors;
+	return 0;
+}
+
+int disk_queue_stats(struct disk *disk, struct disk_queue_stats *stats_out)
+{
+	struct disk_queue *queue = disk_queue_get(disk);
+	if (!queue)
+	{
+		return -EINVARG;
+	}
+
+	bool were_enabled = disk_queue_lock();
+	*stats_out = queue->stats;
+	disk_queue_unlock(were_enabled);
+	return 0;
+}
+
+static bool disk_queue_overlaps(uint64_t a_sector, uint32_t a_total, uint64_t b_sector, uint32_t b_total)
+{
+	return a_sector < b_sector + b_total && b_sector < a_sector + a_total;
+}
+
+// reordering must never let a write pass an overlapping request
+static bool disk_queue_conflicts(struct disk_queue *queue, struct bio *bio)
+{
+	for (struct disk_request *request = queue->sorted; request; request = request->sorted_next)
+	{
+		if ((request->direction == BIO_WRITE || bio->direction == BIO_WRITE) &&
+			disk_queue_overlaps(request->sector, request->total_sectors, bio->sector, bio->total_sectors))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool disk_queue_merge(struct disk_queue *queue, struct bio *bio)
+{
+	uint32_t max_sectors = disk_queue_max_sectors(queue);
+	for (struct disk_request *request = queue->sorted; request; request = request->sorted_next)
+	{
+		if (request->direction != bio->direction ||
+			request->total_sectors + bio->total_sectors > max_sectors ||
+			request->total_segments + bio->total_segments > BIO_MAX_SEGMENTS)
+		{
+			continue;
+		}
+
+		if (request->sector + request->total_sectors == bio->sector)
+		{
+			request->last->next = bio;
+			request->last = bio;
+			queue->stats.back_merges++;
+		}
+		else if (bio->sector + bio->total_sectors == request->sector)
+		{
+			bio->next = request->first;
+			request->first = bio;
+			request->sector = bio->sector;
+			queue->stats.front_merges++;
+		}
+		else
+		{
+			continue;
+		}
+
+		request->total_sectors += bio->total_sectors;
+		request->total_segments += bio->total_segments;
+		return true;
+	}
+
+	return false;
+}
+
+static void disk_queue_insert(struct disk_queue *queue, struct disk_request *request)
+{
+	struct disk_request **link = &queue->sorted;
+	while (*link && (*link)->sector <= request->sector)
+	{
+		link = &(*link)->sorted_next;
+	}
+
+	request->sorted_next = *link;
+	*link = request;
+
+	request->fifo_next = NULL;
+	if (queue->fifo_tail)
+	{
+		queue->fifo_tail->fifo_next = request;
+	}
+	else
+	{
+		queue->fifo_head = request;
+	}
+
+	queue->fifo_tail = request;
+}
+
+static void disk_queue_remove(struct disk_queue *queue, struct disk_request *request)
+{
+	for (struct disk_request **link = &queue->sorted; *link; link = &(*link)->sorted_next)
+	{
+		if (*link == request)
+		{
+			*link = request->sorted_next;
+			break;
+		}
+	}
+
+	struct disk_request *previous = NULL;
+	for (struct disk_request *current = queue->fifo_head; current; previous = current, current = current->fifo_next)
+	{
+		if (current != request)
+		{
+			continue;
+		}
+
+		if (previous)
+		{
+			previous->fifo_next = current->fifo_next;
+		}
+		else
+		{
+			queue->fifo_head = current->fifo_next;
+		}
+
+		if (queue->fifo_tail == current)
+		{
+			queue->fifo_tail = previous;
+		}
+
+		break;
+	}
+
+	request->sorted_next = NULL;
+	request->fifo_next = NULL;
+}
+
+// the oldest request if its deadline passed, otherwise the next one in ascending sector order from the head
+static struct disk_request *disk_queue_pick(struct disk_queue *queue)
+{
+	if (!queue->sorted)
+	{
+		return NULL;
+	}
+
+	struct disk_request *request = NULL;
+	if (queue->fifo_head->deadline <= tsc_milliseconds())
+	{
+		request = queue->fifo_head;
+		queue->stats.deadline_dispatches++;
+	}
+	else
+	{
+		for (struct disk_request *current = queue->sorted; current; current = current->sorted_next)
+		{
+			if (current->sector >= queue->head_sector)
+			{
+				request = current;
+				break;
+			}
+		}
+
+		if (!request)
+		{
+			request = queue->sorted;
+		}
+	}
+
+	disk_queue_remove(queue, request);
+	return request;
+}
+
+static int disk_queue_bounce_get(struct disk_queue *queue, size_t size)
+{
+	if (queue->bounce_size >= size)
+	{
+		return 0;
+	}
+
+	void *bounce = kzalloc(size);
+	if (!bounce)
+	{
+		return -ENOMEM;
+	}
+
+	kfree(queue->bounce);
+	queue->bounce = bounce;
+	queue->bounce_size = size;
+	return 0;
+}
+
+// copies between the bounce buffer and the member bio segments
+static void disk_queue_bounce_copy(struct disk_queue *queue, struct disk_request *request, bool to_bounce)
+{
+	uint8_t *bounce = queue->bounce;
+	size_t sector_size = queue->disk->sector_size;
+	for (struct bio *member = request->first; member; member = member->next)
+	{
+		for (int i = 0; i < member->total_segments; i++)
+		{
+			size_t size = (size_t)member->segments[i].total_sectors * sector_size;
+			if (to_bounce)
+			{
+				memcpy(bounce, member->segments[i].buf, size);
+			}
+			else
+			{
+				memcpy(member->segments[i].buf, bounce, size);
+			}
+
+			bounce += size;
+		}
+	}
+}
+
+static void disk_queue_request_complete(struct bio *bio)
+{
+	struct disk_request *request = bio->private;
+	struct disk_queue *queue = request->queue;
+	int status = bio->status;
+	if (request->bounced && request->direction == BIO_READ && status == 0)
+	{
+		disk_queue_bounce_copy(queue, request, false);
+	}
+
+	bool were_enabled = disk_queue_lock();
+	struct bio *member = request->first;
+	queue->stats.completed++;
+	queue->stats.service_time += read_tsc() - request->dispatched_at;
+	queue->stats.depth--;
+	request->first = NULL;
+	request->last = NULL;
+	request->fifo_next = queue->free;
+	queue->free = request;
+	disk_queue_unlock(were_enabled);
+
+	while (member)
+	{
+		struct bio *next = member->next;
+		member->next = NULL;
+		bio_complete(member, status);
+		member = next;
+	}
+}
+
+static void disk_queue_dispatch(struct disk_queue *queue, struct disk_request *request)
+{
+	struct bio *bio = &request->bio;
+	bio_init(bio, queue->disk, request->direction, request->sector);
+	bio->sector = request->sector;
+	bio->completion = disk_queue_request_complete;
+	bio->private = request;
+	for (struct bio *member = request->first; member; member = member->next)
+	{
+		for (int i = 0; i < member->total_segments; i++)
+		{
+			bio_add_segment(bio, member->segments[i].buf, member->segments[i].total_sectors);
+		}
+	}
+
+	request->bounced = false;
+	size_t total_bytes = (size_t)request->total_sectors * queue->disk->sector_size;
+	if (bio->total_segments > 1 && !queue->disk->driver->functions.submit && disk_queue_bounce_get(queue, total_bytes) == 0)
+	{
+		if (request->direction == BIO_WRITE)
+		{
+			disk_queue_bounce_copy(queue, request, true);
+		}
+
+		bio->segments[0].buf = queue->bounce;
+		bio->segments[0].total_sectors = request->total_sectors;
+		bio->total_segments = 1;
+		request->bounced = true;
+	}
+
+	queue->head_sector = request->sector + request->total_sectors;
+	queue->stats.dispatched++;
+	request->dispatched_at = read_tsc();
+	int res = bio_dispatch(bio);
+	if (res < 0)
+	{
+		bio_complete(bio, res);
+	}
+}
+
+// dispatches every pending request, plugged or not
+void disk_queue_run(struct disk_queue *queue)
+{
+	while (true)
+	{
+		bool were_enabled = disk_queue_lock();
+		struct disk_request *request = disk_queue_pick(queue);
+		disk_queue_unlock(were_enabled);
+		if (!request)
+		{
+			break;
+		}
+
+		disk_queue_dispatch(queue, request);
+	}
+}
+
+int disk_queue_add(struct disk_queue *queue, struct bio *bio)
+{
+	bool were_enabled = disk_queue_lock();
+	if (disk_queue_conflicts(queue, bio))
+	{
+		disk_queue_unlock(were_enabled);
+		disk_queue_run(queue);
+		were_enabled = disk_queue_lock();
+	}
+
+	if (!queue->free)
+	{
+		disk_queue_unlock(were_enabled);
+		disk_queue_run(queue);
+		were_enabled = disk_queue_lock();
+	}
+
+	queue->stats.submitted++;
+	if (!disk_queue_merge(queue, bio))
+	{
+		struct disk_request *request = queue->free;
+		if (!request)
+		{
+			// every request is still in flight, bypass the queue
+			disk_queue_unlock(were_enabled);
+			return bio_dispatch(bio);
+		}
+
+		queue->free = request->fifo_next;
+		request->direction = bio->direction;
+		request->sector = bio->sector;
+		request->total_sectors = bio->total_sectors;
+		request->total_segments = bio->total_segments;
+		request->first = bio;
+		request->last = bio;
+		request->deadline = tsc_milliseconds() + (bio->direction == BIO_WRITE ? DISK_QUEUE_WRITE_DEADLINE_MS : DISK_QUEUE_READ_DEADLINE_MS);
+		disk_queue_insert(queue, request);
+
+		queue->stats.depth++;
+		if (queue->stats.depth > queue->stats.max_depth)
+		{
+			queue->stats.max_depth = queue->stats.depth;
+		}
+	}
+
+	disk_queue_unlock(were_enabled);
+	if (!queue->plugged)
+	{
+		disk_queue_run(queue);
+	}
+
+	return 0;
+}
+
+// holds requests back so bios submitted until the matching unplug can be merged
+void disk_queue_plug(struct disk *disk)
+{
+	struct disk_queue *queue = disk_queue_get(disk);
+	if (queue)
+	{
+		queue->plugged++;
+	}
+}
+
+void disk_queue_unplug(struct disk *disk)
+{
+	struct disk_queue *queue = disk_queue_get(disk);
+	if (!queue || queue->plugged == 0)
+	{
+		return;
+	}
+
+	queue->plugged--;
+	if (queue->plugged == 0)
+	{
+		disk_queue_run(queue);
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "bio.h"
+#include "io/tsc.h"
+
+#define DISK_QUEUE_MAX_REQUESTS 64
+#define DISK_QUEUE_DEFAULT_MAX_SECTORS 256
+
+// a request older than its deadline is dispatched ahead of the elevator order
+#define DISK_QUEUE_READ_DEADLINE_MS 50
+#define DISK_QUEUE_WRITE_DEADLINE_MS 500
+
+struct disk;
+struct disk_queue;
+
+// one or more sector contiguous bios of the same direction, dispatched as a single bio
+struct disk_request
+{
+	struct disk_queue *queue;
+	int direction;
+	uint64_t sector;
+	uint32_t total_sectors;
+	int total_segments;
+
+	// member bios in sector order, linked through bio->next
+	struct bio *first;
+	struct bio *last;
+
+	TIME_MILLISECONDS deadline;
+	TIME_TSC dispatched_at;
+	bool bounced; // transferred through the queue bounce buffer
+
+	struct bio bio; // the bio handed to the driver
+
+	struct disk_request *sorted_next; // pending requests by ascending sector
+	struct disk_request *fifo_next;	  // pending requests by arrival, also links the free list
+};
+
+struct disk_queue_stats
+{
+	uint64_t submitted;	   // bios accepted
+	uint64_t dispatched;   // requests handed to the driver
+	uint64_t completed;	   // requests finished
+	uint64_t front_merges; // bios merged in front of a pending request
+	uint64_t back_merges;  // bios merged behind a pending request
+	uint64_t deadline_dispatches; // requests dispatched out of elevator order because they expired
+	uint32_t depth;		   // requests queued or in flight right now
+	uint32_t max_depth;
+	TIME_TSC service_time; // total dispatch to completion time of completed requests
+};
+
+struct disk_queue
+{
+	struct disk *disk; // the hardware disk this queue feeds
+	uint32_t max_sectors; // largest merged request, zero picks a default from the disk limits
+	int plugged;		  // while non zero requests are held back for merging
+	uint64_t head_sector; // where the last dispatched request ended
+
+	struct disk_request requests[DISK_QUEUE_MAX_REQUESTS];
+	struct disk_request *free;
+	struct disk_request *sorted;
+	struct disk_request *fifo_head;
+	struct disk_request *fifo_tail;
+
+	// lets drivers without a submit hook transfer a scattered request with a single command
+	void *bounce;
+	size_t bounce_size;
+
+	struct disk_queue_stats stats;
+};
+
+struct disk_queue *disk_queue_new(struct disk *disk);
+int disk_queue_add(struct disk_queue *queue, struct bio *bio);
+void disk_queue_run(struct disk_queue *queue);
+void disk_queue_plug(struct disk *disk);
+void disk_queue_unplug(struct disk *disk);
+int disk_queue_set_max_sectors(struct disk *disk, uint32_t max_sectors);
+int disk_queue_stats(struct disk *disk, struct disk_queue_stats *stats_out);
@@ -4,6 +4,8 @@
 #include "config.h"
 #include "kernel.h"
 #include "status.h"
+#include "bio.h"
+#include "queue.h"
 #include <stdbool.h>
 
 struct disk_stream_cache *diskstreamer_cache_new()
@@ -134,7 +136,7 @@ int diskstreamer_cache_roundrobin_add(struct disk_stream_cache *cache, struct di
 	return res;
 }
 
-int diskstreamer_cache_find(struct disk *disk, int pos, struct disk_stream_cache_sector **out_sector)
+int diskstreamer_cache_find(struct disk *disk, long pos, struct disk_stream_cache_sector **out_sector)
 {
 	int res = DISK_STREAMER_CACHE_STATUS_FOUND;
 	struct disk_stream_cache *cache = disk->cache;
@@ -195,6 +197,46 @@ int diskstreamer_cache_find(struct disk *disk, int pos, struct disk_stream_cache
 	return res;
 }
 
+// like diskstreamer_cache_find but never allocates, NULL when the sector is not cached
+static struct disk_stream_cache_sector *diskstreamer_cache_peek(struct disk *disk, long pos)
+{
+	struct disk_stream_cache *cache = disk->cache;
+	if (!cache)
+	{
+		return NULL;
+	}
+
+	long level1_size = DISK_STREAM_BUCKET1_BYTE_SIZE(disk->sector_size);
+	long level2_size = DISK_STREAM_BUCKET2_BYTE_SIZE(disk->sector_size);
+	long level3_size = DISK_STREAM_BUCKET3_BYTE_SIZE(disk->sector_size);
+
+	long level1_bucket = pos / level1_size;
+	long pos_in_level1 = pos % level1_size;
+	long level2_bucket = pos_in_level1 / level2_size;
+	long pos_in_level2 = pos_in_level1 % level2_size;
+	long level3_bucket = pos_in_level2 / level3_size;
+	if (level1_bucket >= cache->total_buckets || !cache->buckets[level1_bucket])
+	{
+		return NULL;
+	}
+
+	struct disk_stream_cache_bucket_level2 *level2 = cache->buckets[level1_bucket]->buckets[level2_bucket];
+	if (!level2)
+	{
+		return NULL;
+	}
+
+	struct disk_stream_cache_bucket_level3 *level3 = level2->buckets[level3_bucket];
+	if (!level3)
+	{
+		return NULL;
+	}
+
+	long pos_in_level3 = pos_in_level2 % level3_size;
+	int sector_index = pos_in_level3 / disk->sector_size;
+	return level3->sectors[sector_index];
+}
+
 struct disk_stream *diskstreamer_new(int disk_id)
 {
 	struct disk *disk = disk_get(disk_id);
@@ -206,32 +248,106 @@ struct disk_stream *diskstreamer_new(int disk_id)
 	return diskstreamer_new_from_disk(disk);
 }
 
+// for streams embedded in other structures or on the stack, pair with diskstreamer_release
+void diskstreamer_init(struct disk_stream *stream, struct disk *disk)
+{
+	memset(stream, 0, sizeof(struct disk_stream));
+	stream->sector_size = disk->sector_size;
+	stream->disk = disk;
+}
+
+void diskstreamer_release(struct disk_stream *stream)
+{
+	kfree(stream->batch);
+	stream->batch = NULL;
+}
+
 struct disk_stream *diskstreamer_new_from_disk(struct disk *disk)
 {
 	struct disk_stream *streamer = kzalloc(sizeof(struct disk_stream));
-	streamer->pos = 0;
-	streamer->sector_size = disk->sector_size;
-	streamer->disk = disk;
+	if (!streamer)
+	{
+		return NULL;
+	}
+
+	diskstreamer_init(streamer, disk);
 	return streamer;
 }
 
-int diskstreamer_seek(struct disk_stream *stream, int pos)
+int diskstreamer_seek(struct disk_stream *stream, long pos)
 {
 	stream->pos = pos;
 	return 0;
 }
 
-int diskstreamer_read(struct disk_stream *stream, void *out, int total)
+// looks up a run of sectors in the cache and reads every missing one under a single queue plug,
+// so that neighbouring misses reach the driver as one merged request
+static int diskstreamer_batch_fill(struct disk_stream *stream, int starting_sector, int total_sectors, struct disk_stream_cache_sector **sectors_out)
+{
+	int res = 0;
+	int total_bios = 0;
+	disk_queue_plug(stream->disk);
+	for (int i = 0; i < total_sectors; i++)
+	{
+		long real_offset = disk_real_offset(stream->disk, starting_sector + i);
+		// streams that only ever hit the cache never need the bios
+		if (!stream->batch && !diskstreamer_cache_peek(stream->disk, real_offset))
+		{
+			stream->batch = kzalloc(sizeof(struct bio) * DISK_STREAMER_BATCH_SECTORS);
+			if (!stream->batch)
+			{
+				res = -ENOMEM;
+				break;
+			}
+		}
+
+		int cache_res = diskstreamer_cache_find(stream->disk, real_offset, &sectors_out[i]);
+		if (cache_res < 0)
+		{
+			res = cache_res;
+			break;
+		}
+
+		disk_stats_cache_lookup(stream->disk, cache_res == DISK_STREAMER_CACHE_STATUS_FOUND);
+		if (cache_res == DISK_STREAMER_CACHE_STATUS_NEW_CACHE_ENTRY)
+		{
+			struct bio *bio = &stream->batch[total_bios];
+			bio_init(bio, stream->disk, BIO_READ, starting_sector + i);
+			bio_add_segment(bio, sectors_out[i]->buf, 1);
+			res = bio_submit(bio);
+			if (res < 0)
+			{
+				break;
+			}
+
+			total_bios++;
+		}
+	}
+
+	disk_queue_unplug(stream->disk);
+	for (int i = 0; i < total_bios; i++)
+	{
+		int wait_res = bio_wait(&stream->batch[i]);
+		if (wait_res < 0 && res >= 0)
+		{
+			res = wait_res;
+		}
+	}
+
+	return res;
+}
+
+static int diskstreamer_read_cached(struct disk_stream *stream, void *out, int total)
 {
 	int res = 0;
-	int offset = stream->pos;
-	int offset_aligned_down = offset;
+	long offset = stream->pos;
+	long offset_aligned_down = offset;
 	int starting_sector = 0;
 	int ending_sector = 0;
-	int total_bytes_aligned = 0;
+	long total_bytes_aligned = 0;
 	int total_sectors_to_read = 0;
-	int final_offset = 0;
-	int final_offset_aligned_up = 0;
+	long final_offset = 0;
+	long final_offset_aligned_up = 0;
 
 	if ((offset % stream->sector_size) != 0)
 	{
@@ -254,47 +370,411 @@ int diskstreamer_read(struct disk_stream *stream, void *out, int total)
 		panic("diskstreamer_read: total_sectors_to_read is negative");
 	}
 
-	for (int i = starting_sector; i < ending_sector; i++)
+	for (int batch_start = starting_sector; batch_start < ending_sector; batch_start += DISK_STREAMER_BATCH_SECTORS)
 	{
-		int offset_in_sector = stream->pos % stream->sector_size;
-		int amount_read = stream->sector_size - (stream->pos % stream->sector_size);
-		if (total < stream->sector_size)
+		int batch_total = ending_sector - batch_start;
+		if (batch_total > DISK_STREAMER_BATCH_SECTORS)
 		{
-			amount_read = total;
+			batch_total = DISK_STREAMER_BATCH_SECTORS;
 		}
 
-		long real_offset = disk_real_offset(stream->disk, i);
-		struct disk_stream_cache_sector *cache_sector = NULL;
-		int cache_res = diskstreamer_cache_find(stream->disk, real_offset, &cache_sector);
-		if (cache_res < 0)
+		struct disk_stream_cache_sector *sectors[DISK_STREAMER_BATCH_SECTORS];
+		res = diskstreamer_batch_fill(stream, batch_start, batch_total, sectors);
+		if (res < 0)
 		{
-			res = cache_res;
 			goto out;
 		}
 
-		if (cache_res == DISK_STREAMER_CACHE_STATUS_NEW_CACHE_ENTRY)
+		for (int i = 0; i < batch_total; i++)
+		{
+			int offset_in_sector = stream->pos % stream->sector_size;
+			int amount_read = stream->sector_size - offset_in_sector;
+			if (total < amount_read)
+			{
+				amount_read = total;
+			}
+
+			memcpy(out, sectors[i]->buf + offset_in_sector, amount_read);
+			out = (char *)out + amount_read;
+			stream->pos += amount_read;
+			total -= amount_read;
+		}
+	}
+
+out:
+	return res;
+}
+
+static int diskstreamer_direct_wait(struct disk_stream *stream, int total_bios)
+{
+	int res = 0;
+	disk_queue_unplug(stream->disk);
+	for (int i = 0; i < total_bios; i++)
+	{
+		int wait_res = bio_wait(&stream->batch[i]);
+		if (wait_res < 0 && res >= 0)
 		{
-			res = disk_read_block(stream->disk, i, 1, cache_sector->buf);
+			res = wait_res;
+		}
+	}
+
+	return res;
+}
+
+// the run being built is always the last bio of the batch
+static int diskstreamer_direct_flush(struct disk_stream *stream, struct bio **run, int *total_bios)
+{
+	int res = 0;
+	if (*run)
+	{
+		res = bio_submit(*run);
+		if (res < 0)
+		{
+			// never submitted, nothing to wait for
+			(*total_bios)--;
+		}
+
+		*run = NULL;
+	}
+
+	return res;
+}
+
+// reads whole sectors at the stream position into out, sectors already cached are copied from the cache
+// and every uncached run becomes a single request into out, without polluting the cache
+static int diskstreamer_read_direct(struct disk_stream *stream, void *out, int total_sectors)
+{
+	int res = 0;
+	int total_bios = 0;
+	struct bio *run = NULL;
+	if (!stream->batch)
+	{
+		stream->batch = kzalloc(sizeof(struct bio) * DISK_STREAMER_BATCH_SECTORS);
+		if (!stream->batch)
+		{
+			return -ENOMEM;
+		}
+	}
+
+	uint32_t max_sectors = DISK_STREAMER_DIRECT_MAX_SECTORS;
+	struct disk *hw = disk_hardware_disk(stream->disk);
+	if (hw && hw->limits.max_transfer_sectors && hw->limits.max_transfer_sectors < max_sectors)
+	{
+		max_sectors = hw->limits.max_transfer_sectors;
+	}
+
+	int starting_sector = (int)(stream->pos / stream->sector_size);
+	disk_queue_plug(stream->disk);
+	for (int i = 0; i < total_sectors && res >= 0; i++)
+	{
+		char *buf = (char *)out + (long)i * stream->sector_size;
+		struct disk_stream_cache_sector *cached = diskstreamer_cache_peek(stream->disk, disk_real_offset(stream->disk, starting_sector + i));
+		disk_stats_cache_lookup(stream->disk, cached != NULL);
+		if (cached)
+		{
+			res = diskstreamer_direct_flush(stream, &run, &total_bios);
+			memcpy(buf, cached->buf, stream->sector_size);
+			continue;
+		}
+
+		if (run && run->total_sectors < max_sectors)
+		{
+			bio_add_segment(run, buf, 1);
+			continue;
+		}
+
+		res = diskstreamer_direct_flush(stream, &run, &total_bios);
+		if (res < 0)
+		{
+			break;
+		}
+
+		if (total_bios == DISK_STREAMER_BATCH_SECTORS)
+		{
+			res = diskstreamer_direct_wait(stream, total_bios);
+			total_bios = 0;
+			disk_queue_plug(stream->disk);
 			if (res < 0)
 			{
-				goto out;
+				break;
 			}
 		}
 
-		for (int j = 0; j < amount_read; j++)
+		run = &stream->batch[total_bios++];
+		bio_init(run, stream->disk, BIO_READ, starting_sector + i);
+		bio_add_segment(run, buf, 1);
+	}
+
+	if (res >= 0)
+	{
+		res = diskstreamer_direct_flush(stream, &run, &total_bios);
+	}
+
+	int wait_res = diskstreamer_direct_wait(stream, total_bios);
+	if (res >= 0)
+	{
+		res = wait_res;
+	}
+
+	if (res >= 0)
+	{
+		stream->pos += (long)total_sectors * stream->sector_size;
+	}
+
+	return res;
+}
+
+// sectors the stream may read, zero when the size of the disk is unknown
+static uint64_t diskstreamer_total_sectors(struct disk *disk)
+{
+	if (disk->type == MYOS_DISK_TYPE_PARTITION)
+	{
+		return disk->ending_lba > disk->starting_lba ? disk->ending_lba - disk->starting_lba : 0;
+	}
+
+	return disk->limits.total_sectors;
+}
+
+// pulls the sectors following a sequential read into the cache ahead of the reader
+// the window is refilled once the reader is halfway through it, so the disk sees a few large requests
+static void diskstreamer_readahead(struct disk_stream *stream)
+{
+	int ending_sector = (stream->pos + stream->sector_size - 1) / stream->sector_size;
+	if (stream->readahead_sectors == 0 || ending_sector + stream->readahead_sectors / 2 <= stream->readahead_end)
+	{
+		return;
+	}
+
+	uint64_t total_sectors = diskstreamer_total_sectors(stream->disk);
+	int start = ending_sector > stream->readahead_end ? ending_sector : stream->readahead_end;
+	int end = ending_sector + stream->readahead_sectors;
+	if ((uint64_t)end > total_sectors)
+	{
+		// a failed read would leave a zeroed sector in the cache
+		end = (int)total_sectors;
+	}
+
+	for (int batch_start = start; batch_start < end; batch_start += DISK_STREAMER_BATCH_SECTORS)
+	{
+		int batch_total = end - batch_start;
+		if (batch_total > DISK_STREAMER_BATCH_SECTORS)
+		{
+			batch_total = DISK_STREAMER_BATCH_SECTORS;
+		}
+
+		struct disk_stream_cache_sector *sectors[DISK_STREAMER_BATCH_SECTORS];
+		if (diskstreamer_batch_fill(stream, batch_start, batch_total, sectors) < 0)
 		{
-			*(char *)out++ = cache_sector->buf[offset_in_sector + j];
+			break;
 		}
 
-		stream->pos += amount_read;
-		total -= amount_read;
+		stream->readahead_end = batch_start + batch_total;
+	}
+}
+
+int diskstreamer_read(struct disk_stream *stream, void *out, int total)
+{
+	int res = 0;
+	if (stream->pos == stream->last_end && stream->pos != 0)
+	{
+		stream->readahead_sectors = stream->readahead_sectors ? stream->readahead_sectors * 2 : DISK_STREAMER_READAHEAD_MIN_SECTORS;
+		if (stream->readahead_sectors > DISK_STREAMER_READAHEAD_MAX_SECTORS)
+		{
+			stream->readahead_sectors = DISK_STREAMER_READAHEAD_MAX_SECTORS;
+		}
+	}
+	else
+	{
+		stream->readahead_sectors = 0;
+		stream->readahead_end = 0;
+	}
+
+	int head = (stream->sector_size - (stream->pos % stream->sector_size)) % stream->sector_size;
+	if (head > total)
+	{
+		head = total;
+	}
+
+	// large reads go around the cache, only small sequential ones are worth reading ahead of
+	int middle_sectors = (total - head) / stream->sector_size;
+	if (middle_sectors < DISK_STREAMER_DIRECT_MIN_SECTORS || ((uintptr_t)out + head) % DISK_STREAMER_DIRECT_ALIGNMENT)
+	{
+		res = diskstreamer_read_cached(stream, out, total);
+		if (res >= 0)
+		{
+			stream->last_end = stream->pos;
+			diskstreamer_readahead(stream);
+		}
+
+		return res;
+	}
+
+	// partial sectors at either end still go through the cache
+	if (head)
+	{
+		res = diskstreamer_read_cached(stream, out, head);
+		if (res < 0)
+		{
+			goto out;
+		}
+	}
+
+	res = diskstreamer_read_direct(stream, (char *)out + head, middle_sectors);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	int tail = total - head - middle_sectors * stream->sector_size;
+	if (tail)
+	{
+		res = diskstreamer_read_cached(stream, (char *)out + total - tail, tail);
+	}
+
+	stream->last_end = stream->pos;
+out:
+	return res;
+}
+
+// read-modify-write of part of one sector through the cache
+static int diskstreamer_write_partial(struct disk_stream *stream, const void *in, int total)
+{
+	int res = 0;
+	int sector = (int)(stream->pos / stream->sector_size);
+	int offset_in_sector = stream->pos % stream->sector_size;
+	struct disk_stream_cache_sector *cached = NULL;
+	res = diskstreamer_batch_fill(stream, sector, 1, &cached);
+	if (res < 0)
+	{
+		goto out;
 	}
 
+	memcpy(cached->buf + offset_in_sector, (void *)in, total);
+	res = disk_write_block(stream->disk, sector, 1, cached->buf);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	stream->pos += total;
 out:
 	return res;
 }
 
+// writes whole sectors from in, cached copies are updated first so later reads stay coherent
+static int diskstreamer_write_direct(struct disk_stream *stream, const void *in, int total_sectors)
+{
+	int res = 0;
+	int total_bios = 0;
+	if (!stream->batch)
+	{
+		stream->batch = kzalloc(sizeof(struct bio) * DISK_STREAMER_BATCH_SECTORS);
+		if (!stream->batch)
+		{
+			return -ENOMEM;
+		}
+	}
+
+	int starting_sector = (int)(stream->pos / stream->sector_size);
+	for (int i = 0; i < total_sectors; i++)
+	{
+		struct disk_stream_cache_sector *cached = diskstreamer_cache_peek(stream->disk, disk_real_offset(stream->disk, starting_sector + i));
+		if (cached)
+		{
+			memcpy(cached->buf, (char *)in + (long)i * stream->sector_size, stream->sector_size);
+		}
+	}
+
+	uint32_t max_sectors = DISK_STREAMER_DIRECT_MAX_SECTORS;
+	struct disk *hw = disk_hardware_disk(stream->disk);
+	if (hw && hw->limits.max_transfer_sectors && hw->limits.max_transfer_sectors < max_sectors)
+	{
+		max_sectors = hw->limits.max_transfer_sectors;
+	}
+
+	disk_queue_plug(stream->disk);
+	for (int i = 0; i < total_sectors; i += max_sectors)
+	{
+		if (total_bios == DISK_STREAMER_BATCH_SECTORS)
+		{
+			res = diskstreamer_direct_wait(stream, total_bios);
+			total_bios = 0;
+			disk_queue_plug(stream->disk);
+			if (res < 0)
+			{
+				break;
+			}
+		}
+
+		uint32_t chunk = total_sectors - i < max_sectors ? total_sectors - i : max_sectors;
+		struct bio *bio = &stream->batch[total_bios];
+		bio_init(bio, stream->disk, BIO_WRITE, starting_sector + i);
+		bio_add_segment(bio, (char *)in + (long)i * stream->sector_size, chunk);
+		res = bio_submit(bio);
+		if (res < 0)
+		{
+			break;
+		}
+
+		total_bios++;
+	}
+
+	int wait_res = diskstreamer_direct_wait(stream, total_bios);
+	if (res >= 0)
+	{
+		res = wait_res;
+	}
+
+	if (res >= 0)
+	{
+		stream->pos += (long)total_sectors * stream->sector_size;
+	}
+
+	return res;
+}
+
+// writes through to the disk, nothing is left dirty in the cache
+int diskstreamer_write(struct disk_stream *stream, const void *in, int total)
+{
+	int res = 0;
+	while (total > 0)
+	{
+		int offset_in_sector = stream->pos % stream->sector_size;
+		int whole_sectors = offset_in_sector ? 0 : total / stream->sector_size;
+		if (whole_sectors > 0 && ((uintptr_t)in % DISK_STREAMER_DIRECT_ALIGNMENT) == 0)
+		{
+			res = diskstreamer_write_direct(stream, in, whole_sectors);
+			if (res < 0)
+			{
+				break;
+			}
+
+			in = (const char *)in + whole_sectors * stream->sector_size;
+			total -= whole_sectors * stream->sector_size;
+			continue;
+		}
+
+		int amount = stream->sector_size - offset_in_sector;
+		if (amount > total)
+		{
+			amount = total;
+		}
+
+		res = diskstreamer_write_partial(stream, in, amount);
+		if (res < 0)
+		{
+			break;
+		}
+
+		in = (const char *)in + amount;
+		total -= amount;
+	}
+
+	return res;
+}
+
 void diskstreamer_close(struct disk_stream *stream)
 {
+	diskstreamer_release(stream);
 	kfree(stream);
 }
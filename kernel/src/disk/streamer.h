@@ -5,7 +5,20 @@
 #define DISK_STREAMER_CACHE_STATUS_NEW_CACHE_ENTRY 0x01
 #define DISK_STREAMER_CACHE_STATUS_FOUND 0x00
 
-#define DISK_STREAMER_MAX_CACHE_SECTOR_SIZE 2048
+#define DISK_STREAMER_MAX_CACHE_SECTOR_SIZE 4096
+
+// cache misses submitted together so the request queue can merge them
+#define DISK_STREAMER_BATCH_SECTORS 16
+
+// reads covering at least this many whole sectors skip the sector cache and land in the caller's buffer
+#define DISK_STREAMER_DIRECT_MIN_SECTORS 8
+#define DISK_STREAMER_DIRECT_MAX_SECTORS 256
+// drivers hand buffers to DMA engines that need at least dword alignment
+#define DISK_STREAMER_DIRECT_ALIGNMENT 4
+
+// sequential reads pull this many sectors past the read into the cache, doubling up to the maximum
+#define DISK_STREAMER_READAHEAD_MIN_SECTORS 8
+#define DISK_STREAMER_READAHEAD_MAX_SECTORS 128
 
 // 64 cache sectors per bucket
 #define DISK_STREAM_LEVEL3_SECTORS_ARRAY_SIZE 64
@@ -53,16 +66,27 @@ struct disk_stream_cache
 	struct disk_stream_cache_roundrobin mem_roundrobin;
 };
 
+struct bio;
+// cheap enough to keep one per reader, the sector cache behind it is shared by every stream on the disk
 struct disk_stream
 {
-	int pos;
+	long pos; // byte offset into the disk, FAT32 volumes can be larger than 2 GB
 	int sector_size;
 	struct disk *disk;
+	struct bio *batch; // DISK_STREAMER_BATCH_SECTORS bios for cache misses, allocated on the first miss
+
+	// read-ahead, a read starting where the previous one ended counts as sequential
+	long last_end;
+	int readahead_sectors; // zero until the stream looks sequential
+	int readahead_end;	   // first sector past what read-ahead already pulled in
 };
 
 struct disk_stream *diskstreamer_new(int disk_id);
 struct disk_stream *diskstreamer_new_from_disk(struct disk *disk);
-int diskstreamer_seek(struct disk_stream *stream, int pos);
+void diskstreamer_init(struct disk_stream *stream, struct disk *disk);
+void diskstreamer_release(struct disk_stream *stream);
+int diskstreamer_seek(struct disk_stream *stream, long pos);
 int diskstreamer_read(struct disk_stream *stream, void *out, int total);
+int diskstreamer_write(struct disk_stream *stream, const void *in, int total);
 void diskstreamer_close(struct disk_stream *stream);
 struct disk_stream_cache *diskstreamer_cache_new();
\ No newline at end of file
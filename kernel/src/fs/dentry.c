@@ -0,0 +1,223 @@
+#include "dentry.h"
+#include "file.h"
+#include "disk/disk.h"
+#include "string/string.h"
+#include "memory/memory.h"
+#include "status.h"
+
+static struct dentry_cache dentry_cache;
+
+void dentry_cache_init()
+{
+	memset(&dentry_cache, 0, sizeof(dentry_cache));
+	for (int i = MYOS_DENTRY_CACHE_ENTRIES - 1; i >= 0; i--)
+	{
+		dentry_cache.entries[i].lru_next = dentry_cache.free;
+		dentry_cache.free = &dentry_cache.entries[i];
+	}
+
+	dentry_cache.next_id = 1;
+}
+
+// FNV-1a over the whole key
+static uint32_t dentry_hash(struct disk *disk, uint32_t parent_id, const char *name, int len)
+{
+	uint32_t hash = 2166136261u;
+	uint32_t key[] = {(uint32_t)disk->id, parent_id};
+	uint8_t *bytes = (uint8_t *)key;
+	for (size_t i = 0; i < sizeof(key); i++)
+	{
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+
+	for (int i = 0; i < len; i++)
+	{
+		hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+static void dentry_lru_unlink(struct dentry *entry)
+{
+	if (entry->lru_prev)
+	{
+		entry->lru_prev->lru_next = entry->lru_next;
+	}
+	else
+	{
+		dentry_cache.lru_head = entry->lru_next;
+	}
+
+	if (entry->lru_next)
+	{
+		entry->lru_next->lru_prev = entry->lru_prev;
+	}
+	else
+	{
+		dentry_cache.lru_tail = entry->lru_prev;
+	}
+
+	entry->lru_prev = NULL;
+	entry->lru_next = NULL;
+}
+
+static void dentry_lru_push(struct dentry *entry)
+{
+	entry->lru_prev = NULL;
+	entry->lru_next = dentry_cache.lru_head;
+	if (dentry_cache.lru_head)
+	{
+		dentry_cache.lru_head->lru_prev = entry;
+	}
+	else
+	{
+		dentry_cache.lru_tail = entry;
+	}
+
+	dentry_cache.lru_head = entry;
+}
+
+static void dentry_release(struct dentry *entry)
+{
+	struct dentry **link = &dentry_cache.buckets[entry->hash % MYOS_DENTRY_CACHE_BUCKETS];
+	while (*link && *link != entry)
+	{
+		link = &(*link)->hash_next;
+	}
+
+	if (*link)
+	{
+		*link = entry->hash_next;
+	}
+
+	dentry_lru_unlink(entry);
+	if (entry->node && entry->disk->filesystem && entry->disk->filesystem->release_node)
+	{
+		entry->disk->filesystem->release_node(entry->node);
+	}
+
+	memset(entry, 0, sizeof(struct dentry));
+	entry->lru_next = dentry_cache.free;
+	dentry_cache.free = entry;
+}
+
+static struct dentry *dentry_find(struct disk *disk, uint32_t parent_id, const char *name, int len)
+{
+	uint32_t hash = dentry_hash(disk, parent_id, name, len);
+	for (struct dentry *entry = dentry_cache.buckets[hash % MYOS_DENTRY_CACHE_BUCKETS]; entry; entry = entry->hash_next)
+	{
+		if (entry->hash == hash && entry->disk == disk && entry->parent_id == parent_id && strncmp(entry->name, name, len) == 0 && entry->name[len] == 0)
+		{
+			// move to the front so the walk keeps the parents it is standing on
+			dentry_lru_unlink(entry);
+			dentry_lru_push(entry);
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+// the name is interned here, the view it came from only lives as long as the open
+static struct dentry *dentry_insert(struct disk *disk, uint32_t parent_id, const char *name, int len, void *node)
+{
+	if (!dentry_cache.free)
+	{
+		dentry_release(dentry_cache.lru_tail);
+	}
+
+	struct dentry *entry = dentry_cache.free;
+	dentry_cache.free = entry->lru_next;
+
+	entry->disk = disk;
+	entry->id = dentry_cache.next_id++;
+	if (dentry_cache.next_id == 0)
+	{
+		dentry_cache.next_id = 1;
+	}
+
+	entry->parent_id = parent_id;
+	memcpy(entry->name, (void *)name, len);
+	entry->name[len] = 0;
+	entry->hash = dentry_hash(disk, parent_id, name, len);
+	entry->node = node;
+	entry->used = true;
+
+	struct dentry **bucket = &dentry_cache.buckets[entry->hash % MYOS_DENTRY_CACHE_BUCKETS];
+	entry->hash_next = *bucket;
+	*bucket = entry;
+	dentry_lru_push(entry);
+	return entry;
+}
+
+// resolves path to a filesystem node, only components missing from the cache reach the lookup hook
+// returns -EUNIMP when the path cannot be cached and the filesystem open hook should walk it instead
+int dentry_resolve(struct disk *disk, struct path_part *path, void **node_out)
+{
+	int res = 0;
+	struct filesystem *fs = disk->filesystem;
+	if (!fs || !fs->lookup || !fs->open_node || !fs->release_node || !path)
+	{
+		return -EUNIMP;
+	}
+
+	for (struct path_part *part = path; part; part = part->next)
+	{
+		if (part->len >= MYOS_MAX_PATH)
+		{
+			return -EUNIMP;
+		}
+	}
+
+	uint32_t parent_id = 0;
+	void *parent_node = NULL;
+	for (struct path_part *part = path; part; part = part->next)
+	{
+		struct dentry *entry = dentry_find(disk, parent_id, part->part, part->len);
+		if (!entry)
+		{
+			void *node = NULL;
+			res = fs->lookup(disk, parent_node, part->part, part->len, &node);
+			if (res == -ENOENT)
+			{
+				// remember the miss so the next open of the same path is rejected without a directory read
+				dentry_insert(disk, parent_id, part->part, part->len, NULL);
+				goto out;
+			}
+
+			if (res < 0)
+			{
+				goto out;
+			}
+
+			entry = dentry_insert(disk, parent_id, part->part, part->len, node);
+		}
+
+		if (!entry->node)
+		{
+			res = -ENOENT;
+			goto out;
+		}
+
+		parent_id = entry->id;
+		parent_node = entry->node;
+	}
+
+	*node_out = parent_node;
+out:
+	return res;
+}
+
+// drops every entry of a disk, filesystems call this when they change a directory
+void dentry_invalidate_disk(struct disk *disk)
+{
+	for (int i = 0; i < MYOS_DENTRY_CACHE_ENTRIES; i++)
+	{
+		struct dentry *entry = &dentry_cache.entries[i];
+		if (entry->used && entry->disk == disk)
+		{
+			dentry_release(entry);
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "pparser.h"
+#include "config.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+struct disk;
+
+struct dentry
+{
+	struct disk *disk;
+
+	// children refer to their parent by id, so evicting a parent never leaves them dangling
+	uint32_t id;
+	uint32_t parent_id; // zero for items in the root directory
+	char name[MYOS_MAX_PATH];
+	uint32_t hash;
+
+	// filesystem node returned by the lookup hook, NULL for a negative entry
+	void *node;
+
+	struct dentry *hash_next;
+	struct dentry *lru_prev;
+	struct dentry *lru_next; // links the free list for unused entries
+	bool used;
+};
+
+struct dentry_cache
+{
+	struct dentry entries[MYOS_DENTRY_CACHE_ENTRIES];
+	struct dentry *buckets[MYOS_DENTRY_CACHE_BUCKETS];
+
+	// most recently used first
+	struct dentry *lru_head;
+	struct dentry *lru_tail;
+	struct dentry *free;
+
+	uint32_t next_id;
+};
+
+void dentry_cache_init();
+int dentry_resolve(struct disk *disk, struct path_part *path, void **node_out);
+void dentry_invalidate_disk(struct disk *disk);
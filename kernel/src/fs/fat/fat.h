@@ -0,0 +1,243 @@
+#pragma once
+
+// definitions shared by the FAT16 and FAT32 drivers, directory, path and chain handling lives in fat16.c
+
+#include "file.h"
+#include "disk/streamer.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+struct disk;
+
+#define MYOS_FAT16_SIGNATURE 0x29
+#define MYOS_FAT16_FAT_ENTRY_SIZE 0x02
+#define MYOS_FAT32_FAT_ENTRY_SIZE 0x04
+#define MYOS_FAT_DELETED_ENTRY 0xe5
+
+// FAT entries are handled as 28 bit FAT32 values, FAT16 reserved values are widened when read
+#define MYOS_FAT_ENTRY_FREE 0x00000000
+#define MYOS_FAT_ENTRY_RESERVED 0x0ffffff0
+#define MYOS_FAT_ENTRY_BAD 0x0ffffff7
+#define MYOS_FAT_ENTRY_END_OF_CHAIN_MIN 0x0ffffff8
+#define MYOS_FAT_ENTRY_END_OF_CHAIN 0x0fffffff
+#define MYOS_FAT32_ENTRY_MASK 0x0fffffff
+
+// clusters reserved past the write cursor so a file written in pieces still ends up contiguous
+#define MYOS_FAT_RESERVE_CLUSTERS 16
+
+// files with more fragments than this fall back to the chain cursor alone
+#define MYOS_FAT_MAX_EXTENTS 256
+
+typedef unsigned int FAT_ITEM_TYPE;
+#define FAT_ITEM_TYPE_DIRECTORY 0
+#define FAT_ITEM_TYPE_FILE 1
+
+// fat directory entry attributes bitmask
+#define FAT_FILE_READ_ONLY 0x01
+#define FAT_FILE_HIDDEN 0x02
+#define FAT_FILE_SYSTEM 0x04
+#define FAT_FILE_VOLUME_LABEL 0x08
+#define FAT_FILE_SUBDIRECTORY 0x10
+#define FAT_FILE_ARCHIVED 0x20
+#define FAT_FILE_DEVICE 0x40
+#define FAT_FILE_RESERVED 0x80
+
+struct fat_header_extended
+{
+	uint8_t drive_number;
+	uint8_t win_nt_bit;
+	uint8_t signature;
+	uint32_t volume_id;
+	uint8_t volume_id_string[11];
+	uint8_t system_id_string[8];
+} __attribute__((packed));
+
+// FAT32 moves the extended header back to make room for these
+struct fat32_header_extended
+{
+	uint32_t sectors_per_fat;
+	uint16_t flags; // bit 7 set when only the FAT in bits 0-3 is active
+	uint16_t version;
+	uint32_t root_cluster;
+	uint16_t fsinfo_sector;
+	uint16_t backup_boot_sector;
+	uint8_t reserved[12];
+	struct fat_header_extended extended_header;
+} __attribute__((packed));
+
+struct fat_header
+{
+	uint8_t short_jump_ins[3];
+	uint8_t oem_identifier[8];
+	uint16_t bytes_per_sector;
+	uint8_t sectors_per_cluster;
+	uint16_t reserved_sectors;
+	uint8_t fat_copies;
+	uint16_t root_dir_entries;
+	uint16_t number_of_sectors;
+	uint8_t media_type;
+	uint16_t sectors_per_fat;
+	uint16_t sectors_per_track;
+	uint16_t number_of_heads;
+	uint32_t hidden_sectors;
+	uint32_t sectors_big;
+} __attribute__((packed));
+
+struct fat_h
+{
+	struct fat_header primary_header;
+	union fat_h_e
+	{
+		struct fat_header_extended extended_header;
+		struct fat32_header_extended fat32;
+	} shared;
+};
+
+struct fat_directory_item
+{
+	uint8_t filename[8];
+	uint8_t ext[3];
+	uint8_t attribute;
+	uint8_t reserved;
+	uint8_t creation_time_tenths_of_a_sec;
+	uint16_t creation_time;
+	uint16_t creation_date;
+	uint16_t last_access;
+	uint16_t high_16_bits_first_cluster;
+	uint16_t last_mod_time;
+	uint16_t last_mod_date;
+	uint16_t low_16_bits_first_cluster;
+	uint32_t filesize;
+} __attribute__((packed));
+
+struct fat_directory
+{
+	struct fat_directory_item *item;
+	int total; // slots up to the end marker, deleted entries included
+	int sector_pos;
+	int ending_sector_pos;
+	uint32_t first_cluster; // zero for the FAT16 root directory
+};
+
+struct fat_item
+{
+	union
+	{
+		struct fat_directory_item *item;
+		struct fat_directory *directory;
+	};
+
+	FAT_ITEM_TYPE type;
+
+	// where the directory entry lives, so writes can update it
+	uint32_t dir_cluster; // zero for the FAT16 root directory
+	uint32_t dir_index;
+};
+
+// position in a cluster chain, sequential lookups continue from here instead of the first cluster
+struct fat_chain_cursor
+{
+	uint32_t first_cluster;
+	uint32_t index; // position of cluster in the chain
+	uint32_t cluster;
+};
+
+// run of physically contiguous clusters in a chain
+struct fat_extent
+{
+	uint32_t index; // position of the first cluster of the run in the chain
+	uint32_t cluster;
+	uint32_t total;
+};
+
+struct fat_extent_map
+{
+	struct fat_extent *extents; // NULL when the chain is too fragmented to map
+	int total;
+};
+
+struct fat_file_descriptor
+{
+	struct disk *disk;
+	struct fat_item *item;
+	uint32_t pos;
+	FILE_MODE mode;
+
+	// private to this descriptor, concurrent readers never move each other's position or read-ahead
+	struct disk_stream stream;
+	struct fat_chain_cursor cursor;
+	struct fat_extent_map extent_map; // built on open
+
+	// end of the chain, where writes extend the file
+	uint32_t total_clusters;
+	uint32_t last_cluster;
+
+	// run taken out of the free bitmap ahead of the write cursor but not linked into the FAT yet
+	uint32_t reserve_cluster;
+	uint32_t reserve_total;
+
+	// the directory entry changed, written back on close
+	bool dirty;
+
+	// next open file of the volume
+	struct fat_file_descriptor *open_next;
+};
+
+struct fat_private
+{
+	struct fat_h header;
+	struct fat_directory root_directory;
+
+	// layout of the volume, filled in by the resolver
+	bool fat32;
+	uint32_t sectors_per_fat;
+	uint32_t data_start_sector; // sector of cluster two
+	uint32_t active_fat;		// FAT the mirror is loaded from
+	bool mirror_fats;			// updates go to every copy of the FAT
+
+	// in memory copy of the active FAT, loaded at resolve and written through on every update
+	// NULL when a FAT32 table is too large to keep, the volume is then read only
+	void *fat;
+	uint32_t total_fat_entries;
+
+	// one bit per cluster, set when the cluster is free
+	uint32_t *free_bitmap;
+	uint32_t total_free_clusters;
+
+	// FAT sectors changed since the last flush, end is zero when clean
+	uint32_t fat_dirty_start;
+	uint32_t fat_dirty_end;
+
+	// where allocation starts looking for free clusters, kept in the FSInfo sector on FAT32
+	uint32_t next_free;
+	uint32_t fsinfo_sector; // zero when the volume has none
+
+	// descriptors open on files, an open file cannot be unlinked
+	struct fat_file_descriptor *open_files;
+
+	// name of the volume
+	char name[11];
+};
+
+int fat16_mount_private(struct disk *disk, struct fat_private *private);
+void fat16_free_private(struct fat_private *private);
+int fat16_metadata_read(struct disk *disk, long pos, void *out, int total);
+int fat16_metadata_write(struct disk *disk, long pos, const void *in, int total);
+int fat32_fsinfo_flush(struct disk *disk, struct fat_private *private);
+
+void *fat16_open(struct disk *disk, struct path_part *path, FILE_MODE mode);
+int fat16_read(struct disk *disk, void *descriptor, uint32_t size, uint32_t nmemb, char *out_ptr);
+int fat16_seek(void *private, uint32_t offset, FILE_SEEK_MODE seek_mode);
+int fat16_stat(struct disk *disk, void *private, struct file_stat *stat);
+int fat16_close(void *private);
+int fat16_volume_name(void *private, char *out_name, size_t max);
+int fat16_lookup(struct disk *disk, void *parent, const char *name, int len, void **node_out);
+void *fat16_open_node(struct disk *disk, void *node, FILE_MODE mode);
+void fat16_release_node(void *node);
+int fat16_write(struct disk *disk, void *descriptor, uint32_t size, uint32_t nmemb, const char *in);
+int fat16_truncate(struct disk *disk, void *descriptor, uint32_t size);
+int fat16_unlink(struct disk *disk, struct path_part *path);
+int fat16_readdir(struct disk *disk, void *node, uint32_t *cursor, struct file_dirent *out, int max);
+int fat16_file_id(void *private, uint32_t *id_out);
+int fat16_read_at(struct disk *disk, void *private, uint32_t offset, uint32_t size, char *out);
+int fat16_tell(void *private, uint32_t *pos_out);
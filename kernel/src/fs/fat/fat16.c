@@ -1,4 +1,6 @@
 #include "fat16.h"
+#include "fat.h"
+#include "config.h"
 #include "status.h"
 #include "string/string.h"
 #include "disk/disk.h"
@@ -6,131 +8,12 @@
 #include "memory/heap/kheap.h"
 #include "memory/memory.h"
 #include "kernel.h"
+#include "fs/dentry.h"
 #include <stdint.h>
-
-#define MYOS_FAT16_SIGNATURE 0x29
-#define MYOS_FAT16_FAT_ENTRY_SIZE 0x02
-#define MYOS_FAT16_BAD_SECTOR 0xff7
-#define MYOS_FAT16_UNUSED 0x00
-
-typedef unsigned int FAT_ITEM_TYPE;
-#define FAT_ITEM_TYPE_DIRECTORY 0
-#define FAT_ITEM_TYPE_FILE 1
-
-// fat directory entry attributes bitmask
-#define FAT_FILE_READ_ONLY 0x01
-#define FAT_FILE_HIDDEN 0x02
-#define FAT_FILE_SYSTEM 0x04
-#define FAT_FILE_VOLUME_LABEL 0x08
-#define FAT_FILE_SUBDIRECTORY 0x10
-#define FAT_FILE_ARCHIVED 0x20
-#define FAT_FILE_DEVICE 0x40
-#define FAT_FILE_RESERVED 0x80
-
-struct fat_header_extended
-{
-	uint8_t drive_number;
-	uint8_t win_nt_bit;
-	uint8_t signature;
-	uint32_t volume_id;
-	uint8_t volume_id_string[11];
-	uint8_t system_id_string[8];
-} __attribute__((packed));
-
-struct fat_header
-{
-	uint8_t short_jump_ins[3];
-	uint8_t oem_identifier[8];
-	uint16_t bytes_per_sector;
-	uint8_t sectors_per_cluster;
-	uint16_t reserved_sectors;
-	uint8_t fat_copies;
-	uint16_t root_dir_entries;
-	uint16_t number_of_sectors;
-	uint8_t media_type;
-	uint16_t sectors_per_fat;
-	uint16_t sectors_per_track;
-	uint16_t number_of_heads;
-	uint32_t hidden_sectors;
-	uint32_t sectors_big;
-} __attribute__((packed));
-
-struct fat_h
-{
-	struct fat_header primary_header;
-	union fat_h_e
-	{
-		struct fat_header_extended extended_header;
-	} shared;
-};
-
-struct fat_directory_item
-{
-	uint8_t filename[8];
-	uint8_t ext[3];
-	uint8_t attribute;
-	uint8_t reserved;
-	uint8_t creation_time_tenths_of_a_sec;
-	uint16_t creation_time;
-	uint16_t creation_date;
-	uint16_t last_access;
-	uint16_t high_16_bits_first_cluster;
-	uint16_t last_mod_time;
-	uint16_t last_mod_date;
-	uint16_t low_16_bits_first_cluster;
-	uint32_t filesize;
-} __attribute__((packed));
-
-struct fat_directory
-{
-	struct fat_directory_item *item;
-	int total;
-	int sector_pos;
-	int ending_sector_pos;
-};
-
-struct fat_item
-{
-	union
-	{
-		struct fat_directory_item *item;
-		struct fat_directory *directory;
-	};
-
-	FAT_ITEM_TYPE type;
-};
-
-struct fat_file_descriptor
-{
-	struct fat_item *item;
-	uint32_t pos;
-};
-
-struct fat_private
-{
-	struct fat_h header;
-	struct fat_directory root_directory;
-
-	// used to stream data clusters
-	struct disk_stream *cluster_read_stream;
-
-	// used to stream file allocation table
-	struct disk_stream *fat_read_stream;
-
-	// used in situations where we stream directory
-	struct disk_stream *directory_stream;
-
-	// name of the volume
-	char name[11];
-};
+#include <stdbool.h>
 
 int fat16_resolve(struct disk *disk);
-void *fat16_open(struct disk *disk, struct path_part *path, FILE_MODE mode);
-int fat16_read(struct disk *disk, void *descriptor, uint32_t size, uint32_t nmemb, char *out_ptr);
-int fat16_seek(void *private, uint32_t offset, FILE_SEEK_MODE seek_mode);
-int fat16_stat(struct disk *disk, void *private, struct file_stat *stat);
-int fat16_close(void *private);
-int fat16_volume_name(void *private, char *out_name, size_t max);
+struct fat_directory *fat16_load_directory_cluster(struct disk *disk, uint32_t cluster);
 
 struct filesystem fat16_fs = {
 	.resolve = fat16_resolve,
@@ -140,6 +23,16 @@ struct filesystem fat16_fs = {
 	.stat = fat16_stat,
 	.close = fat16_close,
 	.volume_name = fat16_volume_name,
+	.lookup = fat16_lookup,
+	.open_node = fat16_open_node,
+	.release_node = fat16_release_node,
+	.write = fat16_write,
+	.truncate = fat16_truncate,
+	.unlink = fat16_unlink,
+	.readdir = fat16_readdir,
+	.file_id = fat16_file_id,
+	.read_at = fat16_read_at,
+	.tell = fat16_tell,
 };
 
 struct filesystem *fat16_init()
@@ -148,17 +41,42 @@ struct filesystem *fat16_init()
 	return &fat16_fs;
 }
 
-static void fat16_init_private(struct disk *disk, struct fat_private *private)
+void fat16_free_private(struct fat_private *private)
+{
+	kfree(private->root_directory.item);
+	kfree(private->free_bitmap);
+	kfree(private->fat);
+	kfree(private);
+}
+
+long fat16_sector_to_absolute(struct disk *disk, uint32_t sector)
+{
+	return (long)sector * disk->sector_size;
+}
+
+// every metadata access gets a stream of its own, nothing shares a position across a sleep in the disk layer
+static int fat16_metadata_transfer(struct disk *disk, long pos, void *buf, int total, bool write)
+{
+	struct disk_stream stream;
+	diskstreamer_init(&stream, disk);
+	int res = diskstreamer_seek(&stream, pos);
+	if (res == MYOS_ALL_OK)
+	{
+		res = write ? diskstreamer_write(&stream, buf, total) : diskstreamer_read(&stream, buf, total);
+	}
+
+	diskstreamer_release(&stream);
+	return res;
+}
+
+int fat16_metadata_read(struct disk *disk, long pos, void *out, int total)
 {
-	memset(private, 0, sizeof(struct fat_private));
-	private->cluster_read_stream = diskstreamer_new_from_disk(disk);
-	private->fat_read_stream = diskstreamer_new_from_disk(disk);
-	private->directory_stream = diskstreamer_new_from_disk(disk);
+	return fat16_metadata_transfer(disk, pos, out, total, false);
 }
 
-int fat16_sector_to_absolute(struct disk *disk, int sector)
+int fat16_metadata_write(struct disk *disk, long pos, const void *in, int total)
 {
-	return sector * disk->sector_size;
+	return fat16_metadata_transfer(disk, pos, (void *)in, total, true);
 }
 
 int fat16_get_total_items_for_directory(struct disk *disk, uint32_t directory_start_sector)
@@ -167,21 +85,12 @@ int fat16_get_total_items_for_directory(struct disk *disk, uint32_t directory_st
 	struct fat_directory_item empty_item;
 	memset(&empty_item, 0, sizeof(empty_item));
 
-	struct fat_private *fat_private = disk->fs_private;
-
 	int res = 0;
 	int i = 0;
-	int directory_start_pos = directory_start_sector * disk->sector_size;
-	struct disk_stream *stream = fat_private->directory_stream;
-	if (diskstreamer_seek(stream, directory_start_pos) != MYOS_ALL_OK)
-	{
-		res = -EIO;
-		goto out;
-	}
-
+	long directory_start_pos = fat16_sector_to_absolute(disk, directory_start_sector);
 	while (42)
 	{
-		if (diskstreamer_read(stream, &item, sizeof(item)) != MYOS_ALL_OK)
+		if (fat16_metadata_read(disk, directory_start_pos + i * sizeof(item), &item, sizeof(item)) != MYOS_ALL_OK)
 		{
 			res = -EIO;
 			goto out;
@@ -193,12 +102,7 @@ int fat16_get_total_items_for_directory(struct disk *disk, uint32_t directory_st
 			break;
 		}
 
-		// item unused
-		if (item.filename[0] == 0xe5)
-		{
-			continue;
-		}
-
+		// deleted items still take a slot, lookups skip them
 		i++;
 	}
 
@@ -208,6 +112,7 @@ out:
 	return res;
 }
 
+// the FAT16 root directory sits in a fixed area between the FATs and the data region
 int fat16_get_root_directory(struct disk *disk, struct fat_private *fat_private, struct fat_directory *directory)
 {
 	int res = 0;
@@ -231,14 +136,7 @@ int fat16_get_root_directory(struct disk *disk, struct fat_private *fat_private,
 		goto err_out;
 	}
 
-	struct disk_stream *stream = fat_private->directory_stream;
-	if (diskstreamer_seek(stream, fat16_sector_to_absolute(disk, root_dir_sector_pos)) != MYOS_ALL_OK)
-	{
-		res = -EIO;
-		goto err_out;
-	}
-
-	if (diskstreamer_read(stream, dir, root_dir_size) != MYOS_ALL_OK)
+	if (fat16_metadata_read(disk, fat16_sector_to_absolute(disk, root_dir_sector_pos), dir, root_dir_size) != MYOS_ALL_OK)
 	{
 		res = -EIO;
 		goto err_out;
@@ -261,51 +159,224 @@ err_out:
 	return res;
 }
 
-int fat16_resolve(struct disk *disk)
+static uint32_t fat16_get_first_fat_sector(struct fat_private *private)
+{
+	return private->header.primary_header.reserved_sectors + private->active_fat * private->sectors_per_fat;
+}
+
+static uint32_t fat16_fat_entry_size(struct fat_private *private)
+{
+	return private->fat32 ? MYOS_FAT32_FAT_ENTRY_SIZE : MYOS_FAT16_FAT_ENTRY_SIZE;
+}
+
+// raw table value to the 28 bit form used everywhere else
+static uint32_t fat16_fat_entry_widen(struct fat_private *private, uint32_t entry)
+{
+	if (private->fat32)
+	{
+		return entry & MYOS_FAT32_ENTRY_MASK;
+	}
+
+	entry &= 0xffff;
+	return entry >= 0xfff0 ? entry | 0x0fff0000 : entry;
+}
+
+static uint32_t fat16_mirror_get(struct fat_private *private, uint32_t cluster)
+{
+	if (private->fat32)
+	{
+		return fat16_fat_entry_widen(private, ((uint32_t *)private->fat)[cluster]);
+	}
+
+	return fat16_fat_entry_widen(private, ((uint16_t *)private->fat)[cluster]);
+}
+
+static void fat16_mirror_set(struct fat_private *private, uint32_t cluster, uint32_t value)
+{
+	if (private->fat32)
+	{
+		// the top four bits are reserved and must be preserved
+		uint32_t *fat = private->fat;
+		fat[cluster] = (fat[cluster] & ~MYOS_FAT32_ENTRY_MASK) | (value & MYOS_FAT32_ENTRY_MASK);
+		return;
+	}
+
+	((uint16_t *)private->fat)[cluster] = value & 0xffff;
+}
+
+static void fat16_free_bitmap_set(struct fat_private *private, uint32_t cluster, bool free)
+{
+	uint32_t mask = 1u << (cluster % 32);
+	bool was_free = private->free_bitmap[cluster / 32] & mask;
+	if (free == was_free)
+	{
+		return;
+	}
+
+	if (free)
+	{
+		private->free_bitmap[cluster / 32] |= mask;
+		private->total_free_clusters++;
+	}
+	else
+	{
+		private->free_bitmap[cluster / 32] &= ~mask;
+		private->total_free_clusters--;
+	}
+}
+
+// counts clusters that actually exist in the data region, the FAT itself is usually padded past them
+static uint32_t fat16_get_total_clusters(struct fat_private *private)
+{
+	struct fat_header *header = &private->header.primary_header;
+	uint32_t total_sectors = header->number_of_sectors ? header->number_of_sectors : header->sectors_big;
+	if (total_sectors <= private->data_start_sector || header->sectors_per_cluster == 0)
+	{
+		return 0;
+	}
+
+	return (total_sectors - private->data_start_sector) / header->sectors_per_cluster;
+}
+
+// reads the active FAT, at most 128KB on FAT16, and derives the free cluster bitmap from it
+static int fat16_load_fat(struct disk *disk, struct fat_private *private)
 {
 	int res = 0;
-	struct fat_private *fat_private = kzalloc(sizeof(struct fat_private));
-	fat16_init_private(disk, fat_private);
+	uint32_t entry_size = fat16_fat_entry_size(private);
+	uint32_t total_entries = private->sectors_per_fat * (disk->sector_size / entry_size);
+	uint32_t total_clusters = fat16_get_total_clusters(private) + 2;
+	if (total_entries > total_clusters)
+	{
+		total_entries = total_clusters;
+	}
 
-	disk->fs_private = fat_private;
-	disk->filesystem = &fat16_fs;
+	if (total_entries <= 2)
+	{
+		return -EINFORMAT;
+	}
 
-	struct disk_stream *stream = diskstreamer_new_from_disk(disk);
-	if (!stream)
+	// whole sectors, the flush writes the mirror back a sector at a time
+	uint32_t fat_size = (total_entries * entry_size + disk->sector_size - 1) / disk->sector_size * disk->sector_size;
+	if (fat_size > MYOS_FAT_MIRROR_MAX_BYTES)
+	{
+		return -ENOMEM;
+	}
+
+	private->fat = kzalloc(fat_size);
+	private->free_bitmap = kzalloc((total_entries + 31) / 32 * sizeof(uint32_t));
+	if (!private->fat || !private->free_bitmap)
 	{
 		res = -ENOMEM;
 		goto out;
 	}
 
-	if (diskstreamer_read(stream, &fat_private->header, sizeof(fat_private->header)) != MYOS_ALL_OK)
+	res = fat16_metadata_read(disk, fat16_sector_to_absolute(disk, fat16_get_first_fat_sector(private)), private->fat, fat_size);
+	if (res < 0)
 	{
-		res = -EIO;
 		goto out;
 	}
 
-	if (fat_private->header.shared.extended_header.signature != 0x29)
+	private->total_fat_entries = total_entries;
+	private->total_free_clusters = 0;
+	// clusters zero and one are reserved
+	for (uint32_t cluster = 2; cluster < total_entries; cluster++)
+	{
+		if (fat16_mirror_get(private, cluster) == MYOS_FAT_ENTRY_FREE)
+		{
+			fat16_free_bitmap_set(private, cluster, true);
+		}
+	}
+
+out:
+	if (res < 0)
+	{
+		kfree(private->free_bitmap);
+		kfree(private->fat);
+		private->free_bitmap = NULL;
+		private->fat = NULL;
+	}
+
+	return res;
+}
+
+// loads the root directory and the FAT once the resolver has filled in the layout
+int fat16_mount_private(struct disk *disk, struct fat_private *private)
+{
+	int res = fat16_load_fat(disk, private);
+	if (res == -ENOMEM && private->fat32)
+	{
+		// chains are then followed through the streamer, allocation needs the mirror
+		private->total_fat_entries = fat16_get_total_clusters(private) + 2;
+		res = 0;
+	}
+
+	if (res < 0)
 	{
-		res = -EFSNOTUS;
 		goto out;
 	}
 
-	if (fat16_get_root_directory(disk, fat_private, &fat_private->root_directory) != MYOS_ALL_OK)
+	if (!private->fat32)
 	{
-		res = -EIO;
+		res = fat16_get_root_directory(disk, private, &private->root_directory) == MYOS_ALL_OK ? 0 : -EIO;
 		goto out;
 	}
 
-	strncpy(fat_private->name, (const char *)fat_private->header.shared.extended_header.volume_id_string, sizeof(fat_private->name));
+	struct fat_directory *root = fat16_load_directory_cluster(disk, private->header.shared.fat32.root_cluster);
+	if (!root)
+	{
+		res = -EIO;
+		goto out;
+	}
 
+	private->root_directory = *root;
+	kfree(root);
 out:
-	if (stream)
+	return res;
+}
+
+int fat16_resolve(struct disk *disk)
+{
+	int res = 0;
+	struct fat_private *fat_private = kzalloc(sizeof(struct fat_private));
+	if (!fat_private)
+	{
+		return -ENOMEM;
+	}
+
+	disk->fs_private = fat_private;
+	disk->filesystem = &fat16_fs;
+
+	if (fat16_metadata_read(disk, 0, &fat_private->header, sizeof(fat_private->header)) != MYOS_ALL_OK)
+	{
+		res = -EIO;
+		goto out;
+	}
+
+	// FAT32 volumes have no fixed root directory and keep the FAT size elsewhere
+	struct fat_header *header = &fat_private->header.primary_header;
+	if (fat_private->header.shared.extended_header.signature != MYOS_FAT16_SIGNATURE || header->sectors_per_fat == 0 || header->root_dir_entries == 0)
+	{
+		res = -EFSNOTUS;
+		goto out;
+	}
+
+	uint32_t root_dir_sectors = (header->root_dir_entries * sizeof(struct fat_directory_item) + disk->sector_size - 1) / disk->sector_size;
+	fat_private->sectors_per_fat = header->sectors_per_fat;
+	fat_private->data_start_sector = header->reserved_sectors + header->fat_copies * header->sectors_per_fat + root_dir_sectors;
+	fat_private->mirror_fats = true;
+	fat_private->next_free = 2;
+	res = fat16_mount_private(disk, fat_private);
+	if (res < 0)
 	{
-		diskstreamer_close(stream);
+		goto out;
 	}
 
+	strncpy(fat_private->name, (const char *)fat_private->header.shared.extended_header.volume_id_string, sizeof(fat_private->name));
+
+out:
 	if (res < 0)
 	{
-		kfree(fat_private);
+		fat16_free_private(fat_private);
 		disk->fs_private = 0;
 	}
 	return res;
@@ -366,153 +437,359 @@ static uint32_t fat16_get_first_cluster(struct fat_directory_item *item)
 	return (item->high_16_bits_first_cluster << 16) | item->low_16_bits_first_cluster;
 }
 
-static int fat16_cluster_to_sector(struct fat_private *private, int cluster)
-{
-	return private->root_directory.ending_sector_pos + ((cluster - 2) * private->header.primary_header.sectors_per_cluster);
-}
-
-static uint32_t fat16_get_first_fat_sector(struct fat_private *private)
+static uint32_t fat16_cluster_to_sector(struct fat_private *private, uint32_t cluster)
 {
-	return private->header.primary_header.reserved_sectors;
+	return private->data_start_sector + ((cluster - 2) * private->header.primary_header.sectors_per_cluster);
 }
 
-static int fat16_get_fat_entry(struct disk *disk, int cluster)
+// the entry goes through entry_out so read errors can never be mistaken for a FAT value
+static int fat16_get_fat_entry(struct disk *disk, uint32_t cluster, uint32_t *entry_out)
 {
-	int res = -1;
+	int res = 0;
 	struct fat_private *private = disk->fs_private;
-	struct disk_stream *stream = private->fat_read_stream;
-	if (!stream)
+	// clusters past the end of the data region are never part of a valid chain
+	if (cluster >= private->total_fat_entries)
 	{
-		goto out;
+		*entry_out = MYOS_FAT_ENTRY_BAD;
+		return 0;
 	}
 
-	uint32_t fat_table_position = fat16_get_first_fat_sector(private) * disk->sector_size;
-	res = diskstreamer_seek(stream, fat_table_position + (cluster * MYOS_FAT16_FAT_ENTRY_SIZE));
-	if (res < 0)
+	if (private->fat)
 	{
-		goto out;
+		*entry_out = fat16_mirror_get(private, cluster);
+		return 0;
 	}
 
-	uint16_t result = 0;
-	res = diskstreamer_read(stream, &result, sizeof(result));
+	long fat_table_position = fat16_sector_to_absolute(disk, fat16_get_first_fat_sector(private));
+	uint32_t result = 0;
+	res = fat16_metadata_read(disk, fat_table_position + (long)cluster * fat16_fat_entry_size(private), &result, fat16_fat_entry_size(private));
 	if (res < 0)
 	{
 		goto out;
 	}
 
-	res = result;
+	*entry_out = fat16_fat_entry_widen(private, result);
 out:
 	return res;
 }
 
-// gets correct cluster to use based on starting cluster and offset
-int fat16_get_cluster_for_offset(struct disk *disk, uint16_t starting_cluster, int offset)
+// validates the FAT entry that follows a cluster in a chain
+static int fat16_fat_entry_check(uint32_t entry)
 {
-	int res = 0;
-	struct fat_private *private = disk->fs_private;
-	int size_of_cluster_bytes = private->header.primary_header.sectors_per_cluster * disk->sector_size;
-	uint16_t cluster_to_use = starting_cluster;
-	int clusters_ahead = offset / size_of_cluster_bytes;
-	for (int i = 0; i < clusters_ahead; i++)
+	if (entry >= MYOS_FAT_ENTRY_END_OF_CHAIN_MIN)
+	{
+		return -EOUTOFRANGE;
+	}
+
+	// bad clusters, reserved values and free clusters never continue a chain
+	if (entry >= MYOS_FAT_ENTRY_RESERVED || entry == MYOS_FAT_ENTRY_FREE)
+	{
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static struct fat_extent *fat16_extent_map_find(struct fat_extent_map *map, uint32_t index)
+{
+	int low = 0;
+	int high = map->total - 1;
+	while (low <= high)
 	{
-		uint16_t entry = fat16_get_fat_entry(disk, cluster_to_use);
-		if (entry >= 0xfff8)
+		int middle = (low + high) / 2;
+		struct fat_extent *extent = &map->extents[middle];
+		if (index < extent->index)
 		{
-			res = -EOUTOFRANGE;
-			goto out;
+			high = middle - 1;
 		}
-
-		if (entry == MYOS_FAT16_BAD_SECTOR || (entry >= 0xfff0 && entry <= 0xfff6) || entry == 0x0000)
+		else if (index >= extent->index + extent->total)
 		{
-			res = -EIO;
-			goto out;
+			low = middle + 1;
+		}
+		else
+		{
+			return extent;
 		}
+	}
+
+	return NULL;
+}
 
-		cluster_to_use = entry;
+static int fat16_extent_map_lookup(struct fat_extent_map *map, uint32_t index)
+{
+	struct fat_extent *extent = fat16_extent_map_find(map, index);
+	if (!extent)
+	{
+		return -EOUTOFRANGE;
 	}
 
-	res = cluster_to_use;
-out:
-	return res;
+	return extent->cluster + (index - extent->index);
 }
 
-static int fat16_read_internal_from_stream(struct disk *disk, struct disk_stream *stream, uint16_t cluster, int offset, int total, void *out)
+// finds the cluster at position index of the chain starting at first_cluster
+static int fat16_chain_lookup(struct disk *disk, struct fat_chain_cursor *cursor, struct fat_extent_map *map, uint32_t first_cluster, uint32_t index)
 {
-	int res = MYOS_ALL_OK;
-	struct fat_private *private = disk->fs_private;
-	int size_of_cluster_bytes = private->header.primary_header.sectors_per_cluster * disk->sector_size;
-	uint16_t cluster_to_use = cluster;
-	int bytes_read = 0;
-	int starting_offset = offset;
+	int res = 0;
+	if (map && map->extents)
+	{
+		return fat16_extent_map_lookup(map, index);
+	}
 
-	while (total > 0)
+	if (cursor->first_cluster != first_cluster || cursor->cluster == 0 || cursor->index > index)
 	{
-		res = fat16_get_cluster_for_offset(disk, cluster, starting_offset);
+		cursor->first_cluster = first_cluster;
+		cursor->index = 0;
+		cursor->cluster = first_cluster;
+	}
+
+	while (cursor->index < index)
+	{
+		uint32_t entry = 0;
+		res = fat16_get_fat_entry(disk, cursor->cluster, &entry);
 		if (res < 0)
 		{
-			break;
+			goto out;
 		}
 
-		cluster_to_use = (uint16_t)res;
-		int offset_from_cluster = starting_offset % size_of_cluster_bytes;
-		int starting_sector = fat16_cluster_to_sector(private, cluster_to_use);
-		int starting_pos = (starting_sector * disk->sector_size) + offset_from_cluster;
-		int total_to_read = size_of_cluster_bytes - offset_from_cluster;
-		if (total_to_read > total)
+		res = fat16_fat_entry_check(entry);
+		if (res < 0)
 		{
-			total_to_read = total;
+			goto out;
 		}
 
-		res = diskstreamer_seek(stream, starting_pos);
-		if (res != MYOS_ALL_OK)
-		{
-			break;
-		}
+		cursor->cluster = entry;
+		cursor->index++;
+	}
 
-		res = diskstreamer_read(stream, out, total_to_read);
-		if (res != MYOS_ALL_OK)
+	res = cursor->cluster;
+out:
+	return res;
+}
+
+// finds the cluster at position index and how many clusters from there on are physically contiguous, at most max_clusters
+// the cursor is left on the last cluster of the run
+static int fat16_chain_run(struct disk *disk, struct fat_chain_cursor *cursor, struct fat_extent_map *map, uint32_t first_cluster, uint32_t index, uint32_t max_clusters, uint32_t *cluster_out)
+{
+	int res = 0;
+	if (map && map->extents)
+	{
+		struct fat_extent *extent = fat16_extent_map_find(map, index);
+		if (!extent)
 		{
-			break;
+			return -EOUTOFRANGE;
 		}
 
-		out += total_to_read;
-		bytes_read += total_to_read;
-		starting_offset += total_to_read;
-		total -= total_to_read;
+		uint32_t remaining = extent->total - (index - extent->index);
+		*cluster_out = extent->cluster + (index - extent->index);
+		return remaining < max_clusters ? remaining : max_clusters;
 	}
 
+	res = fat16_chain_lookup(disk, cursor, map, first_cluster, index);
 	if (res < 0)
 	{
 		return res;
 	}
 
-	return bytes_read;
+	*cluster_out = res;
+	uint32_t total = 1;
+	while (total < max_clusters)
+	{
+		// a read error only ends the run, the next lookup reports it
+		uint32_t entry = 0;
+		if (fat16_get_fat_entry(disk, cursor->cluster, &entry) < 0 || entry != cursor->cluster + 1 || fat16_fat_entry_check(entry) < 0)
+		{
+			break;
+		}
+
+		cursor->cluster = entry;
+		cursor->index++;
+		total++;
+	}
+
+	return total;
 }
 
-static int fat16_read_internal(struct disk *disk, int starting_cluster, int offset, int total, void *out)
+// gets correct cluster to use based on starting cluster and offset
+int fat16_get_cluster_for_offset(struct disk *disk, uint32_t starting_cluster, int offset)
 {
-	struct fat_private *fs_private = disk->fs_private;
-	struct disk_stream *stream = fs_private->cluster_read_stream;
-	return fat16_read_internal_from_stream(disk, stream, starting_cluster, offset, total, out);
+	struct fat_private *private = disk->fs_private;
+	int size_of_cluster_bytes = private->header.primary_header.sectors_per_cluster * disk->sector_size;
+	struct fat_chain_cursor cursor = {0};
+	return fat16_chain_lookup(disk, &cursor, NULL, starting_cluster, offset / size_of_cluster_bytes);
 }
 
-void fat16_free_directory(struct fat_directory *directory)
+// collapses the chain into runs of contiguous clusters, gives up on heavily fragmented files
+static int fat16_extent_map_build(struct disk *disk, uint32_t first_cluster, struct fat_extent_map *map)
 {
-	if (!directory)
+	int res = 0;
+	map->total = 0;
+	map->extents = kzalloc(sizeof(struct fat_extent) * MYOS_FAT_MAX_EXTENTS);
+	if (!map->extents)
 	{
-		return;
+		return -ENOMEM;
 	}
 
-	if (directory->item)
+	// empty files start with an empty map that writes fill in
+	if (first_cluster < 2)
 	{
-		kfree(directory->item);
+		goto out;
 	}
 
-	kfree(directory);
-}
-
-void fat16_fat_item_free(struct fat_item *item)
-{
+	uint32_t cluster = first_cluster;
+	struct fat_private *private = disk->fs_private;
+	for (uint32_t index = 0; index < private->total_fat_entries; index++)
+	{
+		struct fat_extent *last = map->total ? &map->extents[map->total - 1] : NULL;
+		if (last && last->cluster + last->total == cluster)
+		{
+			last->total++;
+		}
+		else
+		{
+			if (map->total == MYOS_FAT_MAX_EXTENTS)
+			{
+				res = -ENOMEM;
+				goto out;
+			}
+
+			map->extents[map->total].index = index;
+			map->extents[map->total].cluster = cluster;
+			map->extents[map->total].total = 1;
+			map->total++;
+		}
+
+		uint32_t entry = 0;
+		res = fat16_get_fat_entry(disk, cluster, &entry);
+		if (res < 0)
+		{
+			goto out;
+		}
+
+		res = fat16_fat_entry_check(entry);
+		if (res == -EOUTOFRANGE)
+		{
+			res = 0; // end of chain
+			goto out;
+		}
+
+		if (res < 0)
+		{
+			goto out;
+		}
+
+		cluster = entry;
+	}
+
+	res = -EIO; // the chain loops
+out:
+	if (res < 0)
+	{
+		kfree(map->extents);
+		map->extents = NULL;
+		map->total = 0;
+	}
+
+	return res;
+}
+
+// cursor and map may be NULL, a cursor local to this call still keeps the walk linear
+// the chain must already cover offset + total when writing
+static int fat16_transfer_internal_from_stream(struct disk *disk, struct disk_stream *stream, struct fat_chain_cursor *cursor, struct fat_extent_map *map, uint32_t cluster, int offset, int total, void *out, bool write)
+{
+	int res = MYOS_ALL_OK;
+	struct fat_private *private = disk->fs_private;
+	int size_of_cluster_bytes = private->header.primary_header.sectors_per_cluster * disk->sector_size;
+	uint32_t cluster_to_use = cluster;
+	int bytes_read = 0;
+	int starting_offset = offset;
+	struct fat_chain_cursor local_cursor = {0};
+	if (!cursor)
+	{
+		cursor = &local_cursor;
+	}
+
+	// one streamer read per run of contiguous clusters rather than per cluster
+	while (total > 0)
+	{
+		int offset_from_cluster = starting_offset % size_of_cluster_bytes;
+		uint32_t clusters_needed = (offset_from_cluster + total + size_of_cluster_bytes - 1) / size_of_cluster_bytes;
+		res = fat16_chain_run(disk, cursor, map, cluster, starting_offset / size_of_cluster_bytes, clusters_needed, &cluster_to_use);
+		if (res < 0)
+		{
+			break;
+		}
+
+		uint32_t starting_sector = fat16_cluster_to_sector(private, cluster_to_use);
+		long starting_pos = fat16_sector_to_absolute(disk, starting_sector) + offset_from_cluster;
+		int total_to_read = res * size_of_cluster_bytes - offset_from_cluster;
+		if (total_to_read > total)
+		{
+			total_to_read = total;
+		}
+
+		res = diskstreamer_seek(stream, starting_pos);
+		if (res != MYOS_ALL_OK)
+		{
+			break;
+		}
+
+		res = write ? diskstreamer_write(stream, out, total_to_read) : diskstreamer_read(stream, out, total_to_read);
+		if (res != MYOS_ALL_OK)
+		{
+			break;
+		}
+
+		out += total_to_read;
+		bytes_read += total_to_read;
+		starting_offset += total_to_read;
+		total -= total_to_read;
+	}
+
+	if (res < 0)
+	{
+		return res;
+	}
+
+	return bytes_read;
+}
+
+// descriptors read through their own stream, so each reader keeps its position and read-ahead window
+static int fat16_read_internal(struct disk *disk, struct fat_file_descriptor *desc, uint32_t starting_cluster, int offset, int total, void *out)
+{
+	if (!desc)
+	{
+		struct disk_stream stream;
+		diskstreamer_init(&stream, disk);
+		int res = fat16_transfer_internal_from_stream(disk, &stream, NULL, NULL, starting_cluster, offset, total, out, false);
+		diskstreamer_release(&stream);
+		return res;
+	}
+
+	return fat16_transfer_internal_from_stream(disk, &desc->stream, &desc->cursor, &desc->extent_map, starting_cluster, offset, total, out, false);
+}
+
+static int fat16_write_internal(struct disk *disk, struct fat_file_descriptor *desc, uint32_t starting_cluster, int offset, int total, const void *in)
+{
+	return fat16_transfer_internal_from_stream(disk, &desc->stream, &desc->cursor, &desc->extent_map, starting_cluster, offset, total, (void *)in, true);
+}
+
+void fat16_free_directory(struct fat_directory *directory)
+{
+	if (!directory)
+	{
+		return;
+	}
+
+	if (directory->item)
+	{
+		kfree(directory->item);
+	}
+
+	kfree(directory);
+}
+
+void fat16_fat_item_free(struct fat_item *item)
+{
 	if (item->type == FAT_ITEM_TYPE_DIRECTORY)
 	{
 		fat16_free_directory(item->directory);
@@ -525,12 +802,48 @@ void fat16_fat_item_free(struct fat_item *item)
 	kfree(item);
 }
 
-struct fat_directory *fat16_load_directory(struct disk *disk, struct fat_directory_item *item)
+// counts the slots of a directory stored in a cluster chain, following the chain rather than the disk
+static int fat16_get_total_items_for_cluster_directory(struct disk *disk, uint32_t cluster)
 {
 	int res = 0;
-	struct fat_directory *directory = 0;
-	struct fat_private *fat_private = disk->fs_private;
-	if (!(item->attribute & FAT_FILE_SUBDIRECTORY))
+	struct disk_stream stream;
+	diskstreamer_init(&stream, disk);
+	struct fat_chain_cursor cursor = {0};
+	struct fat_directory_item item;
+	int i = 0;
+	while (42)
+	{
+		res = fat16_transfer_internal_from_stream(disk, &stream, &cursor, NULL, cluster, i * sizeof(item), sizeof(item), &item, false);
+		if (res == -EOUTOFRANGE)
+		{
+			// the chain is full, there is no end marker
+			break;
+		}
+
+		if (res < 0)
+		{
+			goto out;
+		}
+
+		if (item.filename[0] == 0x00)
+		{
+			break;
+		}
+
+		i++;
+	}
+
+	res = i;
+out:
+	diskstreamer_release(&stream);
+	return res;
+}
+
+struct fat_directory *fat16_load_directory_cluster(struct disk *disk, uint32_t cluster)
+{
+	int res = 0;
+	struct fat_directory *directory = NULL;
+	if (cluster < 2)
 	{
 		res = -EINVARG;
 		goto out;
@@ -543,132 +856,1072 @@ struct fat_directory *fat16_load_directory(struct disk *disk, struct fat_directo
 		goto out;
 	}
 
-	int cluster = fat16_get_first_cluster(item);
-	int cluster_sector = fat16_cluster_to_sector(fat_private, cluster);
-	int total_items = fat16_get_total_items_for_directory(disk, cluster_sector);
+	int total_items = fat16_get_total_items_for_cluster_directory(disk, cluster);
+	if (total_items < 0)
+	{
+		res = total_items;
+		goto out;
+	}
+
 	directory->total = total_items;
+	directory->first_cluster = cluster;
+	directory->sector_pos = fat16_cluster_to_sector(disk->fs_private, cluster);
 	int directory_size = directory->total * sizeof(struct fat_directory_item);
-	directory->item = kzalloc(directory_size);
+	// an empty directory still gets a slot so writes can add the first entry
+	directory->item = kzalloc(directory_size ? directory_size : sizeof(struct fat_directory_item));
 	if (!directory->item)
 	{
 		res = -ENOMEM;
 		goto out;
 	}
 
-	res = fat16_read_internal(disk, cluster, 0x00, directory_size, directory->item);
-	if (res != MYOS_ALL_OK)
+	res = fat16_read_internal(disk, NULL, cluster, 0x00, directory_size, directory->item);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = MYOS_ALL_OK;
+out:
+	if (res != MYOS_ALL_OK)
+	{
+		fat16_free_directory(directory);
+		directory = NULL;
+	}
+	return directory;
+}
+
+struct fat_directory *fat16_load_directory(struct disk *disk, struct fat_directory_item *item)
+{
+	if (!(item->attribute & FAT_FILE_SUBDIRECTORY))
+	{
+		return NULL;
+	}
+
+	return fat16_load_directory_cluster(disk, fat16_get_first_cluster(item));
+}
+
+struct fat_item *fat16_new_fat_item_for_directory_item(struct disk *disk, struct fat_directory_item *item)
+{
+	struct fat_item *f_item = kzalloc(sizeof(struct fat_item));
+	if (!f_item)
+	{
+		return 0;
+	}
+
+	if (item->attribute & FAT_FILE_SUBDIRECTORY)
+	{
+		f_item->directory = fat16_load_directory(disk, item);
+		f_item->type = FAT_ITEM_TYPE_DIRECTORY;
+		if (!f_item->directory)
+		{
+			kfree(f_item);
+			return 0;
+		}
+
+		return f_item;
+	}
+
+	f_item->type = FAT_ITEM_TYPE_FILE;
+	f_item->item = fat16_clone_directory_item(item, sizeof(struct fat_directory_item));
+	return f_item;
+}
+
+// name is a path view of len bytes, it does not have to be null terminated
+struct fat_item *fat16_find_item_in_directory(struct disk *disk, struct fat_directory *directory, const char *name, int len)
+{
+	struct fat_item *f_item = 0;
+	char tmp_filename[MYOS_MAX_PATH];
+	for (int i = 0; i < directory->total; i++)
+	{
+		if (directory->item[i].filename[0] == MYOS_FAT_DELETED_ENTRY)
+		{
+			continue;
+		}
+
+		fat16_get_full_relative_filename(&directory->item[i], tmp_filename, sizeof(tmp_filename));
+		if (len < sizeof(tmp_filename) && istrncmp(tmp_filename, name, len) == 0 && tmp_filename[len] == 0)
+		{
+			// found the file, creating a new fat_item
+			f_item = fat16_new_fat_item_for_directory_item(disk, &directory->item[i]);
+			if (f_item)
+			{
+				f_item->dir_cluster = directory->first_cluster;
+				f_item->dir_index = i;
+			}
+
+			break;
+		}
+	}
+
+	return f_item;
+}
+
+struct fat_item *fat16_get_directory_entry(struct disk *disk, struct path_part *path)
+{
+	struct fat_private *fat_private = disk->fs_private;
+	struct fat_item *current_item = 0;
+	struct fat_item *root_item = fat16_find_item_in_directory(disk, &fat_private->root_directory, path->part, path->len);
+	if (!root_item)
+	{
+		goto out;
+	}
+
+	struct path_part *next_part = path->next;
+	current_item = root_item;
+	while (next_part != 0)
+	{
+		if (current_item->type != FAT_ITEM_TYPE_DIRECTORY)
+		{
+			current_item = 0;
+			break;
+		}
+
+		struct fat_item *tmp_item = fat16_find_item_in_directory(disk, current_item->directory, next_part->part, next_part->len);
+		fat16_fat_item_free(current_item);
+		current_item = tmp_item;
+		next_part = next_part->next;
+	}
+
+out:
+	return current_item;
+}
+
+static uint32_t fat16_cluster_size(struct disk *disk, struct fat_private *private)
+{
+	return private->header.primary_header.sectors_per_cluster * disk->sector_size;
+}
+
+static bool fat16_cluster_is_free(struct fat_private *private, uint32_t cluster)
+{
+	return private->free_bitmap[cluster / 32] & (1u << (cluster % 32));
+}
+
+// updates the in memory FAT and bitmap, the FAT sectors are written by fat16_flush_fat
+static void fat16_set_fat_entry(struct disk *disk, uint32_t cluster, uint32_t value)
+{
+	struct fat_private *private = disk->fs_private;
+	fat16_mirror_set(private, cluster, value);
+	fat16_free_bitmap_set(private, cluster, value == MYOS_FAT_ENTRY_FREE);
+
+	uint32_t sector = (cluster * fat16_fat_entry_size(private)) / disk->sector_size;
+	if (private->fat_dirty_end == 0)
+	{
+		private->fat_dirty_start = sector;
+		private->fat_dirty_end = sector + 1;
+	}
+	else if (sector < private->fat_dirty_start)
+	{
+		private->fat_dirty_start = sector;
+	}
+	else if (sector >= private->fat_dirty_end)
+	{
+		private->fat_dirty_end = sector + 1;
+	}
+}
+
+// writes the changed FAT sectors to every copy of the table in one go
+// FAT32 volumes with mirroring disabled only update the active copy
+static int fat16_flush_fat(struct disk *disk)
+{
+	int res = 0;
+	struct fat_private *private = disk->fs_private;
+	if (private->fat_dirty_end == 0)
+	{
+		return 0;
+	}
+
+	struct fat_header *header = &private->header.primary_header;
+	uint8_t *dirty = (uint8_t *)private->fat + private->fat_dirty_start * disk->sector_size;
+	int dirty_size = (private->fat_dirty_end - private->fat_dirty_start) * disk->sector_size;
+	for (uint32_t copy = 0; copy < header->fat_copies; copy++)
+	{
+		if (!private->mirror_fats && copy != private->active_fat)
+		{
+			continue;
+		}
+
+		uint32_t sector = header->reserved_sectors + copy * private->sectors_per_fat + private->fat_dirty_start;
+		res = fat16_metadata_write(disk, fat16_sector_to_absolute(disk, sector), dirty, dirty_size);
+		if (res < 0)
+		{
+			goto out;
+		}
+	}
+
+	private->fat_dirty_start = 0;
+	private->fat_dirty_end = 0;
+	if (private->fat32)
+	{
+		res = fat32_fsinfo_flush(disk, private);
+	}
+
+out:
+	return res;
+}
+
+static void fat16_free_chain(struct disk *disk, uint32_t cluster)
+{
+	struct fat_private *private = disk->fs_private;
+	for (uint32_t i = 0; i < private->total_fat_entries && cluster >= 2 && cluster < private->total_fat_entries; i++)
+	{
+		uint32_t next = fat16_mirror_get(private, cluster);
+		fat16_set_fat_entry(disk, cluster, MYOS_FAT_ENTRY_FREE);
+		if (fat16_fat_entry_check(next) < 0)
+		{
+			break;
+		}
+
+		cluster = next;
+	}
+}
+
+// first fit from the allocation hint, which only moves forward so FAT32 allocation does not rescan the whole table
+static uint32_t fat16_find_free_run_from_hint(struct fat_private *private, uint32_t wanted, uint32_t *total_out)
+{
+	uint32_t total_entries = private->total_fat_entries;
+	uint32_t cluster = private->next_free >= 2 && private->next_free < total_entries ? private->next_free : 2;
+	uint32_t scanned = 0;
+	while (scanned < total_entries)
+	{
+		if (fat16_cluster_is_free(private, cluster))
+		{
+			uint32_t total = 0;
+			while (total < wanted && cluster + total < total_entries && fat16_cluster_is_free(private, cluster + total))
+			{
+				total++;
+			}
+
+			private->next_free = cluster + total;
+			*total_out = total;
+			return cluster;
+		}
+
+		// skip fully allocated words
+		uint32_t step = (cluster % 32) == 0 && private->free_bitmap[cluster / 32] == 0 ? 32 : 1;
+		cluster += step;
+		scanned += step;
+		if (cluster >= total_entries)
+		{
+			cluster = 2;
+		}
+	}
+
+	*total_out = 0;
+	return 0;
+}
+
+// best fit: the smallest free run holding wanted clusters, or the largest run when none is big enough
+// a run continuing right after the cluster `after` wins outright so files grow in place
+static uint32_t fat16_find_free_run(struct fat_private *private, uint32_t after, uint32_t wanted, uint32_t *total_out)
+{
+	uint32_t total_entries = private->total_fat_entries;
+	if (after >= 2 && after + 1 < total_entries && fat16_cluster_is_free(private, after + 1))
+	{
+		uint32_t total = 0;
+		while (total < wanted && after + 1 + total < total_entries && fat16_cluster_is_free(private, after + 1 + total))
+		{
+			total++;
+		}
+
+		*total_out = total;
+		return after + 1;
+	}
+
+	// a FAT32 table is too large to scan for the best fit on every allocation
+	if (private->fat32)
+	{
+		return fat16_find_free_run_from_hint(private, wanted, total_out);
+	}
+
+	uint32_t best = 0;
+	uint32_t best_total = 0;
+	uint32_t largest = 0;
+	uint32_t largest_total = 0;
+	uint32_t cluster = 2;
+	while (cluster < total_entries)
+	{
+		// skip fully allocated words
+		if ((cluster % 32) == 0 && private->free_bitmap[cluster / 32] == 0)
+		{
+			cluster += 32;
+			continue;
+		}
+
+		if (!fat16_cluster_is_free(private, cluster))
+		{
+			cluster++;
+			continue;
+		}
+
+		uint32_t start = cluster;
+		while (cluster < total_entries && fat16_cluster_is_free(private, cluster))
+		{
+			cluster++;
+		}
+
+		uint32_t total = cluster - start;
+		if (total >= wanted && (!best || total < best_total))
+		{
+			best = start;
+			best_total = total;
+			if (total == wanted)
+			{
+				break;
+			}
+		}
+
+		if (total > largest_total)
+		{
+			largest = start;
+			largest_total = total;
+		}
+	}
+
+	if (best)
+	{
+		*total_out = wanted;
+		return best;
+	}
+
+	*total_out = largest_total;
+	return largest;
+}
+
+// gives back the part of the reservation the file never used
+static void fat16_release_reservation(struct disk *disk, struct fat_file_descriptor *desc)
+{
+	struct fat_private *private = disk->fs_private;
+	for (uint32_t i = 0; i < desc->reserve_total; i++)
+	{
+		fat16_free_bitmap_set(private, desc->reserve_cluster + i, true);
+	}
+
+	desc->reserve_cluster = 0;
+	desc->reserve_total = 0;
+}
+
+static int fat16_next_free_cluster(struct disk *disk, struct fat_file_descriptor *desc, uint32_t clusters_wanted)
+{
+	struct fat_private *private = disk->fs_private;
+	if (desc->reserve_total == 0)
+	{
+		uint32_t total = 0;
+		uint32_t start = fat16_find_free_run(private, desc->last_cluster, clusters_wanted + MYOS_FAT_RESERVE_CLUSTERS, &total);
+		if (!start || total == 0)
+		{
+			return -ENOMEM;
+		}
+
+		// other writers skip reserved clusters, the FAT only learns about them once they are linked
+		for (uint32_t i = 0; i < total; i++)
+		{
+			fat16_free_bitmap_set(private, start + i, false);
+		}
+
+		desc->reserve_cluster = start;
+		desc->reserve_total = total;
+	}
+
+	desc->reserve_total--;
+	return desc->reserve_cluster++;
+}
+
+static void fat16_set_first_cluster(struct fat_directory_item *item, uint32_t cluster)
+{
+	item->high_16_bits_first_cluster = cluster >> 16;
+	item->low_16_bits_first_cluster = cluster & 0xffff;
+}
+
+static void fat16_extent_map_append(struct fat_extent_map *map, uint32_t index, uint32_t cluster)
+{
+	if (!map->extents)
+	{
+		return;
+	}
+
+	struct fat_extent *last = map->total ? &map->extents[map->total - 1] : NULL;
+	if (last && last->cluster + last->total == cluster)
+	{
+		last->total++;
+		return;
+	}
+
+	if (map->total == MYOS_FAT_MAX_EXTENTS)
+	{
+		// too fragmented now, the cursor takes over
+		kfree(map->extents);
+		map->extents = NULL;
+		map->total = 0;
+		return;
+	}
+
+	map->extents[map->total].index = index;
+	map->extents[map->total].cluster = cluster;
+	map->extents[map->total].total = 1;
+	map->total++;
+}
+
+// grows the chain until it holds total_clusters clusters
+static int fat16_extend_chain(struct disk *disk, struct fat_file_descriptor *desc, uint32_t total_clusters)
+{
+	int res = 0;
+	struct fat_directory_item *item = desc->item->item;
+	while (desc->total_clusters < total_clusters)
+	{
+		res = fat16_next_free_cluster(disk, desc, total_clusters - desc->total_clusters);
+		if (res < 0)
+		{
+			goto out;
+		}
+
+		uint32_t cluster = res;
+		fat16_set_fat_entry(disk, cluster, MYOS_FAT_ENTRY_END_OF_CHAIN);
+		if (desc->last_cluster)
+		{
+			fat16_set_fat_entry(disk, desc->last_cluster, cluster);
+		}
+		else
+		{
+			fat16_set_first_cluster(item, cluster);
+			desc->dirty = true;
+		}
+
+		fat16_extent_map_append(&desc->extent_map, desc->total_clusters, cluster);
+		desc->last_cluster = cluster;
+		desc->total_clusters++;
+	}
+
+	res = 0;
+out:
+	return res;
+}
+
+static int fat16_chain_end(struct disk *disk, uint32_t first_cluster, uint32_t *total_out, uint32_t *last_out)
+{
+	int res = 0;
+	struct fat_private *private = disk->fs_private;
+	uint32_t total = 0;
+	uint32_t cluster = first_cluster;
+	uint32_t last = 0;
+	while (cluster >= 2 && cluster < private->total_fat_entries && total < private->total_fat_entries)
+	{
+		last = cluster;
+		total++;
+		uint32_t next = 0;
+		res = fat16_get_fat_entry(disk, cluster, &next);
+		if (res < 0)
+		{
+			return res;
+		}
+
+		if (fat16_fat_entry_check(next) < 0)
+		{
+			break;
+		}
+
+		cluster = next;
+	}
+
+	*total_out = total;
+	*last_out = last;
+	return res;
+}
+
+// absolute byte position of a directory entry on the disk
+static int fat16_directory_entry_position(struct disk *disk, uint32_t dir_cluster, uint32_t index, long *pos_out)
+{
+	struct fat_private *private = disk->fs_private;
+	uint32_t offset = index * sizeof(struct fat_directory_item);
+	if (dir_cluster == 0)
+	{
+		if (index >= private->header.primary_header.root_dir_entries)
+		{
+			return -EOUTOFRANGE;
+		}
+
+		*pos_out = fat16_sector_to_absolute(disk, private->root_directory.sector_pos) + offset;
+		return 0;
+	}
+
+	uint32_t cluster_size = fat16_cluster_size(disk, private);
+	struct fat_chain_cursor cursor = {0};
+	int res = fat16_chain_lookup(disk, &cursor, NULL, dir_cluster, offset / cluster_size);
+	if (res < 0)
+	{
+		return res;
+	}
+
+	*pos_out = fat16_sector_to_absolute(disk, fat16_cluster_to_sector(private, res)) + offset % cluster_size;
+	return 0;
+}
+
+static int fat16_write_directory_entry(struct disk *disk, uint32_t dir_cluster, uint32_t index, struct fat_directory_item *entry)
+{
+	int res = 0;
+	struct fat_private *private = disk->fs_private;
+	long pos = 0;
+	res = fat16_directory_entry_position(disk, dir_cluster, index, &pos);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = fat16_metadata_write(disk, pos, entry, sizeof(struct fat_directory_item));
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	// the root directory stays loaded for the life of the mount, subdirectories are reloaded on demand
+	struct fat_directory *root = &private->root_directory;
+	if (dir_cluster == root->first_cluster)
+	{
+		// the FAT16 root is loaded at its full fixed size, a FAT32 root only holds the slots in use
+		if (private->fat32 && (int)index >= root->total)
+		{
+			struct fat_directory_item *items = krealloc(root->item, (index + 1) * sizeof(struct fat_directory_item));
+			if (!items)
+			{
+				res = -ENOMEM;
+				goto out;
+			}
+
+			root->item = items;
+		}
+
+		memcpy(&root->item[index], entry, sizeof(struct fat_directory_item));
+		if ((int)index >= root->total)
+		{
+			root->total = index + 1;
+		}
+	}
+
+	dentry_invalidate_disk(disk);
+out:
+	return res;
+}
+
+// FAT first, so the directory entry never points at a chain that is not on disk yet
+static int fat16_flush_descriptor(struct disk *disk, struct fat_file_descriptor *desc)
+{
+	int res = 0;
+	fat16_release_reservation(disk, desc);
+	res = fat16_flush_fat(disk);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	if (desc->dirty)
+	{
+		res = fat16_write_directory_entry(disk, desc->item->dir_cluster, desc->item->dir_index, desc->item->item);
+		if (res < 0)
+		{
+			goto out;
+		}
+
+		desc->dirty = false;
+	}
+
+out:
+	return res;
+}
+
+static bool fat16_short_name_char_valid(char c)
+{
+	const char *invalid = "\"*+,/:;<=>?[\\]|.";
+	if (c <= ' ')
+	{
+		return false;
+	}
+
+	for (const char *i = invalid; *i; i++)
+	{
+		if (*i == c)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// converts a name into a space padded 8.3 entry name, long names are not supported
+static int fat16_name_to_short(const char *name, int len, uint8_t *filename, uint8_t *ext)
+{
+	memset(filename, ' ', 8);
+	memset(ext, ' ', 3);
+	int total = 0;
+	const char *c = name;
+	const char *end = name + len;
+	for (; c < end && *c != '.'; c++)
+	{
+		if (total == 8 || !fat16_short_name_char_valid(*c))
+		{
+			return -EINVARG;
+		}
+
+		filename[total++] = toupper(*c);
+	}
+
+	if (total == 0)
+	{
+		return -EINVARG;
+	}
+
+	if (c < end && *c == '.')
+	{
+		c++;
+		total = 0;
+		for (; c < end; c++)
+		{
+			if (total == 3 || !fat16_short_name_char_valid(*c))
+			{
+				return -EINVARG;
+			}
+
+			ext[total++] = toupper(*c);
+		}
+	}
+
+	return 0;
+}
+
+// adds a cluster of empty entries to a full subdirectory
+static int fat16_extend_directory(struct disk *disk, uint32_t dir_cluster)
+{
+	int res = 0;
+	struct fat_private *private = disk->fs_private;
+	uint32_t total_clusters = 0;
+	uint32_t last = 0;
+	res = fat16_chain_end(disk, dir_cluster, &total_clusters, &last);
+	if (res < 0)
+	{
+		return res;
+	}
+
+	uint32_t total = 0;
+	uint32_t cluster = fat16_find_free_run(private, last, 1, &total);
+	if (!cluster || total == 0)
+	{
+		return -ENOMEM;
+	}
+
+	uint32_t cluster_size = fat16_cluster_size(disk, private);
+	void *zeroes = kzalloc(cluster_size);
+	if (!zeroes)
+	{
+		return -ENOMEM;
+	}
+
+	res = fat16_metadata_write(disk, fat16_sector_to_absolute(disk, fat16_cluster_to_sector(private, cluster)), zeroes, cluster_size);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	fat16_set_fat_entry(disk, cluster, MYOS_FAT_ENTRY_END_OF_CHAIN);
+	fat16_set_fat_entry(disk, last, cluster);
+	res = fat16_flush_fat(disk);
+
+out:
+	kfree(zeroes);
+	return res;
+}
+
+// a free slot in directory, deleted entries are reused before the end marker moves
+static int fat16_directory_free_slot(struct disk *disk, struct fat_directory *directory, uint32_t *index_out)
+{
+	int res = 0;
+	struct fat_private *private = disk->fs_private;
+	for (int i = 0; i < directory->total; i++)
+	{
+		if (directory->item[i].filename[0] == MYOS_FAT_DELETED_ENTRY)
+		{
+			*index_out = i;
+			return 0;
+		}
+	}
+
+	uint32_t index = directory->total;
+	if (directory->first_cluster == 0)
+	{
+		if (index >= private->header.primary_header.root_dir_entries)
+		{
+			return -ENOMEM;
+		}
+
+		*index_out = index;
+		return 0;
+	}
+
+	uint32_t total_clusters = 0;
+	uint32_t last = 0;
+	res = fat16_chain_end(disk, directory->first_cluster, &total_clusters, &last);
+	if (res < 0)
+	{
+		return res;
+	}
+
+	uint32_t capacity = total_clusters * (fat16_cluster_size(disk, private) / sizeof(struct fat_directory_item));
+	if (index >= capacity)
+	{
+		res = fat16_extend_directory(disk, directory->first_cluster);
+		if (res < 0)
+		{
+			return res;
+		}
+	}
+
+	*index_out = index;
+	return 0;
+}
+
+// creates an empty file for the last component of path
+static struct fat_item *fat16_create_file(struct disk *disk, struct path_part *path, int *res_out)
+{
+	int res = 0;
+	struct fat_private *private = disk->fs_private;
+	struct fat_item *parent = NULL;
+	struct fat_item *item = NULL;
+	struct fat_directory *directory = &private->root_directory;
+	struct path_part *part = path;
+	while (part->next)
+	{
+		struct fat_item *next = fat16_find_item_in_directory(disk, directory, part->part, part->len);
+		if (parent)
+		{
+			fat16_fat_item_free(parent);
+		}
+
+		parent = next;
+		if (!parent || parent->type != FAT_ITEM_TYPE_DIRECTORY)
+		{
+			res = -ENOENT;
+			goto out;
+		}
+
+		directory = parent->directory;
+		part = part->next;
+	}
+
+	struct fat_directory_item entry;
+	memset(&entry, 0, sizeof(entry));
+	res = fat16_name_to_short(part->part, part->len, entry.filename, entry.ext);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	entry.attribute = FAT_FILE_ARCHIVED;
+
+	uint32_t index = 0;
+	res = fat16_directory_free_slot(disk, directory, &index);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = fat16_write_directory_entry(disk, directory->first_cluster, index, &entry);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	item = kzalloc(sizeof(struct fat_item));
+	if (!item)
+	{
+		res = -ENOMEM;
+		goto out;
+	}
+
+	item->type = FAT_ITEM_TYPE_FILE;
+	item->dir_cluster = directory->first_cluster;
+	item->dir_index = index;
+	item->item = fat16_clone_directory_item(&entry, sizeof(entry));
+	if (!item->item)
+	{
+		kfree(item);
+		item = NULL;
+		res = -ENOMEM;
+	}
+
+out:
+	if (parent)
+	{
+		fat16_fat_item_free(parent);
+	}
+
+	*res_out = res;
+	return item;
+}
+
+// shrinks or grows the chain to hold size bytes, grown space reads back as zeroes
+static int fat16_truncate_internal(struct disk *disk, struct fat_file_descriptor *desc, uint32_t size)
+{
+	int res = 0;
+	struct fat_private *private = disk->fs_private;
+	struct fat_directory_item *item = desc->item->item;
+	uint32_t cluster_size = fat16_cluster_size(disk, private);
+	uint32_t total_clusters = (size + cluster_size - 1) / cluster_size;
+	if (size > item->filesize)
+	{
+		res = fat16_extend_chain(disk, desc, total_clusters);
+		if (res < 0)
+		{
+			goto out;
+		}
+
+		void *zeroes = kzalloc(cluster_size);
+		if (!zeroes)
+		{
+			res = -ENOMEM;
+			goto out;
+		}
+
+		for (uint32_t offset = item->filesize; offset < size && res >= 0;)
+		{
+			uint32_t amount = cluster_size - offset % cluster_size;
+			if (amount > size - offset)
+			{
+				amount = size - offset;
+			}
+
+			res = fat16_write_internal(disk, desc, fat16_get_first_cluster(item), offset, amount, zeroes);
+			offset += amount;
+		}
+
+		kfree(zeroes);
+		if (res < 0)
+		{
+			goto out;
+		}
+
+		res = 0;
+	}
+	else if (total_clusters < desc->total_clusters)
+	{
+		if (total_clusters == 0)
+		{
+			fat16_free_chain(disk, fat16_get_first_cluster(item));
+			fat16_set_first_cluster(item, 0);
+			desc->last_cluster = 0;
+		}
+		else
+		{
+			struct fat_chain_cursor cursor = {0};
+			res = fat16_chain_lookup(disk, &cursor, NULL, fat16_get_first_cluster(item), total_clusters - 1);
+			if (res < 0)
+			{
+				goto out;
+			}
+
+			uint32_t last = res;
+			uint32_t rest = fat16_mirror_get(private, last);
+			fat16_set_fat_entry(disk, last, MYOS_FAT_ENTRY_END_OF_CHAIN);
+			fat16_free_chain(disk, rest);
+			desc->last_cluster = last;
+			res = 0;
+		}
+
+		desc->total_clusters = total_clusters;
+		memset(&desc->cursor, 0, sizeof(desc->cursor));
+		kfree(desc->extent_map.extents);
+		desc->extent_map.extents = NULL;
+		fat16_extent_map_build(disk, fat16_get_first_cluster(item), &desc->extent_map);
+	}
+
+	if (item->filesize != size)
+	{
+		item->filesize = size;
+		desc->dirty = true;
+	}
+
+	if (desc->pos > size)
+	{
+		desc->pos = size;
+	}
+
+out:
+	return res;
+}
+
+// takes ownership of item
+static void *fat16_new_file_descriptor(struct disk *disk, struct fat_item *item, FILE_MODE mode)
+{
+	int res = 0;
+	struct fat_private *private = disk->fs_private;
+	if (mode != FILE_MODE_READ && (item->type != FAT_ITEM_TYPE_FILE || (item->item->attribute & FAT_FILE_READ_ONLY) || !private->fat))
+	{
+		res = item->type != FAT_ITEM_TYPE_FILE ? -EINVARG : -ERDONLY;
+		fat16_fat_item_free(item);
+		return ERROR(res);
+	}
+
+	struct fat_file_descriptor *descriptor = kzalloc(sizeof(struct fat_file_descriptor));
+	if (!descriptor)
+	{
+		fat16_fat_item_free(item);
+		return ERROR(-ENOMEM);
+	}
+
+	descriptor->disk = disk;
+	descriptor->item = item;
+	descriptor->pos = 0;
+	descriptor->mode = mode;
+	diskstreamer_init(&descriptor->stream, disk);
+	if (descriptor->item->type != FAT_ITEM_TYPE_FILE)
+	{
+		return descriptor;
+	}
+
+	uint32_t first_cluster = fat16_get_first_cluster(descriptor->item->item);
+	res = fat16_chain_end(disk, first_cluster, &descriptor->total_clusters, &descriptor->last_cluster);
+	if (res == 0)
 	{
-		goto out;
+		// optional, without a map reads still go through the cursor
+		fat16_extent_map_build(disk, first_cluster, &descriptor->extent_map);
 	}
-out:
-	if (res != MYOS_ALL_OK)
+
+	if (res == 0 && mode == FILE_MODE_WRITE)
 	{
-		fat16_free_directory(directory);
+		res = fat16_truncate_internal(disk, descriptor, 0);
+		if (res == 0)
+		{
+			res = fat16_flush_descriptor(disk, descriptor);
+		}
 	}
-	return directory;
-}
-
-struct fat_item *fat16_new_fat_item_for_directory_item(struct disk *disk, struct fat_directory_item *item)
-{
-	struct fat_item *f_item = kzalloc(sizeof(struct fat_item));
-	if (!f_item)
+	else if (res == 0 && mode == FILE_MODE_APPEND)
 	{
-		return 0;
+		descriptor->pos = descriptor->item->item->filesize;
 	}
 
-	if (item->attribute & FAT_FILE_SUBDIRECTORY)
+	if (res < 0)
 	{
-		f_item->directory = fat16_load_directory(disk, item);
-		f_item->type = FAT_ITEM_TYPE_DIRECTORY;
-		return f_item;
+		diskstreamer_release(&descriptor->stream);
+		kfree(descriptor->extent_map.extents);
+		fat16_fat_item_free(item);
+		kfree(descriptor);
+		return ERROR(res);
 	}
 
-	f_item->type = FAT_ITEM_TYPE_FILE;
-	f_item->item = fat16_clone_directory_item(item, sizeof(struct fat_directory_item));
-	return f_item;
+	descriptor->open_next = private->open_files;
+	private->open_files = descriptor;
+	return descriptor;
 }
 
-struct fat_item *fat16_find_item_in_directory(struct disk *disk, struct fat_directory *directory, const char *name)
+// write and append modes create the file when it does not exist
+void *fat16_open(struct disk *disk, struct path_part *path, FILE_MODE mode)
 {
-	struct fat_item *f_item = 0;
-	char tmp_filename[MYOS_MAX_PATH];
-	for (int i = 0; i < directory->total; i++)
+	int res = 0;
+	struct fat_private *private = disk->fs_private;
+	if (mode != FILE_MODE_READ && !private->fat)
 	{
-		fat16_get_full_relative_filename(&directory->item[i], tmp_filename, sizeof(tmp_filename));
-		if (istrncmp(tmp_filename, name, sizeof(tmp_filename)) == 0)
+		return ERROR(-ERDONLY);
+	}
+
+	struct fat_item *item = fat16_get_directory_entry(disk, path);
+	if (!item && mode != FILE_MODE_READ)
+	{
+		item = fat16_create_file(disk, path, &res);
+		if (!item)
 		{
-			// found the file, creating a new fat_item
-			f_item = fat16_new_fat_item_for_directory_item(disk, &directory->item[i]);
+			return ERROR(res);
 		}
 	}
 
-	return f_item;
+	if (!item)
+	{
+		return ERROR(-EIO);
+	}
+
+	return fat16_new_file_descriptor(disk, item, mode);
 }
 
-struct fat_item *fat16_get_directory_entry(struct disk *disk, struct path_part *path)
+static struct fat_item *fat16_fat_item_clone(struct fat_item *item)
 {
-	struct fat_private *fat_private = disk->fs_private;
-	struct fat_item *current_item = 0;
-	struct fat_item *root_item = fat16_find_item_in_directory(disk, &fat_private->root_directory, path->part);
-	if (!root_item)
+	struct fat_item *clone = kzalloc(sizeof(struct fat_item));
+	if (!clone)
 	{
-		goto out;
+		return 0;
 	}
 
-	struct path_part *next_part = path->next;
-	current_item = root_item;
-	while (next_part != 0)
+	clone->type = item->type;
+	clone->dir_cluster = item->dir_cluster;
+	clone->dir_index = item->dir_index;
+	if (item->type == FAT_ITEM_TYPE_FILE)
 	{
-		if (current_item->type != FAT_ITEM_TYPE_DIRECTORY)
+		clone->item = fat16_clone_directory_item(item->item, sizeof(struct fat_directory_item));
+		if (!clone->item)
 		{
-			current_item = 0;
-			break;
+			kfree(clone);
+			return 0;
 		}
 
-		struct fat_item *tmp_item = fat16_find_item_in_directory(disk, current_item->directory, next_part->part);
-		fat16_fat_item_free(current_item);
-		current_item = tmp_item;
-		next_part = next_part->next;
+		return clone;
 	}
 
-out:
-	return current_item;
-}
+	clone->directory = kzalloc(sizeof(struct fat_directory));
+	if (!clone->directory)
+	{
+		kfree(clone);
+		return 0;
+	}
 
-void *fat16_open(struct disk *disk, struct path_part *path, FILE_MODE mode)
-{
-	struct fat_file_descriptor *descriptor = 0;
-	int err_code = 0;
-	if (mode != FILE_MODE_READ)
+	memcpy(clone->directory, item->directory, sizeof(struct fat_directory));
+	clone->directory->item = fat16_clone_directory_item(item->directory->item, item->directory->total * sizeof(struct fat_directory_item));
+	if (!clone->directory->item)
 	{
-		err_code = -ERDONLY;
-		goto err_out;
+		kfree(clone->directory);
+		kfree(clone);
+		return 0;
 	}
 
-	descriptor = kzalloc(sizeof(struct fat_file_descriptor));
-	if (!descriptor)
+	return clone;
+}
+
+// nodes are fat items, directories keep their entries loaded for as long as the dentry cache holds them
+int fat16_lookup(struct disk *disk, void *parent, const char *name, int len, void **node_out)
+{
+	struct fat_private *fat_private = disk->fs_private;
+	struct fat_directory *directory = &fat_private->root_directory;
+	if (parent)
 	{
-		err_code = -ENOMEM;
-		goto err_out;
+		struct fat_item *parent_item = parent;
+		if (parent_item->type != FAT_ITEM_TYPE_DIRECTORY)
+		{
+			return -EINVARG;
+		}
+
+		directory = parent_item->directory;
 	}
 
-	descriptor->item = fat16_get_directory_entry(disk, path);
-	if (!descriptor->item)
+	struct fat_item *item = fat16_find_item_in_directory(disk, directory, name, len);
+	if (!item)
 	{
-		err_code = -EIO;
-		goto err_out;
+		return -ENOENT;
 	}
 
-	descriptor->pos = 0;
-	return descriptor;
+	*node_out = item;
+	return 0;
+}
 
-err_out:
-	if (descriptor)
+void *fat16_open_node(struct disk *disk, void *node, FILE_MODE mode)
+{
+	// the cache keeps the node, the descriptor gets its own copy
+	struct fat_item *item = fat16_fat_item_clone(node);
+	if (!item)
 	{
-		kfree(descriptor);
+		return ERROR(-ENOMEM);
 	}
 
-	return ERROR(err_code);
+	return fat16_new_file_descriptor(disk, item, mode);
+}
+
+void fat16_release_node(void *node)
+{
+	fat16_fat_item_free(node);
 }
 
 int fat16_read(struct disk *disk, void *descriptor, uint32_t size, uint32_t nmemb, char *out_ptr)
@@ -679,7 +1932,7 @@ int fat16_read(struct disk *disk, void *descriptor, uint32_t size, uint32_t nmem
 	int offset = fat_desc->pos;
 	for (uint32_t i = 0; i < nmemb; i++)
 	{
-		res = fat16_read_internal(disk, fat16_get_first_cluster(item), offset, size, out_ptr);
+		res = fat16_read_internal(disk, fat_desc, fat16_get_first_cluster(item), offset, size, out_ptr);
 		if (ISERR(res))
 		{
 			goto out;
@@ -695,6 +1948,43 @@ out:
 	return res;
 }
 
+// the first cluster, stable for as long as the file keeps its data
+int fat16_file_id(void *private, uint32_t *id_out)
+{
+	struct fat_file_descriptor *desc = private;
+	if (desc->item->type != FAT_ITEM_TYPE_FILE)
+	{
+		return -EINVARG;
+	}
+
+	*id_out = fat16_get_first_cluster(desc->item->item);
+	return 0;
+}
+
+int fat16_read_at(struct disk *disk, void *private, uint32_t offset, uint32_t size, char *out)
+{
+	struct fat_file_descriptor *desc = private;
+	if (desc->item->type != FAT_ITEM_TYPE_FILE)
+	{
+		return -EINVARG;
+	}
+
+	struct fat_directory_item *item = desc->item->item;
+	if (offset > item->filesize || size > item->filesize - offset)
+	{
+		return -EOUTOFRANGE;
+	}
+
+	return fat16_read_internal(disk, desc, fat16_get_first_cluster(item), offset, size, out);
+}
+
+int fat16_tell(void *private, uint32_t *pos_out)
+{
+	struct fat_file_descriptor *desc = private;
+	*pos_out = desc->pos;
+	return 0;
+}
+
 int fat16_seek(void *private, uint32_t offset, FILE_SEEK_MODE seek_mode)
 {
 	int res = 0;
@@ -706,8 +1996,9 @@ int fat16_seek(void *private, uint32_t offset, FILE_SEEK_MODE seek_mode)
 		goto out;
 	}
 
+	// the end of the file is a valid position, writers extend the file from there and cached reads return nothing
 	struct fat_directory_item *ritem = desc_item->item;
-	if (offset >= ritem->filesize)
+	if (offset > ritem->filesize)
 	{
 		res = -EIO;
 		goto out;
@@ -764,8 +2055,41 @@ out:
 	return res;
 }
 
+// true while a descriptor is open on the directory entry
+static bool fat16_file_is_open(struct fat_private *private, struct fat_item *item)
+{
+	for (struct fat_file_descriptor *desc = private->open_files; desc; desc = desc->open_next)
+	{
+		if (desc->item->dir_cluster == item->dir_cluster && desc->item->dir_index == item->dir_index)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
 static void fat16_free_file_descriptor(struct fat_file_descriptor *desc)
 {
+	if (desc->mode != FILE_MODE_READ)
+	{
+		fat16_flush_descriptor(desc->disk, desc);
+	}
+
+	struct fat_private *private = desc->disk->fs_private;
+	struct fat_file_descriptor **link = &private->open_files;
+	while (*link && *link != desc)
+	{
+		link = &(*link)->open_next;
+	}
+
+	if (*link)
+	{
+		*link = desc->open_next;
+	}
+
+	diskstreamer_release(&desc->stream);
+	kfree(desc->extent_map.extents);
 	fat16_fat_item_free(desc->item);
 	kfree(desc);
 }
@@ -775,3 +2099,212 @@ int fat16_close(void *private)
 	fat16_free_file_descriptor((struct fat_file_descriptor *)private);
 	return 0;
 }
+
+int fat16_write(struct disk *disk, void *descriptor, uint32_t size, uint32_t nmemb, const char *in)
+{
+	int res = 0;
+	struct fat_file_descriptor *desc = descriptor;
+	if (desc->mode == FILE_MODE_READ)
+	{
+		res = -ERDONLY;
+		goto out;
+	}
+
+	if (desc->item->type != FAT_ITEM_TYPE_FILE)
+	{
+		res = -EINVARG;
+		goto out;
+	}
+
+	uint64_t total = (uint64_t)size * nmemb;
+	struct fat_directory_item *item = desc->item->item;
+	if (desc->mode == FILE_MODE_APPEND)
+	{
+		desc->pos = item->filesize;
+	}
+
+	if (desc->pos + total > 0xffffffff)
+	{
+		res = -EOUTOFRANGE;
+		goto out;
+	}
+
+	// every cluster the write needs is allocated up front, so the whole write maps onto as few runs as possible
+	uint32_t cluster_size = fat16_cluster_size(disk, disk->fs_private);
+	uint32_t end = desc->pos + total;
+	res = fat16_extend_chain(disk, desc, (end + cluster_size - 1) / cluster_size);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = fat16_write_internal(disk, desc, fat16_get_first_cluster(item), desc->pos, total, in);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	desc->pos = end;
+	if (end > item->filesize)
+	{
+		item->filesize = end;
+		desc->dirty = true;
+	}
+
+	res = nmemb;
+out:
+	return res;
+}
+
+int fat16_truncate(struct disk *disk, void *descriptor, uint32_t size)
+{
+	int res = 0;
+	struct fat_file_descriptor *desc = descriptor;
+	if (desc->mode == FILE_MODE_READ)
+	{
+		res = -ERDONLY;
+		goto out;
+	}
+
+	if (desc->item->type != FAT_ITEM_TYPE_FILE)
+	{
+		res = -EINVARG;
+		goto out;
+	}
+
+	res = fat16_truncate_internal(disk, desc, size);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = fat16_flush_descriptor(disk, desc);
+out:
+	return res;
+}
+
+// removes a file, directories and files that are still open are not supported
+int fat16_unlink(struct disk *disk, struct path_part *path)
+{
+	int res = 0;
+	struct fat_private *private = disk->fs_private;
+	if (!private->fat)
+	{
+		return -ERDONLY;
+	}
+
+	struct fat_item *item = fat16_get_directory_entry(disk, path);
+	if (!item)
+	{
+		res = -ENOENT;
+		goto out;
+	}
+
+	if (item->type != FAT_ITEM_TYPE_FILE)
+	{
+		res = -EINVARG;
+		goto out;
+	}
+
+	if (item->item->attribute & FAT_FILE_READ_ONLY)
+	{
+		res = -ERDONLY;
+		goto out;
+	}
+
+	// open descriptors would keep writing into the freed chain and close would bring the entry back
+	if (fat16_file_is_open(private, item))
+	{
+		res = -EISTKN;
+		goto out;
+	}
+
+	fat16_free_chain(disk, fat16_get_first_cluster(item->item));
+	res = fat16_flush_fat(disk);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	item->item->filename[0] = MYOS_FAT_DELETED_ENTRY;
+	res = fat16_write_directory_entry(disk, item->dir_cluster, item->dir_index, item->item);
+
+out:
+	if (item)
+	{
+		fat16_fat_item_free(item);
+	}
+
+	return res;
+}
+
+static FILE_ATTRIBUTES fat16_attributes_to_file(uint8_t attribute)
+{
+	FILE_ATTRIBUTES attributes = 0;
+	if (attribute & FAT_FILE_SUBDIRECTORY)
+	{
+		attributes |= FILE_ATTRIBUTE_DIRECTORY;
+	}
+
+	if (attribute & FAT_FILE_READ_ONLY)
+	{
+		attributes |= FILE_ATTRIBUTE_READ_ONLY;
+	}
+
+	if (attribute & FAT_FILE_HIDDEN)
+	{
+		attributes |= FILE_ATTRIBUTE_HIDDEN;
+	}
+
+	if (attribute & FAT_FILE_SYSTEM)
+	{
+		attributes |= FILE_ATTRIBUTE_SYSTEM;
+	}
+
+	return attributes;
+}
+
+// served from the loaded directory, the root is kept in the private data and subdirectories by the dentry cache
+// the cursor is the slot index, so deleted and volume label slots are stepped over without being returned
+int fat16_readdir(struct disk *disk, void *node, uint32_t *cursor, struct file_dirent *out, int max)
+{
+	struct fat_private *fat_private = disk->fs_private;
+	struct fat_directory *directory = &fat_private->root_directory;
+	if (node)
+	{
+		struct fat_item *item = node;
+		if (item->type != FAT_ITEM_TYPE_DIRECTORY)
+		{
+			return -EINVARG;
+		}
+
+		directory = item->directory;
+	}
+
+	int total = 0;
+	uint32_t i = *cursor;
+	for (; i < (uint32_t)directory->total && total < max; i++)
+	{
+		struct fat_directory_item *item = &directory->item[i];
+		if (item->filename[0] == 0x00)
+		{
+			i = directory->total;
+			break;
+		}
+
+		if (item->filename[0] == MYOS_FAT_DELETED_ENTRY || (item->attribute & FAT_FILE_VOLUME_LABEL))
+		{
+			continue;
+		}
+
+		struct file_dirent *dirent = &out[total++];
+		memset(dirent, 0, sizeof(struct file_dirent));
+		fat16_get_full_relative_filename(item, dirent->name, sizeof(dirent->name));
+		dirent->size = item->filesize;
+		dirent->attributes = fat16_attributes_to_file(item->attribute);
+		dirent->first_cluster = fat16_get_first_cluster(item);
+	}
+
+	*cursor = i;
+	return total;
+}
@@ -0,0 +1,185 @@
+#include "fat32.h"
+#include "fat.h"
+#include "status.h"
+#include "string/string.h"
+#include "disk/disk.h"
+#include "memory/heap/kheap.h"
+#include "memory/memory.h"
+#include "kernel.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// FAT32 shares everything past the boot sector with the FAT16 driver, this file only
+// knows where a FAT32 volume keeps its layout and the FSInfo allocation hint
+
+#define MYOS_FAT32_SIGNATURE 0x29
+#define MYOS_FAT32_SIGNATURE_SHORT 0x28 // extended header without the label and system id
+
+// bit 7 of the flags turns mirroring off, bits 0-3 then select the one active FAT
+#define MYOS_FAT32_FLAG_NO_MIRROR 0x80
+#define MYOS_FAT32_FLAG_ACTIVE_FAT 0x0f
+
+#define MYOS_FAT32_FSINFO_LEAD_SIGNATURE 0x41615252
+#define MYOS_FAT32_FSINFO_STRUCT_SIGNATURE 0x61417272
+#define MYOS_FAT32_FSINFO_UNKNOWN 0xffffffff
+
+struct fat32_fsinfo
+{
+	uint32_t lead_signature;
+	uint8_t reserved[480];
+	uint32_t struct_signature;
+	uint32_t free_count;
+	uint32_t next_free;
+	uint8_t reserved2[12];
+	uint32_t trail_signature;
+} __attribute__((packed));
+
+int fat32_resolve(struct disk *disk);
+
+struct filesystem fat32_fs = {
+	.resolve = fat32_resolve,
+	.open = fat16_open,
+	.read = fat16_read,
+	.seek = fat16_seek,
+	.stat = fat16_stat,
+	.close = fat16_close,
+	.volume_name = fat16_volume_name,
+	.lookup = fat16_lookup,
+	.open_node = fat16_open_node,
+	.release_node = fat16_release_node,
+	.write = fat16_write,
+	.truncate = fat16_truncate,
+	.unlink = fat16_unlink,
+	.readdir = fat16_readdir,
+	.file_id = fat16_file_id,
+	.read_at = fat16_read_at,
+	.tell = fat16_tell,
+};
+
+struct filesystem *fat32_init()
+{
+	strcpy(fat32_fs.name, "FAT32");
+	return &fat32_fs;
+}
+
+static int fat32_fsinfo_read(struct disk *disk, struct fat_private *private, struct fat32_fsinfo *fsinfo)
+{
+	int res = fat16_metadata_read(disk, (long)private->fsinfo_sector * disk->sector_size, fsinfo, sizeof(struct fat32_fsinfo));
+	if (res < 0)
+	{
+		return res;
+	}
+
+	if (fsinfo->lead_signature != MYOS_FAT32_FSINFO_LEAD_SIGNATURE || fsinfo->struct_signature != MYOS_FAT32_FSINFO_STRUCT_SIGNATURE)
+	{
+		return -EINFORMAT;
+	}
+
+	return 0;
+}
+
+// the hint is only advice, without a usable FSInfo sector allocation starts at cluster two
+static void fat32_fsinfo_load(struct disk *disk, struct fat_private *private)
+{
+	private->next_free = 2;
+	if (!private->fsinfo_sector)
+	{
+		return;
+	}
+
+	struct fat32_fsinfo fsinfo;
+	if (fat32_fsinfo_read(disk, private, &fsinfo) < 0)
+	{
+		private->fsinfo_sector = 0;
+		return;
+	}
+
+	if (fsinfo.next_free != MYOS_FAT32_FSINFO_UNKNOWN && fsinfo.next_free >= 2)
+	{
+		private->next_free = fsinfo.next_free;
+	}
+}
+
+// called after every FAT flush so the free count and hint on disk match the table
+int fat32_fsinfo_flush(struct disk *disk, struct fat_private *private)
+{
+	int res = 0;
+	if (!private->fsinfo_sector)
+	{
+		return 0;
+	}
+
+	struct fat32_fsinfo fsinfo;
+	res = fat32_fsinfo_read(disk, private, &fsinfo);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	fsinfo.free_count = private->total_free_clusters;
+	fsinfo.next_free = private->next_free;
+	res = fat16_metadata_write(disk, (long)private->fsinfo_sector * disk->sector_size, &fsinfo, sizeof(fsinfo));
+out:
+	return res;
+}
+
+int fat32_resolve(struct disk *disk)
+{
+	int res = 0;
+	struct fat_private *fat_private = kzalloc(sizeof(struct fat_private));
+	if (!fat_private)
+	{
+		return -ENOMEM;
+	}
+
+	disk->fs_private = fat_private;
+	disk->filesystem = &fat32_fs;
+
+	if (fat16_metadata_read(disk, 0, &fat_private->header, sizeof(fat_private->header)) != MYOS_ALL_OK)
+	{
+		res = -EIO;
+		goto out;
+	}
+
+	// the 16 bit FAT size and root directory size are zero on FAT32
+	struct fat_header *header = &fat_private->header.primary_header;
+	struct fat32_header_extended *fat32 = &fat_private->header.shared.fat32;
+	uint8_t signature = fat32->extended_header.signature;
+	if ((signature != MYOS_FAT32_SIGNATURE && signature != MYOS_FAT32_SIGNATURE_SHORT) ||
+		header->sectors_per_fat != 0 || header->root_dir_entries != 0 || fat32->sectors_per_fat == 0 ||
+		header->sectors_per_cluster == 0 || header->bytes_per_sector != disk->sector_size || fat32->root_cluster < 2)
+	{
+		res = -EFSNOTUS;
+		goto out;
+	}
+
+	fat_private->fat32 = true;
+	fat_private->sectors_per_fat = fat32->sectors_per_fat;
+	fat_private->data_start_sector = header->reserved_sectors + header->fat_copies * fat32->sectors_per_fat;
+	fat_private->mirror_fats = !(fat32->flags & MYOS_FAT32_FLAG_NO_MIRROR);
+	fat_private->active_fat = fat_private->mirror_fats ? 0 : fat32->flags & MYOS_FAT32_FLAG_ACTIVE_FAT;
+	if (fat_private->active_fat >= header->fat_copies)
+	{
+		res = -EFSNOTUS;
+		goto out;
+	}
+
+	fat_private->fsinfo_sector = fat32->fsinfo_sector != 0xffff ? fat32->fsinfo_sector : 0;
+	fat32_fsinfo_load(disk, fat_private);
+
+	res = fat16_mount_private(disk, fat_private);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	strncpy(fat_private->name, (const char *)fat32->extended_header.volume_id_string, sizeof(fat_private->name));
+
+out:
+	if (res < 0)
+	{
+		fat16_free_private(fat_private);
+		disk->fs_private = 0;
+	}
+	return res;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "file.h"
+
+struct filesystem *fat32_init();
@@ -0,0 +1,152 @@
+#include "fdtable.h"
+#include "file.h"
+#include "config.h"
+#include "memory/memory.h"
+#include "memory/heap/kheap.h"
+#include "status.h"
+
+static void fd_table_mark(struct fd_table *table, int slot, int free)
+{
+	uint32_t mask = 1u << (slot % 32);
+	if (free)
+	{
+		table->free_bitmap[slot / 32] |= mask;
+	}
+	else
+	{
+		table->free_bitmap[slot / 32] &= ~mask;
+	}
+}
+
+// capacity is rounded up to whole bitmap words
+static int fd_table_grow(struct fd_table *table, int capacity)
+{
+	capacity = (capacity + 31) / 32 * 32;
+	struct file_descriptor **files = krealloc(table->files, capacity * sizeof(struct file_descriptor *));
+	if (!files)
+	{
+		return -ENOMEM;
+	}
+	table->files = files;
+
+	uint32_t *free_bitmap = krealloc(table->free_bitmap, capacity / 32 * sizeof(uint32_t));
+	if (!free_bitmap)
+	{
+		return -ENOMEM;
+	}
+	table->free_bitmap = free_bitmap;
+
+	for (int slot = table->capacity; slot < capacity; slot++)
+	{
+		table->files[slot] = NULL;
+		fd_table_mark(table, slot, 1);
+	}
+
+	table->capacity = capacity;
+	return 0;
+}
+
+int fd_table_init(struct fd_table *table, int capacity)
+{
+	memset(table, 0, sizeof(struct fd_table));
+	int res = fd_table_grow(table, capacity);
+	if (res < 0)
+	{
+		fd_table_free(table);
+	}
+
+	return res;
+}
+
+// drops the table's reference to every open file
+void fd_table_free(struct fd_table *table)
+{
+	for (int slot = 0; slot < table->capacity; slot++)
+	{
+		if (table->files[slot])
+		{
+			file_put(table->files[slot]);
+		}
+	}
+
+	kfree(table->files);
+	kfree(table->free_bitmap);
+	memset(table, 0, sizeof(struct fd_table));
+}
+
+// lowest free descriptor, a word at a time so a full table costs one compare per 32 slots
+static int fd_table_find_free(struct fd_table *table)
+{
+	for (int word = 0; word < table->capacity / 32; word++)
+	{
+		if (table->free_bitmap[word])
+		{
+			return word * 32 + __builtin_ctz(table->free_bitmap[word]);
+		}
+	}
+
+	return -1;
+}
+
+// takes over the caller's reference, returns the descriptor number
+int fd_table_install(struct fd_table *table, struct file_descriptor *desc)
+{
+	int slot = fd_table_find_free(table);
+	if (slot < 0)
+	{
+		slot = table->capacity;
+		int res = fd_table_grow(table, table->capacity ? table->capacity * 2 : MYOS_FD_TABLE_INITIAL);
+		if (res < 0)
+		{
+			return res;
+		}
+	}
+
+	table->files[slot] = desc;
+	fd_table_mark(table, slot, 0);
+
+	// descriptors start at 1
+	return slot + 1;
+}
+
+struct file_descriptor *fd_table_get(struct fd_table *table, int fd)
+{
+	if (fd <= 0 || fd > table->capacity)
+	{
+		return NULL;
+	}
+
+	return table->files[fd - 1];
+}
+
+// the caller gets the table's reference and must put it
+struct file_descriptor *fd_table_remove(struct fd_table *table, int fd)
+{
+	struct file_descriptor *desc = fd_table_get(table, fd);
+	if (!desc)
+	{
+		return NULL;
+	}
+
+	table->files[fd - 1] = NULL;
+	fd_table_mark(table, fd - 1, 1);
+	return desc;
+}
+
+// second descriptor for the same open file, both share the position
+int fd_table_dup(struct fd_table *table, int fd)
+{
+	struct file_descriptor *desc = fd_table_get(table, fd);
+	if (!desc)
+	{
+		return -EINVARG;
+	}
+
+	int res = fd_table_install(table, file_get(desc));
+	if (res < 0)
+	{
+		file_put(desc);
+	}
+
+	return res;
+}
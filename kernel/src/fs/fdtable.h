@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+struct file_descriptor;
+
+// descriptor numbers index straight into files, fd zero is never handed out
+struct fd_table
+{
+	struct file_descriptor **files;
+
+	// one bit per slot, set when the slot is free
+	uint32_t *free_bitmap;
+	int capacity;
+};
+
+int fd_table_init(struct fd_table *table, int capacity);
+void fd_table_free(struct fd_table *table);
+int fd_table_install(struct fd_table *table, struct file_descriptor *desc);
+struct file_descriptor *fd_table_get(struct fd_table *table, int fd);
+struct file_descriptor *fd_table_remove(struct fd_table *table, int fd);
+int fd_table_dup(struct fd_table *table, int fd);
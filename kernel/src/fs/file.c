@@ -5,11 +5,17 @@
 #include "string/string.h"
 #include "disk/disk.h"
 #include "fat/fat16.h"
+#include "fat/fat32.h"
+#include "dentry.h"
+#include "fdtable.h"
+#include "pagecache.h"
 #include "status.h"
 #include "kernel.h"
 
 struct filesystem *filesystems[MYOS_MAX_FILESYSTEMS];
-struct file_descriptor *file_descriptors[MYOS_MAX_FILE_DESCRIPTORS];
+
+// descriptors opened by the kernel itself, processes have their own tables
+static struct fd_table kernel_files;
 
 static struct filesystem **fs_get_free_filesystem()
 {
@@ -40,6 +46,7 @@ void fs_insert_filesystem(struct filesystem *filesystem)
 static void fs_static_load()
 {
 	fs_insert_filesystem(fat16_init());
+	fs_insert_filesystem(fat32_init());
 }
 
 void fs_load()
@@ -50,46 +57,14 @@ void fs_load()
 
 void fs_init()
 {
-	memset(file_descriptors, 0, sizeof(file_descriptors));
-	fs_load();
-}
-
-static void file_free_descriptor(struct file_descriptor *desc)
-{
-	file_descriptors[desc->index - 1] = 0x00;
-	kfree(desc);
-}
-
-static int file_new_descriptor(struct file_descriptor **desc_out)
-{
-	int res = -ENOMEM;
-	for (int i = 0; i < MYOS_MAX_FILE_DESCRIPTORS; i++)
+	if (fd_table_init(&kernel_files, MYOS_FD_TABLE_INITIAL) < 0)
 	{
-		if (file_descriptors[i] == 0)
-		{
-			struct file_descriptor *desc = kzalloc(sizeof(struct file_descriptor));
-			// Descriptors start at 1
-			desc->index = i + 1;
-			file_descriptors[i] = desc;
-			*desc_out = desc;
-			res = 0;
-			break;
-		}
+		panic("fs_init: Failed to allocate the kernel descriptor table");
 	}
 
-	return res;
-}
-
-static struct file_descriptor *file_get_descriptor(int fd)
-{
-	if (fd <= 0 || fd >= MYOS_MAX_FILE_DESCRIPTORS)
-	{
-		return 0;
-	}
-
-	// Descriptors start at 1
-	int index = fd - 1;
-	return file_descriptors[index];
+	dentry_cache_init();
+	page_cache_init();
+	fs_load();
 }
 
 struct filesystem *fs_resolve(struct disk *disk)
@@ -124,11 +99,13 @@ FILE_MODE file_get_mode_by_string(const char *str)
 	return mode;
 }
 
-int fopen(const char *filename, const char *mode_str)
+struct file_descriptor *file_open(const char *filename, const char *mode_str)
 {
 	int res = 0;
-	struct path_root *root_path = pathparser_parse(filename, NULL);
-	if (!root_path)
+	struct file_descriptor *desc = NULL;
+	struct path_buffer path;
+	struct path_root *root_path = &path.root;
+	if (pathparser_parse(filename, NULL, &path) < 0)
 	{
 		res = -EINVARG;
 		goto out;
@@ -162,101 +139,357 @@ int fopen(const char *filename, const char *mode_str)
 		goto out;
 	}
 
-	void *descriptor_private_data = disk->filesystem->open(disk, root_path->first, mode);
+	void *descriptor_private_data = NULL;
+	void *node = NULL;
+	res = dentry_resolve(disk, root_path->first, &node);
+
+	// writers truncate an existing file, the first cluster it frees may start the next file written
+	// and pages keyed by it must go before they can be found under the new file
+	if (mode == FILE_MODE_WRITE && res != -ENOENT)
+	{
+		page_cache_invalidate_disk(disk);
+	}
+
+	if (res == 0)
+	{
+		descriptor_private_data = disk->filesystem->open_node(disk, node, mode);
+	}
+	else if (res == -EUNIMP || (res == -ENOENT && mode != FILE_MODE_READ))
+	{
+		// the filesystem walks the path itself, creating the file for writers
+		descriptor_private_data = disk->filesystem->open(disk, root_path->first, mode);
+		res = 0;
+	}
+	else
+	{
+		goto out;
+	}
+
 	if (ISERR(descriptor_private_data))
 	{
 		res = ERROR_I(descriptor_private_data);
 		goto out;
 	}
 
-	struct file_descriptor *desc = 0;
-	res = file_new_descriptor(&desc);
-	if (res < 0)
+	desc = kzalloc(sizeof(struct file_descriptor));
+	if (!desc)
 	{
+		disk->filesystem->close(descriptor_private_data);
+		res = -ENOMEM;
 		goto out;
 	}
 
+	desc->refcount = 1;
+	desc->mode = mode;
 	desc->filesystem = disk->filesystem;
 	desc->private = descriptor_private_data;
 	desc->disk = disk;
-	res = desc->index;
 out:
-	// fopen shouldn't return negative values
 	if (res < 0)
-		res = 0;
+	{
+		return ERROR(res);
+	}
+
+	return desc;
+}
+
+struct file_descriptor *file_get(struct file_descriptor *desc)
+{
+	desc->refcount++;
+	return desc;
+}
 
+// closes the file once the last reference is dropped
+int file_put(struct file_descriptor *desc)
+{
+	if (--desc->refcount > 0)
+	{
+		return 0;
+	}
+
+	int res = desc->filesystem->close(desc->private);
+	kfree(desc);
 	return res;
 }
 
-int fstat(int fd, struct file_stat *stat)
+// readers copy out of the page cache, only whole members up to the end of the file are returned
+// writers and filesystems without the cache hooks read straight through the filesystem
+int file_read(struct file_descriptor *desc, void *ptr, uint32_t size, uint32_t nmemb)
+{
+	if (size == 0 || nmemb == 0 || nmemb > UINT32_MAX / size)
+	{
+		return -EINVARG;
+	}
+
+	if (desc->mode == FILE_MODE_READ)
+	{
+		int res = page_cache_read(desc, ptr, size * nmemb, size);
+		if (res != -EUNIMP)
+		{
+			return res < 0 ? res : res / size;
+		}
+	}
+
+	return desc->filesystem->read(desc->disk, desc->private, size, nmemb, (char *)ptr);
+}
+
+int file_write(struct file_descriptor *desc, const void *ptr, uint32_t size, uint32_t nmemb)
+{
+	if (size == 0 || nmemb == 0)
+	{
+		return -EINVARG;
+	}
+
+	if (!desc->filesystem->write)
+	{
+		return -ERDONLY;
+	}
+
+	page_cache_invalidate_file(desc);
+	return desc->filesystem->write(desc->disk, desc->private, size, nmemb, (const char *)ptr);
+}
+
+int file_seek(struct file_descriptor *desc, int offset, FILE_SEEK_MODE whence)
+{
+	return desc->filesystem->seek(desc->private, offset, whence);
+}
+
+int file_tell(struct file_descriptor *desc, uint32_t *pos_out)
+{
+	if (!desc->filesystem->tell)
+	{
+		return -EUNIMP;
+	}
+
+	return desc->filesystem->tell(desc->private, pos_out);
+}
+
+int file_stat(struct file_descriptor *desc, struct file_stat *stat)
+{
+	return desc->filesystem->stat(desc->disk, desc->private, stat);
+}
+
+int file_truncate(struct file_descriptor *desc, uint32_t size)
+{
+	if (!desc->filesystem->truncate)
+	{
+		return -ERDONLY;
+	}
+
+	// the chain is freed from the new end, later pages must not outlive it
+	page_cache_invalidate_file(desc);
+	return desc->filesystem->truncate(desc->disk, desc->private, size);
+}
+
+// reads into each segment in turn from the current position, returns the bytes read
+// which is short when the end of the file is reached
+int file_read_segments(struct file_descriptor *desc, struct file_segment *segments, int total)
 {
 	int res = 0;
-	struct file_descriptor *desc = file_get_descriptor(fd);
-	if (!desc)
+	int total_bytes = 0;
+	for (int i = 0; i < total; i++)
 	{
-		res = -EIO;
-		goto out;
+		res = -EUNIMP;
+		if (desc->mode == FILE_MODE_READ)
+		{
+			res = page_cache_read(desc, segments[i].ptr, segments[i].len, 1);
+		}
+
+		if (res == -EUNIMP)
+		{
+			res = desc->filesystem->read(desc->disk, desc->private, segments[i].len, 1, segments[i].ptr);
+			if (res > 0)
+			{
+				res = segments[i].len;
+			}
+		}
+
+		if (res < 0)
+		{
+			return res;
+		}
+
+		total_bytes += res;
+		if (res < segments[i].len)
+		{
+			break;
+		}
 	}
 
-	res = desc->filesystem->stat(desc->disk, desc->private, stat);
+	return total_bytes;
+}
+
+int file_write_segments(struct file_descriptor *desc, struct file_segment *segments, int total)
+{
+	int res = 0;
+	int total_bytes = 0;
+	for (int i = 0; i < total; i++)
+	{
+		res = file_write(desc, segments[i].ptr, segments[i].len, 1);
+		if (res < 0)
+		{
+			return res;
+		}
+
+		total_bytes += segments[i].len;
+	}
+
+	return total_bytes;
+}
+
+int fopen(const char *filename, const char *mode_str)
+{
+	struct file_descriptor *desc = file_open(filename, mode_str);
+	if (ISERR(desc))
+	{
+		// fopen shouldn't return negative values
+		return 0;
+	}
+
+	int res = fd_table_install(&kernel_files, desc);
+	if (res < 0)
+	{
+		file_put(desc);
+		return 0;
+	}
 
-out:
 	return res;
 }
 
-int fclose(int fd)
+
+
+int fstat(int fd, struct file_stat *stat)
 {
-	int res = 0;
-	struct file_descriptor *desc = file_get_descriptor(fd);
+	struct file_descriptor *desc = fd_table_get(&kernel_files, fd);
 	if (!desc)
 	{
-		res = -EIO;
-		goto out;
+		return -EIO;
 	}
 
-	res = desc->filesystem->close(desc->private);
-	if (res == MYOS_ALL_OK)
+	return file_stat(desc, stat);
+}
+
+int fclose(int fd)
+{
+	struct file_descriptor *desc = fd_table_remove(&kernel_files, fd);
+	if (!desc)
 	{
-		file_free_descriptor(desc);
+		return -EIO;
 	}
 
-out:
-	return res;
+	return file_put(desc);
 }
 
 int fseek(int fd, int offset, FILE_SEEK_MODE whence)
 {
-	int res = 0;
-	struct file_descriptor *desc = file_get_descriptor(fd);
+	struct file_descriptor *desc = fd_table_get(&kernel_files, fd);
 	if (!desc)
+	{
+		return -EIO;
+	}
+
+	return file_seek(desc, offset, whence);
+}
+
+int fread(void *ptr, uint32_t size, uint32_t nmemb, int fd)
+{
+	struct file_descriptor *desc = fd_table_get(&kernel_files, fd);
+	if (!desc)
+	{
+		return -EINVARG;
+	}
+
+	return file_read(desc, ptr, size, nmemb);
+}
+
+int fwrite(const void *ptr, uint32_t size, uint32_t nmemb, int fd)
+{
+	struct file_descriptor *desc = fd_table_get(&kernel_files, fd);
+	if (!desc)
+	{
+		return -EINVARG;
+	}
+
+	return file_write(desc, ptr, size, nmemb);
+}
+
+int ftruncate(int fd, uint32_t size)
+{
+	struct file_descriptor *desc = fd_table_get(&kernel_files, fd);
+	if (!desc)
+	{
+		return -EINVARG;
+	}
+
+	return file_truncate(desc, size);
+}
+
+int funlink(const char *filename)
+{
+	int res = 0;
+	struct path_buffer path;
+	struct path_root *root_path = &path.root;
+	if (pathparser_parse(filename, NULL, &path) < 0 || !root_path->first)
+	{
+		res = -EINVARG;
+		goto out;
+	}
+
+	struct disk *disk = disk_get(root_path->drive_no);
+	if (!disk || !disk->filesystem)
 	{
 		res = -EIO;
 		goto out;
 	}
 
-	res = desc->filesystem->seek(desc->private, offset, whence);
+	if (!disk->filesystem->unlink)
+	{
+		res = -ERDONLY;
+		goto out;
+	}
 
+	page_cache_invalidate_disk(disk);
+	res = disk->filesystem->unlink(disk, root_path->first);
 out:
 	return res;
 }
 
-int fread(void *ptr, uint32_t size, uint32_t nmemb, int fd)
+// directories are resolved through the dentry cache, whose nodes keep their entries loaded
+int file_readdir(const char *path, uint32_t *cursor, struct file_dirent *out, int max)
 {
 	int res = 0;
-	if (size == 0 || nmemb == 0 || fd < 1)
+	struct path_buffer path_buf;
+	if (pathparser_parse(path, NULL, &path_buf) < 0)
 	{
 		res = -EINVARG;
 		goto out;
 	}
 
-	struct file_descriptor *desc = file_get_descriptor(fd);
-	if (!desc)
+	struct disk *disk = disk_get(path_buf.root.drive_no);
+	if (!disk || !disk->filesystem)
 	{
-		res = -EINVARG;
+		res = -EIO;
+		goto out;
+	}
+
+	if (!disk->filesystem->readdir)
+	{
+		res = -EUNIMP;
 		goto out;
 	}
 
-	res = desc->filesystem->read(desc->disk, desc->private, size, nmemb, (char *)ptr);
+	// the drive itself names the root directory
+	void *node = NULL;
+	if (path_buf.root.first)
+	{
+		res = dentry_resolve(disk, path_buf.root.first, &node);
+		if (res < 0)
+		{
+			goto out;
+		}
+	}
+
+	res = disk->filesystem->readdir(disk, node, cursor, out, max);
 out:
 	return res;
 }
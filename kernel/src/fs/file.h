@@ -33,6 +33,34 @@ struct file_stat
 	uint32_t filesize;
 };
 
+typedef unsigned int FILE_ATTRIBUTES;
+enum
+{
+	FILE_ATTRIBUTE_DIRECTORY = 0b00000001,
+	FILE_ATTRIBUTE_READ_ONLY = 0b00000010,
+	FILE_ATTRIBUTE_HIDDEN = 0b00000100,
+	FILE_ATTRIBUTE_SYSTEM = 0b00001000,
+};
+
+#define FILE_DIRENT_NAME_MAX 16
+
+// directory entry as returned by readdir, mirrored in programs/stdlib/src/file.h
+struct file_dirent
+{
+	char name[FILE_DIRENT_NAME_MAX];
+	uint32_t size;
+	FILE_ATTRIBUTES attributes;
+	uint32_t first_cluster;
+	uint32_t reserved;
+};
+
+// one piece of a scattered buffer
+struct file_segment
+{
+	void *ptr;
+	uint32_t len;
+};
+
 struct disk;
 typedef void *(*FS_OPEN_FUNCTION)(struct disk *disk, struct path_part *path, FILE_MODE mode);
 typedef int (*FS_READ_FUNCTION)(struct disk *disk, void *private, uint32_t size, uint32_t nmemb, char *out);
@@ -42,6 +70,30 @@ typedef int (*FS_SEEK_FUNCTION)(void *private, uint32_t offset, FILE_SEEK_MODE s
 typedef int (*FS_STAT_FUNCTION)(struct disk *disk, void *private, struct file_stat *stat);
 typedef int (*FS_VOLUME_NAME_FUNCTION)(void *private, char *out_name, size_t max);
 
+// optional node interface, filesystems that provide it get their path walks cached by the dentry cache
+// a NULL parent is the root directory, a missing name must return -ENOENT so it can be cached as negative
+// name is a view of len bytes into the path being opened and is not null terminated
+typedef int (*FS_LOOKUP_FUNCTION)(struct disk *disk, void *parent, const char *name, int len, void **node_out);
+typedef void *(*FS_OPEN_NODE_FUNCTION)(struct disk *disk, void *node, FILE_MODE mode);
+typedef void (*FS_RELEASE_NODE_FUNCTION)(void *node);
+
+// optional, filesystems without them are read-only
+typedef int (*FS_WRITE_FUNCTION)(struct disk *disk, void *private, uint32_t size, uint32_t nmemb, const char *in);
+typedef int (*FS_TRUNCATE_FUNCTION)(struct disk *disk, void *private, uint32_t size);
+typedef int (*FS_UNLINK_FUNCTION)(struct disk *disk, struct path_part *path);
+
+// optional, lists a directory node from the lookup hook, NULL for the root directory
+// fills up to max entries starting at cursor and moves it past them, returns zero at the end
+typedef int (*FS_READDIR_FUNCTION)(struct disk *disk, void *node, uint32_t *cursor, struct file_dirent *out, int max);
+
+// optional, lets the page cache share file data between descriptors and processes
+// the id names the file's data on its disk and is zero while it has none, read_at leaves the position alone
+typedef int (*FS_FILE_ID_FUNCTION)(void *private, uint32_t *id_out);
+typedef int (*FS_READ_AT_FUNCTION)(struct disk *disk, void *private, uint32_t offset, uint32_t size, char *out);
+
+// optional, with it reads on read only descriptors are served from the page cache
+typedef int (*FS_TELL_FUNCTION)(void *private, uint32_t *pos_out);
+
 struct filesystem
 {
 	// Filesystem should return zero from resolve if the provided disk is using its filesystem
@@ -52,14 +104,25 @@ struct filesystem
 	FS_STAT_FUNCTION stat;
 	FS_CLOSE_FUNCTION close;
 	FS_VOLUME_NAME_FUNCTION volume_name;
+	FS_LOOKUP_FUNCTION lookup;
+	FS_OPEN_NODE_FUNCTION open_node;
+	FS_RELEASE_NODE_FUNCTION release_node;
+	FS_WRITE_FUNCTION write;
+	FS_TRUNCATE_FUNCTION truncate;
+	FS_UNLINK_FUNCTION unlink;
+	FS_READDIR_FUNCTION readdir;
+	FS_FILE_ID_FUNCTION file_id;
+	FS_READ_AT_FUNCTION read_at;
+	FS_TELL_FUNCTION tell;
 
 	char name[20];
 };
 
+// open file, shared by every descriptor that refers to it and closed when the last one goes
 struct file_descriptor
 {
-	// Descriptor index
-	int index;
+	int refcount;
+	FILE_MODE mode;
 	struct filesystem *filesystem;
 
 	// Private data for internal file descriptor
@@ -70,10 +133,29 @@ struct file_descriptor
 };
 
 void fs_init();
+
+// open file objects, file_open returns one holding a single reference
+struct file_descriptor *file_open(const char *filename, const char *mode_str);
+struct file_descriptor *file_get(struct file_descriptor *desc);
+int file_put(struct file_descriptor *desc);
+int file_read(struct file_descriptor *desc, void *ptr, uint32_t size, uint32_t nmemb);
+int file_write(struct file_descriptor *desc, const void *ptr, uint32_t size, uint32_t nmemb);
+int file_seek(struct file_descriptor *desc, int offset, FILE_SEEK_MODE whence);
+int file_tell(struct file_descriptor *desc, uint32_t *pos_out);
+int file_stat(struct file_descriptor *desc, struct file_stat *stat);
+int file_truncate(struct file_descriptor *desc, uint32_t size);
+int file_read_segments(struct file_descriptor *desc, struct file_segment *segments, int total);
+int file_write_segments(struct file_descriptor *desc, struct file_segment *segments, int total);
+
+// descriptor numbers in the kernel's own table
 int fopen(const char *filename, const char *mode_str);
 int fclose(int fd);
 int fseek(int fd, int offset, FILE_SEEK_MODE whence);
 int fread(void *ptr, uint32_t size, uint32_t nmemb, int fd);
 int fstat(int fd, struct file_stat *stat);
+int fwrite(const void *ptr, uint32_t size, uint32_t nmemb, int fd);
+int ftruncate(int fd, uint32_t size);
+int funlink(const char *filename);
+int file_readdir(const char *path, uint32_t *cursor, struct file_dirent *out, int max);
 void fs_insert_filesystem(struct filesystem *filesystem);
 struct filesystem *fs_resolve(struct disk *disk);
@@ -0,0 +1,452 @@
+#include "pagecache.h"
+#include "file.h"
+#include "memory/memory.h"
+#include "memory/heap/kheap.h"
+#include "memory/paging/paging.h"
+#include "kernel.h"
+#include "status.h"
+
+static struct page_cache page_cache;
+
+static void page_cache_detach(struct page_cache_page *page);
+
+void page_cache_init()
+{
+	memset(&page_cache, 0, sizeof(page_cache));
+}
+
+static uint32_t page_cache_hash(struct disk *disk, uint32_t file_id, uint32_t index)
+{
+	uint32_t hash = (uint32_t)(uintptr_t)disk * 2654435761u;
+	hash ^= file_id * 2246822519u;
+	hash ^= index * 3266489917u;
+	return hash % MYOS_PAGE_CACHE_BUCKETS;
+}
+
+static struct page_cache_page *page_cache_find(struct disk *disk, uint32_t file_id, uint32_t index)
+{
+	for (struct page_cache_page *page = page_cache.buckets[page_cache_hash(disk, file_id, index)]; page; page = page->hash_next)
+	{
+		if (page->disk == disk && page->file_id == file_id && page->index == index)
+		{
+			return page;
+		}
+	}
+
+	return NULL;
+}
+
+static void page_cache_lru_unlink(struct page_cache_page *page)
+{
+	if (page->lru_prev)
+	{
+		page->lru_prev->lru_next = page->lru_next;
+	}
+	else
+	{
+		page_cache.lru_head = page->lru_next;
+	}
+
+	if (page->lru_next)
+	{
+		page->lru_next->lru_prev = page->lru_prev;
+	}
+	else
+	{
+		page_cache.lru_tail = page->lru_prev;
+	}
+
+	page->lru_prev = NULL;
+	page->lru_next = NULL;
+}
+
+static void page_cache_lru_push(struct page_cache_page *page)
+{
+	page->lru_prev = NULL;
+	page->lru_next = page_cache.lru_head;
+	if (page_cache.lru_head)
+	{
+		page_cache.lru_head->lru_prev = page;
+	}
+	else
+	{
+		page_cache.lru_tail = page;
+	}
+
+	page_cache.lru_head = page;
+}
+
+static void page_cache_free_page(struct page_cache_page *page)
+{
+	kfree(page->data);
+	kfree(page);
+	page_cache.total_pages--;
+}
+
+static void page_cache_unlink(struct page_cache_page *page)
+{
+	struct page_cache_page **link = &page_cache.buckets[page_cache_hash(page->disk, page->file_id, page->index)];
+	while (*link && *link != page)
+	{
+		link = &(*link)->hash_next;
+	}
+
+	if (*link)
+	{
+		*link = page->hash_next;
+	}
+
+	page->hash_next = NULL;
+}
+
+// drops the least recently used unreferenced page, false when every page is in use
+static bool page_cache_evict()
+{
+	struct page_cache_page *page = page_cache.lru_tail;
+	if (!page)
+	{
+		return false;
+	}
+
+	page_cache_lru_unlink(page);
+	page_cache_unlink(page);
+	page_cache_free_page(page);
+	return true;
+}
+
+// a new page, making room first when the cache is full and evicting further while the heap is out of memory
+static struct page_cache_page *page_cache_alloc_page()
+{
+	while (page_cache.total_pages >= MYOS_PAGE_CACHE_MAX_PAGES && page_cache_evict())
+	{
+	}
+
+	struct page_cache_page *page = NULL;
+	while (!(page = kzalloc(sizeof(struct page_cache_page))) || !(page->data = kzalloc(PAGING_PAGE_SIZE)))
+	{
+		kfree(page);
+		page = NULL;
+		if (!page_cache_evict())
+		{
+			return NULL;
+		}
+	}
+
+	page_cache.total_pages++;
+	return page;
+}
+
+static int page_cache_file_id(struct file_descriptor *desc, uint32_t *file_id_out)
+{
+	if (!desc->filesystem->file_id || !desc->filesystem->read_at)
+	{
+		return -EUNIMP;
+	}
+
+	int res = desc->filesystem->file_id(desc->private, file_id_out);
+	if (res < 0)
+	{
+		return res;
+	}
+
+	// files without data have nothing to cache
+	return *file_id_out ? 0 : -EOUTOFRANGE;
+}
+
+// bytes of file data a page holds, 0 for pages past the end of the file
+static uint32_t page_cache_valid_bytes(uint32_t index, uint32_t filesize)
+{
+	uint32_t offset = index * PAGING_PAGE_SIZE;
+	if (offset >= filesize)
+	{
+		return 0;
+	}
+
+	return filesize - offset < PAGING_PAGE_SIZE ? filesize - offset : PAGING_PAGE_SIZE;
+}
+
+static struct page_cache_page *page_cache_fill(struct file_descriptor *desc, uint32_t file_id, uint32_t index, uint32_t filesize)
+{
+	int res = 0;
+	uint32_t offset = index * PAGING_PAGE_SIZE;
+	if (offset >= filesize)
+	{
+		return ERROR(-EOUTOFRANGE);
+	}
+
+	struct page_cache_page *page = page_cache_alloc_page();
+	if (!page)
+	{
+		return ERROR(-ENOMEM);
+	}
+
+	page->disk = desc->disk;
+	page->file_id = file_id;
+	page->index = index;
+	page->valid = page_cache_valid_bytes(index, filesize);
+	res = desc->filesystem->read_at(desc->disk, desc->private, offset, page->valid, page->data);
+	if (res < 0)
+	{
+		page_cache_free_page(page);
+		return ERROR(res);
+	}
+
+	uint32_t bucket = page_cache_hash(page->disk, file_id, index);
+	page->hash_next = page_cache.buckets[bucket];
+	page_cache.buckets[bucket] = page;
+	return page;
+}
+
+// fills pages behind a miss, the window doubles while misses keep landing where the last one ended
+static void page_cache_readahead(struct file_descriptor *desc, uint32_t file_id, uint32_t index, uint32_t filesize)
+{
+	bool sequential = page_cache.readahead_disk == desc->disk && page_cache.readahead_file_id == file_id && page_cache.readahead_next == index;
+	uint32_t pages = MYOS_PAGE_CACHE_READAHEAD_MIN_PAGES;
+	if (sequential)
+	{
+		pages = page_cache.readahead_pages * 2;
+		if (pages > MYOS_PAGE_CACHE_READAHEAD_MAX_PAGES)
+		{
+			pages = MYOS_PAGE_CACHE_READAHEAD_MAX_PAGES;
+		}
+	}
+
+	page_cache.readahead_disk = desc->disk;
+	page_cache.readahead_file_id = file_id;
+	page_cache.readahead_pages = pages;
+	page_cache.readahead_next = index + 1;
+	for (uint32_t i = index + 1; i < index + pages; i++)
+	{
+		if (page_cache_find(desc->disk, file_id, i))
+		{
+			break;
+		}
+
+		// never push out pages to make room for a guess
+		if (page_cache.total_pages >= MYOS_PAGE_CACHE_MAX_PAGES)
+		{
+			break;
+		}
+
+		struct page_cache_page *page = page_cache_fill(desc, file_id, i, filesize);
+		if (ISERR(page))
+		{
+			break;
+		}
+
+		// read ahead pages are unreferenced, the oldest end of the list keeps them from evicting useful pages
+		if (page_cache.lru_tail)
+		{
+			page->lru_prev = page_cache.lru_tail;
+			page_cache.lru_tail->lru_next = page;
+			page_cache.lru_tail = page;
+		}
+		else
+		{
+			page_cache_lru_push(page);
+		}
+
+		page_cache.readahead_next = i + 1;
+	}
+}
+
+// returns a referenced page of the file, read through the filesystem on a miss
+struct page_cache_page *page_cache_get(struct file_descriptor *desc, uint32_t index)
+{
+	uint32_t file_id = 0;
+	int res = page_cache_file_id(desc, &file_id);
+	if (res < 0)
+	{
+		return ERROR(res);
+	}
+
+	struct file_stat stat;
+	res = file_stat(desc, &stat);
+	if (res < 0)
+	{
+		return ERROR(res);
+	}
+
+	struct page_cache_page *page = page_cache_find(desc->disk, file_id, index);
+	if (page && page->valid != page_cache_valid_bytes(index, stat.filesize))
+	{
+		// a length that disagrees with the file means the page was cached for an older file at the same cluster, it must
+		// not be handed to fread or shared into a new mapping
+		page_cache_detach(page);
+		page = NULL;
+	}
+
+	if (page)
+	{
+		if (page->refcount == 0)
+		{
+			page_cache_lru_unlink(page);
+		}
+
+		page->refcount++;
+		return page;
+	}
+
+	page = page_cache_fill(desc, file_id, index, stat.filesize);
+	if (ISERR(page))
+	{
+		return page;
+	}
+
+	page->refcount++;
+	page_cache_readahead(desc, file_id, index, stat.filesize);
+	return page;
+}
+
+// the page stays cached once unreferenced, detached pages are freed
+void page_cache_put(struct page_cache_page *page)
+{
+	if (--page->refcount > 0)
+	{
+		return;
+	}
+
+	if (page->detached)
+	{
+		page_cache_free_page(page);
+		return;
+	}
+
+	page_cache_lru_push(page);
+}
+
+// copies from the current position through the cache and moves the position past it, a read of
+// at most total bytes that stops at the end of the file on a multiple of unit, returns the bytes read
+int page_cache_read(struct file_descriptor *desc, void *out, uint32_t total, uint32_t unit)
+{
+	int res = 0;
+	uint32_t pos = 0;
+	if (!desc->filesystem->tell || !desc->filesystem->file_id || !desc->filesystem->read_at)
+	{
+		return -EUNIMP;
+	}
+
+	res = desc->filesystem->tell(desc->private, &pos);
+	if (res < 0)
+	{
+		return res;
+	}
+
+	struct file_stat stat;
+	res = file_stat(desc, &stat);
+	if (res < 0)
+	{
+		return res;
+	}
+
+	if (pos >= stat.filesize)
+	{
+		return 0;
+	}
+
+	if (total > stat.filesize - pos)
+	{
+		total = (stat.filesize - pos) / unit * unit;
+	}
+
+	char *out_ptr = out;
+	uint32_t done = 0;
+	while (done < total)
+	{
+		uint32_t offset = pos + done;
+		struct page_cache_page *page = page_cache_get(desc, offset / PAGING_PAGE_SIZE);
+		if (ISERR(page))
+		{
+			return ERROR_I(page);
+		}
+
+		uint32_t in_page = offset % PAGING_PAGE_SIZE;
+		uint32_t len = PAGING_PAGE_SIZE - in_page;
+		if (len > total - done)
+		{
+			len = total - done;
+		}
+
+		memcpy(out_ptr + done, (char *)page->data + in_page, len);
+		page_cache_put(page);
+		done += len;
+	}
+
+	res = desc->filesystem->seek(desc->private, pos + done, SEEK_SET);
+	if (res < 0)
+	{
+		return res;
+	}
+
+	return done;
+}
+
+static void page_cache_detach(struct page_cache_page *page)
+{
+	page_cache_unlink(page);
+	page->detached = true;
+	if (page->refcount == 0)
+	{
+		page_cache_lru_unlink(page);
+		page_cache_free_page(page);
+	}
+}
+
+// called before a file changes, existing mappings keep the data they have and later gets read it again
+void page_cache_invalidate_file(struct file_descriptor *desc)
+{
+	uint32_t file_id = 0;
+	if (!page_cache.total_pages || page_cache_file_id(desc, &file_id) < 0)
+	{
+		return;
+	}
+
+	for (int i = 0; i < MYOS_PAGE_CACHE_BUCKETS; i++)
+	{
+		struct page_cache_page *page = page_cache.buckets[i];
+		while (page)
+		{
+			struct page_cache_page *next = page->hash_next;
+			if (page->disk == desc->disk && page->file_id == file_id)
+			{
+				page_cache_detach(page);
+			}
+
+			page = next;
+		}
+	}
+
+	if (page_cache.readahead_disk == desc->disk && page_cache.readahead_file_id == file_id)
+	{
+		page_cache.readahead_disk = NULL;
+	}
+}
+
+// unlinking frees clusters that a new file may start at, so every page of the disk goes
+void page_cache_invalidate_disk(struct disk *disk)
+{
+	if (!page_cache.total_pages)
+	{
+		return;
+	}
+
+	for (int i = 0; i < MYOS_PAGE_CACHE_BUCKETS; i++)
+	{
+		struct page_cache_page *page = page_cache.buckets[i];
+		while (page)
+		{
+			struct page_cache_page *next = page->hash_next;
+			if (page->disk == disk)
+			{
+				page_cache_detach(page);
+			}
+
+			page = next;
+		}
+	}
+
+	if (page_cache.readahead_disk == disk)
+	{
+		page_cache.readahead_disk = NULL;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "config.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+struct disk;
+struct file_descriptor;
+
+// one page of a file's data, shared by every mapping of that page and copied out of by fread
+struct page_cache_page
+{
+	struct disk *disk;
+	uint32_t file_id; // from the filesystem file_id hook
+	uint32_t index;	  // page of the file
+
+	// PAGING_PAGE_SIZE bytes, page aligned so it can be mapped into processes
+	void *data;
+	uint32_t valid; // bytes of file data, the rest of the page is zero
+
+	int refcount;
+	bool detached; // dropped from the index because the file changed, freed with the last reference
+
+	struct page_cache_page *hash_next;
+
+	// unreferenced pages stay cached on the LRU list until they are evicted
+	struct page_cache_page *lru_prev;
+	struct page_cache_page *lru_next;
+};
+
+struct page_cache
+{
+	struct page_cache_page *buckets[MYOS_PAGE_CACHE_BUCKETS];
+	uint32_t total_pages;
+
+	// most recently used first, only pages nobody references
+	struct page_cache_page *lru_head;
+	struct page_cache_page *lru_tail;
+
+	// misses that continue where the last read-ahead stopped grow the window
+	struct disk *readahead_disk;
+	uint32_t readahead_file_id;
+	uint32_t readahead_next;
+	uint32_t readahead_pages;
+};
+
+void page_cache_init();
+struct page_cache_page *page_cache_get(struct file_descriptor *desc, uint32_t index);
+void page_cache_put(struct page_cache_page *page);
+int page_cache_read(struct file_descriptor *desc, void *out, uint32_t total, uint32_t unit);
+void page_cache_invalidate_file(struct file_descriptor *desc);
+void page_cache_invalidate_disk(struct disk *disk);
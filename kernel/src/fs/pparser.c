@@ -1,7 +1,6 @@
 #include "pparser.h"
 #include "kernel.h"
 #include "string/string.h"
-#include "memory/heap/kheap.h"
 #include "memory/memory.h"
 #include "disk/disk.h"
 #include "status.h"
@@ -37,97 +36,33 @@ static int pathparser_get_drive_by_path(const char **path)
 	return drive_no;
 }
 
-static struct path_root *pathparser_create_root(int drive_number)
+// returns the length of the next component and moves path past it, empty components are skipped
+static int pathparser_get_path_part(const char **path, const char **part_out)
 {
-	struct path_root *path_r = kzalloc(sizeof(struct path_root));
-	if (!path_r)
+	while (**path == '/')
 	{
-		return NULL;
-	}
-
-	path_r->drive_no = drive_number;
-	path_r->first = 0;
-	return path_r;
-}
-
-static const char *pathparser_get_path_part(const char **path)
-{
-	char *result_path_part = kzalloc(MYOS_MAX_PATH);
-	if (!result_path_part)
-	{
-		return NULL;
-	}
-
-	int i = 0;
-	while (**path != '/' && **path != 0x00)
-	{
-		result_path_part[i] = **path;
 		*path += 1;
-		i++;
 	}
 
-	if (**path == '/')
+	*part_out = *path;
+	int len = 0;
+	while (**path != '/' && **path != 0x00)
 	{
-		// skip forward slash to avoid problems
 		*path += 1;
+		len++;
 	}
 
-	if (i == 0)
-	{
-		kfree(result_path_part);
-		result_path_part = 0;
-	}
-
-	return result_path_part;
+	return len;
 }
 
-struct path_part *pathparser_parse_path_part(struct path_part *last_part, const char **path)
-{
-	const char *path_part_str = pathparser_get_path_part(path);
-	if (!path_part_str)
-	{
-		return NULL;
-	}
-
-	struct path_part *part = kzalloc(sizeof(struct path_part));
-	if (!part)
-	{
-		kfree((void *)path_part_str);
-		return NULL;
-	}
-
-	part->part = path_part_str;
-	part->next = 0x00;
-
-	if (last_part)
-	{
-		last_part->next = part;
-	}
-
-	return part;
-}
-
-void pathparser_free(struct path_root *root)
-{
-	struct path_part *part = root->first;
-	while (part)
-	{
-		struct path_part *next_part = part->next;
-		kfree((void *)part->part);
-		kfree(part);
-		part = next_part;
-	}
-
-	kfree(root);
-}
-
-struct path_root *pathparser_parse(const char *path, const char *current_directory_path)
+// fills buffer with views into path, the root has no parts when the path names the drive itself
+int pathparser_parse(const char *path, const char *current_directory_path, struct path_buffer *buffer)
 {
 	int res = 0;
 	const char *tmp_path = path;
-	struct path_root *path_root = 0;
+	memset(buffer, 0, sizeof(struct path_root));
 
-	if (strlen(path) > MYOS_MAX_PATH)
+	if (strnlen(path, MYOS_MAX_PATH + 1) > MYOS_MAX_PATH)
 	{
 		res = -EBADPATH;
 		goto out;
@@ -140,35 +75,31 @@ struct path_root *pathparser_parse(const char *path, const char *current_directo
 		goto out;
 	}
 
-	path_root = pathparser_create_root(res);
-	if (!path_root)
-	{
-		res = -ENOMEM;
-		goto out;
-	}
+	buffer->root.drive_no = res;
+	res = 0;
 
-	struct path_part *first_part = pathparser_parse_path_part(NULL, &tmp_path);
-	if (!first_part)
+	struct path_part **link = &buffer->root.first;
+	int total = 0;
+	const char *part_str = NULL;
+	int len = pathparser_get_path_part(&tmp_path, &part_str);
+	while (len > 0)
 	{
-		res = -ENOMEM;
-		goto out;
-	}
+		if (total == MYOS_PATH_MAX_PARTS)
+		{
+			res = -EBADPATH;
+			goto out;
+		}
 
-	path_root->first = first_part;
-	struct path_part *part = pathparser_parse_path_part(first_part, &tmp_path);
-	while (part)
-	{
-		part = pathparser_parse_path_part(part, &tmp_path);
+		struct path_part *part = &buffer->parts[total++];
+		part->part = part_str;
+		part->len = len;
+		part->next = NULL;
+		*link = part;
+		link = &part->next;
+
+		len = pathparser_get_path_part(&tmp_path, &part_str);
 	}
 
 out:
-	if (res < 0)
-	{
-		if (path_root)
-		{
-			pathparser_free(path_root);
-			path_root = NULL;
-		}
-	}
-	return path_root;
+	return res;
 }
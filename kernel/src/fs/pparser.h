@@ -1,16 +1,27 @@
 #pragma once
 
+#include "config.h"
+
+// component of a parsed path, a view into the original path string that is not null terminated
+struct path_part
+{
+	const char *part;
+	int len;
+	struct path_part *next;
+};
+
 struct path_root
 {
 	int drive_no;
 	struct path_part *first;
 };
 
-struct path_part
+// storage for a parsed path, usually on the caller's stack so parsing never touches the heap
+// the parts point into the path that was parsed, it has to outlive the buffer
+struct path_buffer
 {
-	const char *part;
-	struct path_part *next;
+	struct path_root root;
+	struct path_part parts[MYOS_PATH_MAX_PARTS];
 };
 
-struct path_root *pathparser_parse(const char *path, const char *current_directory_path);
-void pathparser_free(struct path_root *root);
+int pathparser_parse(const char *path, const char *current_directory_path, struct path_buffer *buffer);
@@ -5,6 +5,8 @@
 #include "memory/memory.h"
 #include "mouse/mouse.h"
 #include "lib/vector.h"
+#include "io/tsc.h"
+#include "config.h"
 #include "status.h"
 
 struct graphics_info *loaded_graphics_info = NULL; // loaded from UEFI
@@ -15,7 +17,31 @@ size_t real_framebuffer_width = 0;				   // real framebuffer width
 size_t real_framebuffer_height = 0;				   // real framebuffer height
 size_t real_framebuffer_pixels_per_scanline = 0;   // real framebuffer pixels per scanline
 
-void graphics_redraw_children(struct graphics_info *graphics_info);
+// redraws only record the damaged part of the screen, graphics_present composes
+// each dirty rectangle once through the whole tree and writes it to the framebuffer
+struct graphics_rect
+{
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+};
+
+static struct
+{
+	struct framebuffer_pixel *buffer; // screen sized, rectangles are composed here before they are pushed
+
+	// absolute screen coordinates, no two are worth merging
+	struct graphics_rect damage[MYOS_GRAPHICS_MAX_DAMAGE_RECTS];
+	int total_damage;
+
+	TIME_MICROSECONDS last_present;
+
+	struct graphics_stats stats;
+	TIME_MICROSECONDS second_start;
+	uint64_t second_pixels;
+} compositor;
+
 void graphics_info_children_free(struct graphics_info *graphics_info);
 bool graphics_bounds_check(struct graphics_info *graphics_info, int x, int y);
 
@@ -65,86 +91,223 @@ void graphics_info_recalculate(struct graphics_info *graphics_info)
 	}
 }
 
-void graphics_paste_pixels_to_framebuffer(struct graphics_info *src_info,
-										  uint32_t src_x,
-										  uint32_t src_y,
-										  uint32_t width,
-										  uint32_t height,
-										  uint32_t dst_abs_x,
-										  uint32_t dst_abs_y)
+static uint64_t graphics_rect_area(struct graphics_rect *rect)
+{
+	return (uint64_t)rect->width * rect->height;
+}
+
+static struct graphics_rect graphics_rect_union(struct graphics_rect *a, struct graphics_rect *b)
+{
+	uint32_t left = MIN(a->x, b->x);
+	uint32_t top = MIN(a->y, b->y);
+	uint32_t right = MAX(a->x + a->width, b->x + b->width);
+	uint32_t bottom = MAX(a->y + a->height, b->y + b->height);
+	struct graphics_rect rect = {left, top, right - left, bottom - top};
+	return rect;
+}
+
+// false when the rectangles do not overlap
+static bool graphics_rect_intersect(struct graphics_rect *a, struct graphics_rect *b, struct graphics_rect *out)
+{
+	uint32_t left = MAX(a->x, b->x);
+	uint32_t top = MAX(a->y, b->y);
+	uint32_t right = MIN(a->x + a->width, b->x + b->width);
+	uint32_t bottom = MIN(a->y + a->height, b->y + b->height);
+	if (right <= left || bottom <= top)
+	{
+		return false;
+	}
+
+	out->x = left;
+	out->y = top;
+	out->width = right - left;
+	out->height = bottom - top;
+	return true;
+}
+
+// merging pays off when the union costs no more pixels than pushing both, overlap counted twice
+static bool graphics_damage_should_merge(struct graphics_rect *a, struct graphics_rect *b)
+{
+	struct graphics_rect merged = graphics_rect_union(a, b);
+	return graphics_rect_area(&merged) <= graphics_rect_area(a) + graphics_rect_area(b);
+}
+
+static void graphics_damage_add(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
 {
-	if (!src_info)
+	struct graphics_info *screen = graphics_screen_info();
+	if (!screen || x >= screen->width || y >= screen->height || width == 0 || height == 0)
 	{
 		return;
 	}
 
-	uint32_t src_x_end = src_x + width;
-	uint32_t src_y_end = src_y + height;
-	if (src_x_end > src_info->width)
+	if (width > screen->width - x)
 	{
-		src_x_end = src_info->width;
+		width = screen->width - x;
 	}
 
-	if (src_y_end > src_info->height)
+	if (height > screen->height - y)
 	{
-		src_y_end = src_info->height;
+		height = screen->height - y;
 	}
 
-	// rectangle width and heigh after clipping
-	uint32_t final_w = src_x_end - src_x;
-	uint32_t final_h = src_y_end - src_y;
-	if (final_w == 0 || final_h == 0)
+	// a merged rectangle can become worth merging with another one, start over until none is
+	struct graphics_rect rect = {x, y, width, height};
+	int i = 0;
+	while (i < compositor.total_damage)
 	{
-		return;
+		if (graphics_damage_should_merge(&compositor.damage[i], &rect))
+		{
+			rect = graphics_rect_union(&compositor.damage[i], &rect);
+			compositor.damage[i] = compositor.damage[--compositor.total_damage];
+			i = 0;
+			continue;
+		}
+
+		i++;
 	}
 
-	struct graphics_info *screen = graphics_screen_info();
-	uint32_t screen_w = screen->horizontal_resolution;
-	uint32_t screen_h = screen->vertical_resolution;
-	if (dst_abs_x >= screen_w || dst_abs_y >= screen_h)
+	if (compositor.total_damage < MYOS_GRAPHICS_MAX_DAMAGE_RECTS)
 	{
+		compositor.damage[compositor.total_damage++] = rect;
 		return;
 	}
 
-	uint32_t dst_x_end = dst_abs_x + final_w;
-	uint32_t dst_y_end = dst_abs_y + final_h;
-	if (dst_x_end > screen_w)
+	// out of slots, grow the rectangle that grows the least
+	int best = 0;
+	uint64_t best_growth = UINT64_MAX;
+	for (i = 0; i < compositor.total_damage; i++)
 	{
-		dst_x_end = screen_w;
+		struct graphics_rect merged = graphics_rect_union(&compositor.damage[i], &rect);
+		uint64_t growth = graphics_rect_area(&merged) - graphics_rect_area(&compositor.damage[i]);
+		if (growth < best_growth)
+		{
+			best = i;
+			best_growth = growth;
+		}
 	}
 
-	if (dst_y_end > screen_h)
+	compositor.damage[best] = graphics_rect_union(&compositor.damage[best], &rect);
+}
+
+// copies the part of the graphics inside the rectangle into the compose buffer, then its children
+// in z order so whatever is on top is written last
+static void graphics_compose(struct graphics_info *graphics_info, struct graphics_rect *rect)
+{
+	struct graphics_rect bounds = {graphics_info->starting_x, graphics_info->starting_y, graphics_info->width, graphics_info->height};
+	struct graphics_rect area;
+	if (graphics_info->pixels && graphics_rect_intersect(&bounds, rect, &area))
 	{
-		dst_y_end = screen_h;
+		uint32_t screen_width = graphics_screen_info()->width;
+		struct framebuffer_pixel no_transparency_color = {0};
+		bool has_transparency_key = memcmp(&graphics_info->transparency_key, &no_transparency_color, sizeof(no_transparency_color)) != 0;
+		for (uint32_t y = 0; y < area.height; y++)
+		{
+			struct framebuffer_pixel *src = &graphics_info->pixels[(area.y - bounds.y + y) * graphics_info->width + (area.x - bounds.x)];
+			struct framebuffer_pixel *dst = &compositor.buffer[(area.y + y) * screen_width + area.x];
+			if (!has_transparency_key)
+			{
+				memcpy(dst, src, area.width * sizeof(struct framebuffer_pixel));
+				continue;
+			}
+
+			for (uint32_t x = 0; x < area.width; x++)
+			{
+				if (memcmp(&src[x], &graphics_info->transparency_key, sizeof(struct framebuffer_pixel)) != 0)
+				{
+					dst[x] = src[x];
+				}
+			}
+		}
 	}
 
-	uint32_t clipped_w = dst_x_end - dst_abs_x;
-	uint32_t clipped_h = dst_y_end - dst_abs_y;
-	if (clipped_w == 0 || clipped_h == 0)
+	if (!graphics_info->children)
 	{
 		return;
 	}
 
-	for (uint32_t y = 0; y < clipped_h; y++)
+	size_t total_children = vector_count(graphics_info->children);
+	for (size_t i = 0; i < total_children; i++)
 	{
-		for (uint32_t x = 0; x < clipped_w; x++)
+		struct graphics_info *child = NULL;
+		vector_at(graphics_info->children, i, &child, sizeof(child));
+		if (child)
 		{
-			struct framebuffer_pixel pixel = src_info->pixels[(src_y + y) * src_info->width + (src_x + x)];
+			graphics_compose(child, rect);
+		}
+	}
+}
 
-			// check for transparency
-			struct framebuffer_pixel no_transparency_color = {0};
-			if (memcmp(&src_info->transparency_key, &no_transparency_color, sizeof(no_transparency_color)) != 0)
+static void graphics_stats_roll(TIME_MICROSECONDS now)
+{
+	TIME_MICROSECONDS elapsed = now - compositor.second_start;
+	if (elapsed < 1000000)
+	{
+		return;
+	}
+
+	compositor.stats.pixels_per_second = compositor.second_pixels * 1000000 / elapsed;
+	compositor.second_pixels = 0;
+	compositor.second_start = now;
+}
+
+// pushes every dirty rectangle to the framebuffer, each damaged pixel is written exactly once
+void graphics_present()
+{
+	struct graphics_info *screen = graphics_screen_info();
+	if (!screen || !compositor.buffer)
+	{
+		return;
+	}
+
+	TIME_MICROSECONDS now = tsc_microseconds();
+	compositor.last_present = now;
+	if (compositor.total_damage > 0)
+	{
+		uint64_t pixels = 0;
+		for (int i = 0; i < compositor.total_damage; i++)
+		{
+			struct graphics_rect *rect = &compositor.damage[i];
+			graphics_compose(screen, rect);
+			for (uint32_t y = 0; y < rect->height; y++)
 			{
-				if (memcmp(&pixel, &src_info->transparency_key, sizeof(pixel)) == 0)
-				{
-					continue;
-				}
+				memcpy(&screen->framebuffer[(rect->y + y) * screen->pixels_per_scanline + rect->x],
+					   &compositor.buffer[(rect->y + y) * screen->width + rect->x],
+					   rect->width * sizeof(struct framebuffer_pixel));
 			}
 
-			// write to screen framebuffer
-			screen->framebuffer[(dst_abs_y + y) * screen->pixels_per_scanline + (dst_abs_x + x)] = pixel;
+			pixels += graphics_rect_area(rect);
 		}
+
+		compositor.stats.frames++;
+		compositor.stats.rects += compositor.total_damage;
+		compositor.stats.pixels += pixels;
+		compositor.second_pixels += pixels;
+		compositor.total_damage = 0;
 	}
+
+	graphics_stats_roll(now);
+}
+
+// called on the way back to user space, damage is presented at most once per frame interval
+void graphics_frame()
+{
+	if (compositor.total_damage == 0)
+	{
+		return;
+	}
+
+	if (tsc_microseconds() - compositor.last_present < MYOS_GRAPHICS_FRAME_MICROSECONDS)
+	{
+		return;
+	}
+
+	graphics_present();
+}
+
+void graphics_stats_get(struct graphics_stats *stats_out)
+{
+	graphics_stats_roll(tsc_microseconds());
+	*stats_out = compositor.stats;
 }
 
 void graphics_draw_pixel(struct graphics_info *graphics_info, uint32_t x, uint32_t y, struct framebuffer_pixel pixel)
@@ -196,21 +359,15 @@ void graphics_draw_image(struct graphics_info *graphics_info, struct image *imag
 	}
 }
 
-void graphics_redraw_only(struct graphics_info *graphics_info)
+// the graphics and everything below it are composed again on the next present
+static void graphics_damage_tree(struct graphics_info *graphics_info)
 {
-	if (!graphics_info)
+	graphics_damage_add(graphics_info->starting_x, graphics_info->starting_y, graphics_info->width, graphics_info->height);
+	if (!graphics_info->children)
 	{
 		return;
 	}
 
-	graphics_paste_pixels_to_framebuffer(graphics_info,
-										 0, 0,
-										 graphics_info->width, graphics_info->height,
-										 graphics_info->starting_x, graphics_info->starting_y);
-}
-
-void graphics_redraw_children(struct graphics_info *graphics_info)
-{
 	size_t total_children = vector_count(graphics_info->children);
 	for (size_t i = 0; i < total_children; i++)
 	{
@@ -218,7 +375,7 @@ void graphics_redraw_children(struct graphics_info *graphics_info)
 		vector_at(graphics_info->children, i, &child, sizeof(child));
 		if (child)
 		{
-			graphics_redraw(child);
+			graphics_damage_tree(child);
 		}
 	}
 }
@@ -245,52 +402,7 @@ void graphics_redraw_region(struct graphics_info *graphics_info, uint32_t local_
 		height = graphics_info->height - local_y;
 	}
 
-	uint32_t dst_abs_x = graphics_info->starting_x + local_x;
-	uint32_t dst_abs_y = graphics_info->starting_y + local_y;
-	graphics_paste_pixels_to_framebuffer(graphics_info,
-										 local_x, local_y,
-										 width, height,
-										 dst_abs_x, dst_abs_y);
-
-	uint32_t region_abs_left = dst_abs_x;
-	uint32_t region_abs_top = dst_abs_y;
-	uint32_t region_abs_right = dst_abs_x + width;
-	uint32_t region_abs_bottom = dst_abs_y + height;
-
-	// check each child if it intersects with the region
-	size_t total_children = vector_count(graphics_info->children);
-	for (size_t i = 0; i < total_children; i++)
-	{
-		struct graphics_info *child = NULL;
-		vector_at(graphics_info->children, i, &child, sizeof(child));
-		if (!child)
-		{
-			continue;
-		}
-
-		// child absolute coordinates
-		uint32_t child_abs_left = child->starting_x;
-		uint32_t child_abs_top = child->starting_y;
-		uint32_t child_abs_right = child->starting_x + child->width;
-		uint32_t child_abs_bottom = child->starting_y + child->height;
-
-		// compute intersection
-		uint32_t inter_left = MAX(region_abs_left, child_abs_left);
-		uint32_t inter_top = MAX(region_abs_top, child_abs_top);
-		uint32_t inter_right = MIN(region_abs_right, child_abs_right);
-		uint32_t inter_bottom = MIN(region_abs_bottom, child_abs_bottom);
-
-		if (inter_right > inter_left && inter_bottom > inter_top)
-		{
-			// there is an intersection, redraw the intersecting region of the child
-			uint32_t child_local_x = inter_left - child_abs_left;
-			uint32_t child_local_y = inter_top - child_abs_top;
-			uint32_t inter_width = inter_right - inter_left;
-			uint32_t inter_height = inter_bottom - inter_top;
-
-			graphics_redraw_region(child, child_local_x, child_local_y, inter_width, inter_height);
-		}
-	}
+	graphics_damage_add(graphics_info->starting_x + local_x, graphics_info->starting_y + local_y, width, height);
 }
 
 void graphics_ignore_color(struct graphics_info *graphics_info, struct framebuffer_pixel pixel_color)
@@ -521,15 +633,16 @@ void graphics_redraw(struct graphics_info *graphics_info)
 		return;
 	}
 
-	graphics_redraw_only(graphics_info);
-
-	// redraw children
-	graphics_redraw_children(graphics_info);
+	graphics_damage_tree(graphics_info);
 }
 
 void graphics_redraw_all()
 {
-	graphics_redraw(graphics_screen_info());
+	struct graphics_info *screen = graphics_screen_info();
+	if (screen)
+	{
+		graphics_damage_add(0, 0, screen->width, screen->height);
+	}
 }
 
 int graphics_reorder(void *first_element, void *second_element)
@@ -818,6 +931,12 @@ void graphics_setup(struct graphics_info *main_graphics_info)
 	main_graphics_info->framebuffer = new_framebuffer_memory;
 	main_graphics_info->children = vector_new(sizeof(struct graphics_info *), 4, 0);
 	main_graphics_info->pixels = kzalloc(framebuffer_size);
+	compositor.buffer = kzalloc(main_graphics_info->horizontal_resolution * main_graphics_info->vertical_resolution * sizeof(struct framebuffer_pixel));
+	if (!compositor.buffer)
+	{
+		panic("graphics_setup: no memory for the compose buffer\n");
+	}
+
 	main_graphics_info->width = main_graphics_info->horizontal_resolution;
 	main_graphics_info->height = main_graphics_info->vertical_resolution;
 	main_graphics_info->relative_x = 0;
@@ -64,6 +64,15 @@ struct graphics_info
 	} event_handlers;							   // event handlers for mouse events
 };
 
+// compositor counters, pixels are counted as they are written to the framebuffer
+struct graphics_stats
+{
+	uint64_t frames;			// presents that had damage to push
+	uint64_t rects;				// dirty rectangles pushed
+	uint64_t pixels;			// pixels pushed since boot
+	uint64_t pixels_per_second; // pixels pushed over the last full second
+};
+
 void graphics_redraw(struct graphics_info *graphics_info);
 void graphics_redraw_all();
 void graphics_draw_pixel(struct graphics_info *graphics_info, uint32_t x, uint32_t y, struct framebuffer_pixel pixel);
@@ -103,4 +112,7 @@ graphics_get_child_at_position(struct graphics_info *graphics, size_t x, size_t
 void graphics_click_handler_set(struct graphics_info *graphics_info, GRAPHICS_MOUSE_CLICK_FUNCTION handler);
 void graphics_move_handler_set(struct graphics_info *graphics_info, GRAPHICS_MOUSE_MOVE_FUNCTION handler);
 void graphics_setup_stage2(struct graphics_info *main_graphics_info);
-bool graphics_has_ancestor(struct graphics_info *graphics_child, struct graphics_info *graphics_ancestor);
\ No newline at end of file
+bool graphics_has_ancestor(struct graphics_info *graphics_child, struct graphics_info *graphics_ancestor);
+void graphics_present();
+void graphics_frame();
+void graphics_stats_get(struct graphics_stats *stats_out);
\ No newline at end of file
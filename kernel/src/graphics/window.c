@@ -316,8 +316,9 @@ void window_close(struct window *window)
 	event.type = WINDOW_EVENT_TYPE_WINDOW_CLOSE;
 	window_event_push(window, &event);
 
+	// the area the window covered is composed again without it
+	window_redraw(window);
 	window_free(window);
-	graphics_redraw_all();
 }
 
 int window_event_handler(struct window *window, struct window_event *event)
@@ -711,9 +712,7 @@ window_create(struct graphics_info *graphics_info, struct font *font, const char
 	window_event_handler_register(window, window_event_handler);
 
 	window_focus(window);
-
-	// redraw all graphics including our new window
-	graphics_redraw_all();
+	window_redraw(window);
 
 out:
 	if (res < 0)
@@ -14,8 +14,17 @@ global isr80h_wrapper
 global interrupt_pointer_table
 
 temp_rsp_storage: dq 0x00
+; interrupts are taken inside the kernel too, so every register the interrupted code may use is saved
 %macro pushad_macro 0
 	mov qword [temp_rsp_storage], rsp
+	push r15
+	push r14
+	push r13
+	push r12
+	push r11
+	push r10
+	push r9
+	push r8
 	push rax
 	push rcx
 	push rdx
@@ -35,6 +44,14 @@ temp_rsp_storage: dq 0x00
 	pop rdx
 	pop rcx
 	pop rax
+	pop r8
+	pop r9
+	pop r10
+	pop r11
+	pop r12
+	pop r13
+	pop r14
+	pop r15
 	mov rsp, [temp_rsp_storage]
 %endmacro
 
@@ -7,6 +7,9 @@
 #include "memory/heap/kheap.h"
 #include "status.h"
 #include "task/process.h"
+#include "io/apic.h"
+#include "memory/paging/paging.h"
+#include "graphics/graphics.h"
 
 struct idt_desc idt_descriptors[MYOS_TOTAL_INTERRUPTS];
 struct idtr_desc idtr_descriptor;
@@ -15,6 +18,14 @@ extern void *interrupt_pointer_table[MYOS_TOTAL_INTERRUPTS];
 
 static INTERRUPT_CALLBACK_FUNCTION interrupt_callbacks[MYOS_TOTAL_INTERRUPTS];
 
+// vectors handed out by idt_allocate_vector are delivered through the local APIC (MSI/MSI-X)
+// and must be acknowledged there instead of at the 8259 PIC
+static struct
+{
+	INTERRUPT_VECTOR_CALLBACK_FUNCTION callback;
+	void *private;
+} interrupt_vectors[MYOS_TOTAL_INTERRUPTS];
+
 static ISR80H_COMMAND isr80h_commands[MYOS_MAX_ISR80H_COMMANDS];
 
 extern void idt_load(struct idtr_desc *ptr);
@@ -27,12 +38,41 @@ void no_interrupt_handler()
 	outb(0xA0, 0x20); // send EOI to slave PIC
 }
 
+bool idt_frame_from_kernel(struct interrupt_frame *frame)
+{
+	return (frame->cs & 0x03) == 0;
+}
+
+bool interrupts_enabled()
+{
+	uint64_t flags = 0;
+	__asm__ volatile("pushfq; pop %0"
+					 : "=r"(flags));
+	return (flags & 0x200) != 0;
+}
+
 void interrupt_handler(int interrupt, struct interrupt_frame *frame)
 {
+	// interrupts can now arrive while the kernel waits for a device (see task_wait_for_wakeup),
+	// in which case there is no user state to save and the interrupted page tables must be kept
+	bool from_kernel = idt_frame_from_kernel(frame);
+	struct paging_desc *interrupted_desc = paging_current_descriptor();
 	kernel_page();
+	if (interrupt == APIC_SPURIOUS_VECTOR)
+	{
+		goto out; // spurious APIC interrupts must not be acknowledged
+	}
+
+	if (interrupt_vectors[interrupt].callback)
+	{
+		interrupt_vectors[interrupt].callback(frame, interrupt_vectors[interrupt].private);
+		apic_eoi();
+		goto out;
+	}
+
 	if (interrupt_callbacks[interrupt] != 0)
 	{
-		if (task_current())
+		if (task_current() && !from_kernel)
 		{
 			task_current_save_state(frame);
 		}
@@ -40,13 +80,21 @@ void interrupt_handler(int interrupt, struct interrupt_frame *frame)
 		interrupt_callbacks[interrupt](frame);
 	}
 
-	if (task_current())
+	outb(0x20, 0x20);
+	outb(0xA0, 0x20); // send EOI to slave PIC
+
+out:
+	if (from_kernel)
+	{
+		if (interrupted_desc)
+		{
+			paging_switch(interrupted_desc);
+		}
+	}
+	else if (task_current())
 	{
 		task_page();
 	}
-
-	outb(0x20, 0x20);
-	outb(0xA0, 0x20); // send EOI to slave PIC
 }
 
 void idt_zero()
@@ -64,10 +112,12 @@ void idt_set(int interrupt_no, void *address)
 	desc->selector = KERNEL_LONG_MODE_CODE_SELECTOR;
 	desc->ist = 0;
 
-	desc->type_attr = 0xee; // interrupt gate
-	if (interrupt_no <= 0x31)
+	// only the syscall gate can be raised from ring 3, device vectors handed out by
+	// idt_allocate_vector would otherwise let user code run completion handlers and send EOIs
+	desc->type_attr = 0x8e; // interrupt gate, present
+	if (interrupt_no == 0x80)
 	{
-		desc->type_attr = 0x8e; // interrupt gate, present
+		desc->type_attr = 0xee; // interrupt gate, present, DPL3
 	}
 
 	desc->offset_2 = (_address >> 16) & 0x000000000000ffff;
@@ -81,7 +131,7 @@ void idt_handle_exception()
 	// task_next();
 }
 
-void idt_clock()
+void idt_clock(struct interrupt_frame *frame)
 {
 	outb(0x20, 0x20);
 	if (!task_current())
@@ -89,6 +139,12 @@ void idt_clock()
 		return;
 	}
 
+	// never preempt the kernel, there is only one kernel stack
+	if (idt_frame_from_kernel(frame))
+	{
+		return;
+	}
+
 	// switch to the next task
 	task_next();
 }
@@ -129,6 +185,34 @@ int idt_register_interrupt_callback(int interrupt, INTERRUPT_CALLBACK_FUNCTION i
 	return 0;
 }
 
+int idt_allocate_vector(INTERRUPT_VECTOR_CALLBACK_FUNCTION interrupt_callback, void *private)
+{
+	for (int i = MYOS_FIRST_DYNAMIC_INTERRUPT; i <= MYOS_LAST_DYNAMIC_INTERRUPT; i++)
+	{
+		if (i == 0x80 || interrupt_callbacks[i] || interrupt_vectors[i].callback)
+		{
+			continue; // skip the syscall gate and vectors already in use
+		}
+
+		interrupt_vectors[i].callback = interrupt_callback;
+		interrupt_vectors[i].private = private;
+		return i;
+	}
+
+	return -ENOMEM;
+}
+
+void idt_free_vector(int interrupt)
+{
+	if (interrupt < MYOS_FIRST_DYNAMIC_INTERRUPT || interrupt > MYOS_LAST_DYNAMIC_INTERRUPT)
+	{
+		return;
+	}
+
+	interrupt_vectors[interrupt].callback = NULL;
+	interrupt_vectors[interrupt].private = NULL;
+}
+
 void isr80h_register_command(int command_id, ISR80H_COMMAND command)
 {
 	if (command_id < 0 || command_id >= MYOS_MAX_ISR80H_COMMANDS)
@@ -169,6 +253,7 @@ void *isr80h_handler(int command, struct interrupt_frame *frame)
 	kernel_page();
 	task_current_save_state(frame);
 	res = isr80h_handle_command(command, frame);
+	graphics_frame();
 	task_page();
 	return res;
 }
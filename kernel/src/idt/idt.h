@@ -1,10 +1,12 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
 
 struct interrupt_frame;
 typedef void *(*ISR80H_COMMAND)(struct interrupt_frame *frame);
 typedef void (*INTERRUPT_CALLBACK_FUNCTION)();
+typedef void (*INTERRUPT_VECTOR_CALLBACK_FUNCTION)(struct interrupt_frame *frame, void *private);
 
 // 64 bit idt descriptor
 struct idt_desc
@@ -34,6 +36,14 @@ struct interrupt_frame
 	uint64_t rdx;
 	uint64_t rcx;
 	uint64_t rax;
+	uint64_t r8;
+	uint64_t r9;
+	uint64_t r10;
+	uint64_t r11;
+	uint64_t r12;
+	uint64_t r13;
+	uint64_t r14;
+	uint64_t r15;
 	uint64_t ip;
 	uint64_t cs;
 	uint64_t flags;
@@ -44,5 +54,9 @@ struct interrupt_frame
 void idt_init();
 void enable_interrupts();
 void disable_interrupts();
+bool interrupts_enabled();
 void isr80h_register_command(int command_id, ISR80H_COMMAND command);
 int idt_register_interrupt_callback(int interrupt, INTERRUPT_CALLBACK_FUNCTION interrupt_callback);
+int idt_allocate_vector(INTERRUPT_VECTOR_CALLBACK_FUNCTION interrupt_callback, void *private);
+void idt_free_vector(int interrupt);
+bool idt_frame_from_kernel(struct interrupt_frame *frame);
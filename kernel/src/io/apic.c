@@ -0,0 +1,78 @@
+#include "apic.h"
+#include "kernel.h"
+#include "status.h"
+#include "memory/paging/paging.h"
+
+static volatile uint8_t *apic_base = NULL;
+
+static uint64_t apic_read_msr(uint32_t msr)
+{
+	uint32_t low, high;
+	__asm__ volatile("rdmsr"
+					 : "=a"(low), "=d"(high)
+					 : "c"(msr));
+	return ((uint64_t)high << 32) | low;
+}
+
+static void apic_write_msr(uint32_t msr, uint64_t value)
+{
+	__asm__ volatile("wrmsr" ::"c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline uint32_t apic_read(uint32_t reg)
+{
+	return *(volatile uint32_t *)(apic_base + reg);
+}
+
+static inline void apic_write(uint32_t reg, uint32_t value)
+{
+	*(volatile uint32_t *)(apic_base + reg) = value;
+}
+
+int apic_init(void)
+{
+	uint64_t msr = apic_read_msr(APIC_BASE_MSR);
+	uintptr_t base = (uintptr_t)(msr & ~0xFFFull);
+	if (!base)
+	{
+		base = APIC_DEFAULT_BASE_ADDRESS;
+	}
+
+	if (!(msr & APIC_BASE_MSR_ENABLE))
+	{
+		apic_write_msr(APIC_BASE_MSR, msr | APIC_BASE_MSR_ENABLE); // globally enable the local APIC
+	}
+
+	// the local APIC registers live in a single uncached page
+	paging_map(kernel_desc(), (void *)base, (void *)base, PAGING_IS_PRESENT | PAGING_IS_WRITEABLE | PAGING_CACHE_DISABLED);
+	apic_base = (volatile uint8_t *)base;
+
+	// accept every priority class and software enable the APIC, legacy PIC interrupts
+	// still arrive through LINT0 so this does not disturb the existing IRQ handling
+	apic_write(APIC_REGISTER_TPR, 0);
+	apic_write(APIC_REGISTER_SVR, APIC_SVR_SOFTWARE_ENABLE | APIC_SPURIOUS_VECTOR);
+	return 0;
+}
+
+bool apic_enabled(void)
+{
+	return apic_base != NULL;
+}
+
+uint8_t apic_id(void)
+{
+	if (!apic_base)
+	{
+		return 0;
+	}
+
+	return (uint8_t)(apic_read(APIC_REGISTER_ID) >> 24);
+}
+
+void apic_eoi(void)
+{
+	if (apic_base)
+	{
+		apic_write(APIC_REGISTER_EOI, 0);
+	}
+}
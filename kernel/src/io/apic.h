@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define APIC_BASE_MSR 0x1B
+#define APIC_BASE_MSR_ENABLE 0x800
+#define APIC_DEFAULT_BASE_ADDRESS 0xFEE00000
+
+#define APIC_REGISTER_ID 0x20
+#define APIC_REGISTER_TPR 0x80
+#define APIC_REGISTER_EOI 0xB0
+#define APIC_REGISTER_SVR 0xF0
+
+#define APIC_SVR_SOFTWARE_ENABLE 0x100
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+int apic_init(void);
+bool apic_enabled(void);
+uint8_t apic_id(void);
+void apic_eoi(void);
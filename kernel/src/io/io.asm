@@ -7,6 +7,8 @@ global insdw
 global outb
 global outw
 global outdw
+global insw_block
+global outsw_block
 
 insb:
 	xor rax, rax
@@ -43,3 +45,20 @@ outdw:
 	mov rdx, rdi
 	out dx, eax
 	ret
+
+; void insw_block(unsigned short port, void *buf, size_t total_words)
+insw_block:
+	mov rcx, rdx
+	mov dx, di
+	mov rdi, rsi
+	cld
+	rep insw
+	ret
+
+; void outsw_block(unsigned short port, const void *buf, size_t total_words)
+outsw_block:
+	mov rcx, rdx
+	mov dx, di
+	cld
+	rep outsw
+	ret
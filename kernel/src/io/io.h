@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stddef.h>
+
 unsigned char insb(unsigned short port);
 unsigned short insw(unsigned short port);
 unsigned int insdw(unsigned short port);
@@ -7,3 +9,7 @@ unsigned int insdw(unsigned short port);
 void outb(unsigned short port, unsigned char val);
 void outw(unsigned short port, unsigned short val);
 void outdw(unsigned short port, unsigned int val);
+
+// string IO, moves a whole block of words with a single rep ins/outs instruction
+void insw_block(unsigned short port, void *buf, size_t total_words);
+void outsw_block(unsigned short port, const void *buf, size_t total_words);
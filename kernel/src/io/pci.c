@@ -4,8 +4,13 @@
 #include "lib/vector.h"
 #include "status.h"
 #include "kernel.h"
+#include "memory/paging/paging.h"
 #include <stdbool.h>
 
+// MSI message address window (fixed destination mode, physical addressing)
+#define PCI_MSI_ADDRESS_BASE 0xFEE00000u
+#define PCI_MSI_ADDRESS_DEST_SHIFT 12
+
 // ECAM globals
 #define PCI_ECAM_MAX_RANGES 8  // Maximum number of ECAM ranges supported
 #define PCI_ECAM_BUS_SHIFT 20  // Shift for bus number in ECAM address calculation (1 MB per bus)
@@ -511,4 +516,207 @@ void pci_enable_bus_master(struct pci_device *device)
 	{
 		pci_enable_upstream_path(device->parent_bridge, need_io, need_mem); // Ensure all upstream bridges have the necessary access enabled
 	}
+}
+
+uint64_t pci_device_bar_address(struct pci_device *device, int bar)
+{
+	if (bar < 0 || bar >= 6)
+	{
+		return 0;
+	}
+
+	uint64_t addr = device->bars[bar].addr;
+	if ((device->bars[bar].flags & PCI_DEVICE_BAR_FLAG_64BIT) && (bar + 1) < 6)
+	{
+		addr = (addr & 0xFFFFFFFFull) | ((uint64_t)device->bars[bar + 1].addr << 32); // Upper half lives in the extension BAR
+	}
+
+	return addr;
+}
+
+uint8_t pci_capability_find_next(struct pci_device *device, uint8_t cap_id, uint8_t previous)
+{
+	uint8_t bus = device->addr.bus;
+	uint8_t slot = device->addr.slot;
+	uint8_t func = device->addr.function;
+	uint16_t status = pci_cfg_read_word(bus, slot, func, PCI_HEADER_STATUS_OFFSET);
+	if (!(status & PCI_STATUS_CAPABILITIES_LIST))
+	{
+		return 0; // Device has no capabilities list
+	}
+
+	uint8_t offset = 0;
+	if (previous)
+	{
+		offset = pci_cfg_read_byte(bus, slot, func, previous + 1) & ~0x3u; // Resume after the previous match
+	}
+	else
+	{
+		offset = pci_cfg_read_byte(bus, slot, func, PCI_HEADER_CAPABILITIES_OFFSET) & ~0x3u;
+	}
+
+	for (int guard = 0; offset && guard < 48; guard++) // 48 entries is the most that fit in 256 bytes of config space
+	{
+		uint8_t id = pci_cfg_read_byte(bus, slot, func, offset);
+		if (id == cap_id)
+		{
+			return offset;
+		}
+
+		offset = pci_cfg_read_byte(bus, slot, func, offset + 1) & ~0x3u; // Follow the next pointer
+	}
+
+	return 0;
+}
+
+uint8_t pci_capability_find(struct pci_device *device, uint8_t cap_id)
+{
+	return pci_capability_find_next(device, cap_id, 0);
+}
+
+void pci_disable_legacy_interrupt(struct pci_device *device)
+{
+	uint16_t cmd = pci_cfg_read_word(device->addr.bus, device->addr.slot, device->addr.function, PCI_HEADER_COMMAND_OFFSET);
+	cmd |= PCI_COMMAND_INTERRUPT_DISABLE;
+	pci_cfg_write_word(device->addr.bus, device->addr.slot, device->addr.function, PCI_HEADER_COMMAND_OFFSET, cmd);
+}
+
+int pci_msi_enable(struct pci_device *device, uint8_t vector, uint8_t apic_id)
+{
+	uint8_t cap = pci_capability_find(device, PCI_CAPABILITY_ID_MSI);
+	if (!cap)
+	{
+		return -ENOENT; // Device does not support MSI
+	}
+
+	uint8_t bus = device->addr.bus;
+	uint8_t slot = device->addr.slot;
+	uint8_t func = device->addr.function;
+	uint16_t control = pci_cfg_read_word(bus, slot, func, cap + PCI_MSI_CONTROL_OFFSET);
+	uint8_t data_offset = PCI_MSI_DATA_32BIT_OFFSET;
+	pci_cfg_write_dword(bus, slot, func, cap + PCI_MSI_ADDRESS_OFFSET, PCI_MSI_ADDRESS_BASE | ((uint32_t)apic_id << PCI_MSI_ADDRESS_DEST_SHIFT));
+	if (control & PCI_MSI_CONTROL_64BIT)
+	{
+		pci_cfg_write_dword(bus, slot, func, cap + PCI_MSI_ADDRESS_OFFSET + 4, 0); // Message address (high)
+		data_offset = PCI_MSI_DATA_64BIT_OFFSET;
+	}
+
+	pci_cfg_write_word(bus, slot, func, cap + data_offset, vector); // Message data: fixed delivery, edge triggered
+
+	control &= ~PCI_MSI_CONTROL_MULTIPLE_MASK; // A single vector for the whole function
+	control |= PCI_MSI_CONTROL_ENABLE;
+	pci_cfg_write_word(bus, slot, func, cap + PCI_MSI_CONTROL_OFFSET, control);
+	pci_disable_legacy_interrupt(device);
+	return 0;
+}
+
+void pci_msi_disable(struct pci_device *device)
+{
+	uint8_t cap = pci_capability_find(device, PCI_CAPABILITY_ID_MSI);
+	if (!cap)
+	{
+		return;
+	}
+
+	uint8_t bus = device->addr.bus;
+	uint8_t slot = device->addr.slot;
+	uint8_t func = device->addr.function;
+	uint16_t control = pci_cfg_read_word(bus, slot, func, cap + PCI_MSI_CONTROL_OFFSET);
+	control &= ~PCI_MSI_CONTROL_ENABLE;
+	pci_cfg_write_word(bus, slot, func, cap + PCI_MSI_CONTROL_OFFSET, control);
+}
+
+volatile uint8_t *pci_device_bar_map(struct pci_device *device, int bar, uint64_t offset, size_t size)
+{
+	uint64_t base = pci_device_bar_address(device, bar);
+	if (!base || device->bars[bar].type != PCI_DEVICE_IO_MEMORY)
+	{
+		return NULL; // Only memory BARs can be mapped
+	}
+
+	uintptr_t start = (uintptr_t)(base + offset);
+	uintptr_t page = (uintptr_t)paging_align_to_lower_page((void *)start);
+	uintptr_t end = (uintptr_t)paging_align_value_to_upper_page(start + size);
+	const int flags = PAGING_IS_PRESENT | PAGING_IS_WRITEABLE | PAGING_CACHE_DISABLED;
+	for (; page < end; page += PAGING_PAGE_SIZE)
+	{
+		paging_map(kernel_desc(), (void *)page, (void *)page, flags); // Identity map the MMIO pages
+	}
+
+	return (volatile uint8_t *)start;
+}
+
+static volatile uint8_t *pci_msix_map_region(struct pci_device *device, uint32_t offset_bir, size_t size)
+{
+	return pci_device_bar_map(device, offset_bir & 0x7u, offset_bir & ~0x7u, size); // MSI-X structures must live in a memory BAR
+}
+
+int pci_msix_init(struct pci_device *device, struct pci_msix *msix_out)
+{
+	uint8_t cap = pci_capability_find(device, PCI_CAPABILITY_ID_MSIX);
+	if (!cap)
+	{
+		return -ENOENT; // Device does not support MSI-X
+	}
+
+	uint8_t bus = device->addr.bus;
+	uint8_t slot = device->addr.slot;
+	uint8_t func = device->addr.function;
+	uint16_t control = pci_cfg_read_word(bus, slot, func, cap + PCI_MSIX_CONTROL_OFFSET);
+	uint32_t table = pci_cfg_read_dword(bus, slot, func, cap + PCI_MSIX_TABLE_OFFSET);
+	uint32_t pba = pci_cfg_read_dword(bus, slot, func, cap + PCI_MSIX_PBA_OFFSET);
+
+	msix_out->device = device;
+	msix_out->cap_offset = cap;
+	msix_out->table_size = (uint16_t)((control & PCI_MSIX_CONTROL_TABLE_SIZE_MASK) + 1u);
+	msix_out->table = pci_msix_map_region(device, table, (size_t)msix_out->table_size * PCI_MSIX_ENTRY_SIZE);
+	msix_out->pba = pci_msix_map_region(device, pba, ((msix_out->table_size + 63u) / 64u) * 8u);
+	if (!msix_out->table)
+	{
+		return -EIO;
+	}
+
+	// Mask every entry until a driver explicitly routes it
+	for (uint16_t i = 0; i < msix_out->table_size; i++)
+	{
+		volatile uint32_t *entry = (volatile uint32_t *)(msix_out->table + (size_t)i * PCI_MSIX_ENTRY_SIZE);
+		entry[3] |= PCI_MSIX_ENTRY_VECTOR_CONTROL_MASKED;
+	}
+
+	return 0;
+}
+
+int pci_msix_set_vector(struct pci_msix *msix, uint16_t entry, uint8_t vector, uint8_t apic_id)
+{
+	if (!msix->table || entry >= msix->table_size)
+	{
+		return -EINVARG;
+	}
+
+	volatile uint32_t *e = (volatile uint32_t *)(msix->table + (size_t)entry * PCI_MSIX_ENTRY_SIZE);
+	e[0] = PCI_MSI_ADDRESS_BASE | ((uint32_t)apic_id << PCI_MSI_ADDRESS_DEST_SHIFT); // Message address (low)
+	e[1] = 0;																	   // Message address (high)
+	e[2] = vector;																   // Message data: fixed delivery, edge triggered
+	e[3] &= ~PCI_MSIX_ENTRY_VECTOR_CONTROL_MASKED;								   // Unmask the entry
+	return 0;
+}
+
+void pci_msix_enable(struct pci_msix *msix)
+{
+	struct pci_device *device = msix->device;
+	uint8_t off = msix->cap_offset + PCI_MSIX_CONTROL_OFFSET;
+	uint16_t control = pci_cfg_read_word(device->addr.bus, device->addr.slot, device->addr.function, off);
+	control |= PCI_MSIX_CONTROL_ENABLE;
+	control &= ~PCI_MSIX_CONTROL_FUNCTION_MASK;
+	pci_cfg_write_word(device->addr.bus, device->addr.slot, device->addr.function, off, control);
+	pci_disable_legacy_interrupt(device);
+}
+
+void pci_msix_disable(struct pci_msix *msix)
+{
+	struct pci_device *device = msix->device;
+	uint8_t off = msix->cap_offset + PCI_MSIX_CONTROL_OFFSET;
+	uint16_t control = pci_cfg_read_word(device->addr.bus, device->addr.slot, device->addr.function, off);
+	control &= ~PCI_MSIX_CONTROL_ENABLE;
+	pci_cfg_write_word(device->addr.bus, device->addr.slot, device->addr.function, off, control);
 }
\ No newline at end of file
@@ -29,9 +29,36 @@
 #define PCI_BRIDGE_SUBORDINATE_BUS_OFFSET 0x1A		   // Offset for Subordinate Bus Number (8 bits)
 #define PCI_BRIDGE_SECONDARY_LATENCY_TIMER_OFFSET 0x1B // Offset for Secondary Latency Timer (8 bits)
 
+#define PCI_HEADER_CAPABILITIES_OFFSET 0x34	  // Offset for Capabilities Pointer (8 bits)
 #define PCI_HEADER_INTERRUPT_LINE_OFFSET 0x3C // Offset for Interrupt Line (8 bits)
 #define PCI_HEADER_INTERRUPT_PIN_OFFSET 0x3D  // Offset for Interrupt Pin (8 bits)
 
+#define PCI_STATUS_CAPABILITIES_LIST 0x0010 // Status bit set when the capabilities list is valid
+#define PCI_COMMAND_INTERRUPT_DISABLE 0x0400 // Command bit that disables legacy INTx# assertion
+
+#define PCI_CAPABILITY_ID_MSI 0x05	// Message Signalled Interrupts capability
+#define PCI_CAPABILITY_ID_VENDOR 0x09 // Vendor specific capability
+#define PCI_CAPABILITY_ID_MSIX 0x11	  // MSI-X capability
+
+#define PCI_MSI_CONTROL_OFFSET 0x02			 // Offset of the MSI Message Control register within the capability
+#define PCI_MSI_ADDRESS_OFFSET 0x04			 // Offset of the MSI Message Address register within the capability
+#define PCI_MSI_DATA_32BIT_OFFSET 0x08		 // Offset of the MSI Message Data register for 32 bit capable functions
+#define PCI_MSI_DATA_64BIT_OFFSET 0x0C		 // Offset of the MSI Message Data register for 64 bit capable functions
+#define PCI_MSI_CONTROL_ENABLE 0x0001u		 // Enables MSI and disables INTx#
+#define PCI_MSI_CONTROL_MULTIPLE_MASK 0x0070u // Multiple Message Enable field
+#define PCI_MSI_CONTROL_64BIT 0x0080u		 // Function supports 64 bit message addresses
+
+#define PCI_MSIX_CONTROL_OFFSET 0x02 // Offset of the MSI-X Message Control register within the capability
+#define PCI_MSIX_TABLE_OFFSET 0x04	 // Offset of the MSI-X Table Offset/BIR register within the capability
+#define PCI_MSIX_PBA_OFFSET 0x08	 // Offset of the MSI-X PBA Offset/BIR register within the capability
+
+#define PCI_MSIX_CONTROL_TABLE_SIZE_MASK 0x07FFu // Table size is encoded as N - 1
+#define PCI_MSIX_CONTROL_FUNCTION_MASK 0x4000u	 // Masks every vector of the function
+#define PCI_MSIX_CONTROL_ENABLE 0x8000u			 // Enables MSI-X and disables INTx#/MSI
+
+#define PCI_MSIX_ENTRY_SIZE 16				  // Size of a single MSI-X table entry
+#define PCI_MSIX_ENTRY_VECTOR_CONTROL_MASKED 0x1u // Vector control bit that masks the entry
+
 #define PCI_CFG_ADDRESS 0xCF8  // I/O port for PCI configuration address
 #define PCI_DATA_ADDRESS 0xCFC // I/O port for PCI configuration data
 
@@ -89,6 +116,15 @@ struct pci_device
 	struct pci_device *parent_bridge; // Pointer to parent bridge device
 };
 
+struct pci_msix
+{
+	struct pci_device *device; // Device that owns the capability
+	uint8_t cap_offset;		   // Offset of the MSI-X capability in configuration space
+	uint16_t table_size;	   // Number of entries in the MSI-X table
+	volatile uint8_t *table;   // Mapped MSI-X table
+	volatile uint8_t *pba;	   // Mapped pending bit array
+};
+
 struct pci_ecam_range
 {
 	uint16_t seg_group; // Segment group number
@@ -115,4 +151,17 @@ int pci_device_get(size_t index, struct pci_device **device_out);
 int pci_device_base_class(struct pci_device *device);
 int pci_device_subclass(struct pci_device *device);
 
-void pci_enable_bus_master(struct pci_device *device);
\ No newline at end of file
+void pci_enable_bus_master(struct pci_device *device);
+uint64_t pci_device_bar_address(struct pci_device *device, int bar);
+volatile uint8_t *pci_device_bar_map(struct pci_device *device, int bar, uint64_t offset, size_t size);
+uint8_t pci_capability_find(struct pci_device *device, uint8_t cap_id);
+uint8_t pci_capability_find_next(struct pci_device *device, uint8_t cap_id, uint8_t previous);
+void pci_disable_legacy_interrupt(struct pci_device *device);
+
+int pci_msi_enable(struct pci_device *device, uint8_t vector, uint8_t apic_id);
+void pci_msi_disable(struct pci_device *device);
+
+int pci_msix_init(struct pci_device *device, struct pci_msix *msix_out);
+int pci_msix_set_vector(struct pci_msix *msix, uint16_t entry, uint8_t vector, uint8_t apic_id);
+void pci_msix_enable(struct pci_msix *msix);
+void pci_msix_disable(struct pci_msix *msix);
\ No newline at end of file
@@ -0,0 +1,14 @@
+#include "disk.h"
+#include "task/task.h"
+#include "task/process.h"
+#include <stddef.h>
+
+void *isr80h_command26_disk_stats(struct interrupt_frame *frame)
+{
+	int res = 0;
+	long disk_id = (long)(int64_t)task_get_stack_item(task_current(), 0);
+	struct disk_stats_info *info_virt_addr = task_get_stack_item(task_current(), 1);
+
+	res = process_disk_stats(process_current(), (int)disk_id, info_virt_addr);
+	return (void *)(int64_t)res;
+}
@@ -0,0 +1,4 @@
+#pragma once
+#include "idt/idt.h"
+
+void *isr80h_command26_disk_stats(struct interrupt_frame *frame);
@@ -2,6 +2,7 @@
 #include "task/task.h"
 #include "task/process.h"
 #include "idt/idt.h"
+#include "kernel.h"
 #include <stddef.h>
 
 void *isr80h_command10_fopen(struct interrupt_frame *frame)
@@ -76,4 +77,131 @@ void *isr80h_command14_fstat(struct interrupt_frame *frame)
 
 	res = process_fstat(process_current(), fd, filestat_virt_addr);
 	return (void *)(int64_t)res;
-}
\ No newline at end of file
+}
+void *isr80h_command27_fwrite(struct interrupt_frame *frame)
+{
+	int res = 0;
+	void *buffer_virt_addr = task_get_stack_item(task_current(), 0);
+	size_t size = (size_t)(int64_t)task_get_stack_item(task_current(), 1);
+	size_t count = (size_t)(int64_t)task_get_stack_item(task_current(), 2);
+	long fd = (long)(int64_t)task_get_stack_item(task_current(), 3);
+
+	res = process_fwrite(process_current(), buffer_virt_addr, size, count, (int)fd);
+	return (void *)(int64_t)res;
+}
+
+void *isr80h_command28_ftruncate(struct interrupt_frame *frame)
+{
+	int res = 0;
+	long fd = (long)(int64_t)task_get_stack_item(task_current(), 0);
+	size_t size = (size_t)(int64_t)task_get_stack_item(task_current(), 1);
+
+	res = process_ftruncate(process_current(), (int)fd, size);
+	return (void *)(int64_t)res;
+}
+
+void *isr80h_command29_funlink(struct interrupt_frame *frame)
+{
+	int res = 0;
+	void *filename_virt_addr = task_get_stack_item(task_current(), 0);
+	void *filename_phys_addr = task_virtual_addr_to_phys(task_current(), filename_virt_addr);
+	if (!filename_phys_addr)
+	{
+		res = -1;
+		goto out;
+	}
+
+	res = process_funlink(process_current(), (const char *)filename_phys_addr);
+out:
+	return (void *)(int64_t)res;
+}
+
+static void *isr80h_pio(bool write)
+{
+	int res = 0;
+	long fd = (long)(int64_t)task_get_stack_item(task_current(), 0);
+	void *buffer_virt_addr = task_get_stack_item(task_current(), 1);
+	size_t count = (size_t)(int64_t)task_get_stack_item(task_current(), 2);
+	size_t offset = (size_t)(int64_t)task_get_stack_item(task_current(), 3);
+
+	res = process_pio(process_current(), (int)fd, buffer_virt_addr, count, offset, write);
+	return (void *)(int64_t)res;
+}
+
+void *isr80h_command30_pread(struct interrupt_frame *frame)
+{
+	return isr80h_pio(false);
+}
+
+void *isr80h_command31_pwrite(struct interrupt_frame *frame)
+{
+	return isr80h_pio(true);
+}
+
+static void *isr80h_vio(bool write)
+{
+	int res = 0;
+	long fd = (long)(int64_t)task_get_stack_item(task_current(), 0);
+	struct process_iovec *iov_virt_addr = task_get_stack_item(task_current(), 1);
+	long iovcnt = (long)(int64_t)task_get_stack_item(task_current(), 2);
+
+	res = process_vio(process_current(), (int)fd, iov_virt_addr, (int)iovcnt, write);
+	return (void *)(int64_t)res;
+}
+
+void *isr80h_command32_readv(struct interrupt_frame *frame)
+{
+	return isr80h_vio(false);
+}
+
+void *isr80h_command33_writev(struct interrupt_frame *frame)
+{
+	return isr80h_vio(true);
+}
+
+void *isr80h_command34_readdir(struct interrupt_frame *frame)
+{
+	int res = 0;
+	void *path_virt_addr = task_get_stack_item(task_current(), 0);
+	void *path_phys_addr = task_virtual_addr_to_phys(task_current(), path_virt_addr);
+	if (!path_phys_addr)
+	{
+		res = -1;
+		goto out;
+	}
+
+	uint32_t *cursor_virt_addr = task_get_stack_item(task_current(), 1);
+	struct file_dirent *entries_virt_addr = task_get_stack_item(task_current(), 2);
+	long max = (long)(int64_t)task_get_stack_item(task_current(), 3);
+
+	res = process_readdir(process_current(), (const char *)path_phys_addr, cursor_virt_addr, entries_virt_addr, (int)max);
+out:
+	return (void *)(int64_t)res;
+}
+
+void *isr80h_command35_fmap(struct interrupt_frame *frame)
+{
+	long fd = (long)(int64_t)task_get_stack_item(task_current(), 0);
+	size_t offset = (size_t)(int64_t)task_get_stack_item(task_current(), 1);
+	size_t size = (size_t)(int64_t)task_get_stack_item(task_current(), 2);
+
+	void *virt = process_fmap(process_current(), (int)fd, offset, size);
+	if (ISERR(virt))
+	{
+		return NULL;
+	}
+
+	return virt;
+}
+
+void *isr80h_command36_funmap(struct interrupt_frame *frame)
+{
+	void *virt = task_get_stack_item(task_current(), 0);
+	return (void *)(int64_t)process_funmap(process_current(), virt);
+}
+
+void *isr80h_command38_fdup(struct interrupt_frame *frame)
+{
+	int64_t fd = (int64_t)task_get_stack_item(task_current(), 0);
+	return (void *)(int64_t)process_fdup(process_current(), (int)fd);
+}
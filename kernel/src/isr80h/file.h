@@ -5,4 +5,15 @@ void *isr80h_command10_fopen(struct interrupt_frame *frame);
 void *isr80h_command11_fclose(struct interrupt_frame *frame);
 void *isr80h_command12_fread(struct interrupt_frame *frame);
 void *isr80h_command13_fseek(struct interrupt_frame *frame);
-void *isr80h_command14_fstat(struct interrupt_frame *frame);
\ No newline at end of file
+void *isr80h_command14_fstat(struct interrupt_frame *frame);
+void *isr80h_command27_fwrite(struct interrupt_frame *frame);
+void *isr80h_command28_ftruncate(struct interrupt_frame *frame);
+void *isr80h_command29_funlink(struct interrupt_frame *frame);
+void *isr80h_command30_pread(struct interrupt_frame *frame);
+void *isr80h_command31_pwrite(struct interrupt_frame *frame);
+void *isr80h_command32_readv(struct interrupt_frame *frame);
+void *isr80h_command33_writev(struct interrupt_frame *frame);
+void *isr80h_command34_readdir(struct interrupt_frame *frame);
+void *isr80h_command35_fmap(struct interrupt_frame *frame);
+void *isr80h_command36_funmap(struct interrupt_frame *frame);
+void *isr80h_command38_fdup(struct interrupt_frame *frame);
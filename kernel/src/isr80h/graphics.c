@@ -114,4 +114,10 @@ void *isr80h_command22_graphics_create(struct interrupt_frame *frame)
 	userland_child_graphics_metadata->userland_ptr = userland_child_graphics;
 
 	return (void *)userland_child_graphics_metadata;
-}
\ No newline at end of file
+}
+
+void *isr80h_command37_graphics_stats(struct interrupt_frame *frame)
+{
+	struct graphics_stats *stats_virt_out = task_get_stack_item(task_current(), 0);
+	return (void *)(int64_t)process_graphics_stats(process_current(), stats_virt_out);
+}
@@ -20,4 +20,5 @@ struct userland_graphics
 
 struct userland_graphics *isr80h_graphics_make_userland_metadata(struct process *process, struct graphics_info *graphics_info);
 void *isr80h_command20_graphics_pixels_buffer_get(struct interrupt_frame *frame);
-void *isr80h_command22_graphics_create(struct interrupt_frame *frame);
\ No newline at end of file
+void *isr80h_command22_graphics_create(struct interrupt_frame *frame);
+void *isr80h_command37_graphics_stats(struct interrupt_frame *frame);
\ No newline at end of file
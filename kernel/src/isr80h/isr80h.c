@@ -8,6 +8,7 @@
 #include "window.h"
 #include "graphics.h"
 #include "time.h"
+#include "disk.h"
 
 void isr80h_register_commands()
 {
@@ -37,4 +38,17 @@ void isr80h_register_commands()
 	isr80h_register_command(SYSTEM_COMMAND23_WINDOW_REDRAW_REGION, isr80h_command23_window_redraw_region);
 	isr80h_register_command(SYSTEM_COMMAND24_UPDATE_WINDOW, isr80h_command24_update_window);
 	isr80h_register_command(SYSTEM_COMMAND25_UDELAY, isr80h_command25_udelay);
+	isr80h_register_command(SYSTEM_COMMAND26_DISK_STATS, isr80h_command26_disk_stats);
+	isr80h_register_command(SYSTEM_COMMAND27_FWRITE, isr80h_command27_fwrite);
+	isr80h_register_command(SYSTEM_COMMAND28_FTRUNCATE, isr80h_command28_ftruncate);
+	isr80h_register_command(SYSTEM_COMMAND29_FUNLINK, isr80h_command29_funlink);
+	isr80h_register_command(SYSTEM_COMMAND30_PREAD, isr80h_command30_pread);
+	isr80h_register_command(SYSTEM_COMMAND31_PWRITE, isr80h_command31_pwrite);
+	isr80h_register_command(SYSTEM_COMMAND32_READV, isr80h_command32_readv);
+	isr80h_register_command(SYSTEM_COMMAND33_WRITEV, isr80h_command33_writev);
+	isr80h_register_command(SYSTEM_COMMAND34_READDIR, isr80h_command34_readdir);
+	isr80h_register_command(SYSTEM_COMMAND35_FMAP, isr80h_command35_fmap);
+	isr80h_register_command(SYSTEM_COMMAND36_FUNMAP, isr80h_command36_funmap);
+	isr80h_register_command(SYSTEM_COMMAND37_GRAPHICS_STATS, isr80h_command37_graphics_stats);
+	isr80h_register_command(SYSTEM_COMMAND38_FDUP, isr80h_command38_fdup);
 }
@@ -28,6 +28,19 @@ enum system_commands
 	SYSTEM_COMMAND23_WINDOW_REDRAW_REGION,
 	SYSTEM_COMMAND24_UPDATE_WINDOW,
 	SYSTEM_COMMAND25_UDELAY,
+	SYSTEM_COMMAND26_DISK_STATS,
+	SYSTEM_COMMAND27_FWRITE,
+	SYSTEM_COMMAND28_FTRUNCATE,
+	SYSTEM_COMMAND29_FUNLINK,
+	SYSTEM_COMMAND30_PREAD,
+	SYSTEM_COMMAND31_PWRITE,
+	SYSTEM_COMMAND32_READV,
+	SYSTEM_COMMAND33_WRITEV,
+	SYSTEM_COMMAND34_READDIR,
+	SYSTEM_COMMAND35_FMAP,
+	SYSTEM_COMMAND36_FUNMAP,
+	SYSTEM_COMMAND37_GRAPHICS_STATS,
+	SYSTEM_COMMAND38_FDUP,
 };
 
 void isr80h_register_commands();
@@ -5,6 +5,7 @@
 #include "io/io.h"
 #include "io/tsc.h"
 #include "io/pci.h"
+#include "io/apic.h"
 #include "memory/heap/kheap.h"
 #include "memory/heap/heap.h"
 #include "memory/memory.h"
@@ -13,6 +14,7 @@
 #include "task/process.h"
 #include "disk/disk.h"
 #include "disk/gpt.h"
+#include "disk/drivers/ramdisk.h"
 #include "fs/file.h"
 #include "fs/pparser.h"
 #include "string/string.h"
@@ -54,6 +56,7 @@ void print(const char *str)
 void panic(const char *msg)
 {
 	print(msg);
+	graphics_present();
 	while (42)
 		;
 }
@@ -102,6 +105,9 @@ void kernel_main()
 	// initialize the interrupt descriptor table
 	idt_init();
 
+	// initialize the local APIC so devices can deliver message signalled interrupts
+	apic_init();
+
 	// initialize the PCI subsystem
 	pci_init();
 
@@ -114,6 +120,9 @@ void kernel_main()
 	// initialize GPT drives
 	gpt_init();
 
+	// mount the ramdisk image handed over by the bootloader
+	ramdisk_boot_init();
+
 	// initialize font system
 	font_system_init();
 
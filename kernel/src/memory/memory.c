@@ -86,7 +86,7 @@ int memcmp(void *s1, void *s2, int count)
 	return 0;
 }
 
-void *memcpy(void *dest, void *src, int len)
+void *memcpy(void *dest, void *src, size_t len)
 {
 	char *d = dest;
 	char *s = src;
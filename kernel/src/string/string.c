@@ -9,6 +9,15 @@ char tolower(char c)
 	return c;
 }
 
+char toupper(char c)
+{
+	if (c >= 97 && c <= 122)
+	{
+		c -= 32;
+	}
+	return c;
+}
+
 int strlen(const char *ptr)
 {
 	int i = 0;
@@ -4,6 +4,8 @@
 #include "status.h"
 #include "task.h"
 #include "fs/file.h"
+#include "fs/pagecache.h"
+#include "disk/disk.h"
 #include "string/string.h"
 #include "kernel.h"
 #include "memory/paging/paging.h"
@@ -14,6 +16,8 @@
 #include <stdbool.h>
 
 int process_close_file_handles(struct process *process);
+static void process_unmap_all(struct process *process);
+static int process_copy_to_user(struct process *process, void *virt_ptr, void *in, size_t size);
 
 // current process that is running
 struct process *current_process = 0;
@@ -34,9 +38,10 @@ static void process_init(struct process *process)
 {
 	memset(process, 0, sizeof(struct process));
 	process->allocations = vector_new(sizeof(struct process_allocation), 10, 0);
-	process->file_handles = vector_new(sizeof(struct process_file_handle *), 4, 0);
 	process->kernel_userland_ptrs_vector = vector_new(sizeof(struct userland_ptr *), 4, 0);
 	process->windows = vector_new(sizeof(struct process_window *), 4, 0);
+	process->mappings = vector_new(sizeof(struct process_mapping *), 4, 0);
+	process->map_next = (void *)MYOS_PROCESS_MAP_VIRTUAL_ADDRESS;
 	process->window_events.events = vector_new(sizeof(struct window_event), 100, 0);
 
 	vector_grow(process->window_events.events, PROCESS_MAX_WINDOW_RECORDED);
@@ -701,6 +706,7 @@ int process_free_process(struct process *process)
 {
 	int res = 0;
 	process_close_windows(process);
+	process_unmap_all(process);
 	process_terminate_allocations(process);
 	process_free_program_data(process);
 	process_close_file_handles(process);
@@ -1227,6 +1233,13 @@ out:
 int process_fstat(struct process *process, int fd, struct file_stat *virt_filestat_addr)
 {
 	int res = 0;
+	struct file_descriptor *desc = process_file_get(process, fd);
+	if (!desc)
+	{
+		res = -EIO;
+		goto out;
+	}
+
 	res = process_validate_memory_or_terminate(process, virt_filestat_addr, sizeof(*virt_filestat_addr));
 	if (res < 0)
 	{
@@ -1240,7 +1253,7 @@ int process_fstat(struct process *process, int fd, struct file_stat *virt_filest
 		goto out;
 	}
 
-	res = fstat(fd, phys_filestat_addr);
+	res = file_stat(desc, phys_filestat_addr);
 	if (res < 0)
 	{
 		goto out;
@@ -1250,17 +1263,40 @@ out:
 	return res;
 }
 
+int process_disk_stats(struct process *process, int disk_id, struct disk_stats_info *virt_info_addr)
+{
+	int res = 0;
+	struct disk_stats_info info;
+	res = process_validate_memory_or_terminate(process, virt_info_addr, sizeof(info));
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	// the user buffer may cross a page boundary, fill a kernel copy and copy it out page by page
+	res = disk_stats_info_get(disk_id, &info);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = process_copy_to_user(process, virt_info_addr, &info, sizeof(info));
+
+out:
+	return res;
+}
+
 int process_fseek(struct process *process, int fd, int offset, FILE_SEEK_MODE whence)
 {
 	int res = 0;
-	struct process_file_handle *handle = process_file_handle_get(process, fd);
-	if (!handle)
+	struct file_descriptor *desc = process_file_get(process, fd);
+	if (!desc)
 	{
 		res = -EIO;
 		goto out;
 	}
 
-	res = fseek(handle->fd, offset, whence);
+	res = file_seek(desc, offset, whence);
 	if (res < 0)
 	{
 		goto out;
@@ -1269,130 +1305,596 @@ int process_fseek(struct process *process, int fd, int offset, FILE_SEEK_MODE wh
 out:
 	return res;
 }
+// splits a user buffer into physically contiguous runs by walking the process page tables
+void process_buffer_walk_init(struct process_buffer_walk *walk, struct process *process, void *virt, size_t size)
+{
+	walk->process = process;
+	walk->virt = virt;
+	walk->left = size;
+}
+
+// fills up to max segments, returns how many were filled, zero once the whole buffer was walked
+int process_buffer_walk_segments(struct process_buffer_walk *walk, struct file_segment *segments, int max)
+{
+	int total = 0;
+	while (walk->left && total < max)
+	{
+		char *phys = paging_get_physical_address(walk->process->paging_desc, walk->virt);
+		if (!phys)
+		{
+			return -EINVARG;
+		}
+
+		// rest of the page, extended while the next page follows it physically
+		size_t len = PAGING_PAGE_SIZE - ((uint64_t)walk->virt % PAGING_PAGE_SIZE);
+		while (len < walk->left && paging_get_physical_address(walk->process->paging_desc, walk->virt + len) == phys + len)
+		{
+			len += PAGING_PAGE_SIZE;
+		}
+
+		if (len > walk->left)
+		{
+			len = walk->left;
+		}
+
+		// segment lengths are 32 bit
+		if (len > 0x80000000)
+		{
+			len = 0x80000000;
+		}
+
+		segments[total].ptr = phys;
+		segments[total].len = len;
+		total++;
+		walk->virt += len;
+		walk->left -= len;
+	}
+
+	return total;
+}
+
+// moves size bytes between the file and user memory without a bounce buffer, the filesystem
+// is handed the user pages themselves one batch of contiguous runs at a time
+static int process_file_io(struct process *process, struct file_descriptor *desc, void *virt_ptr, size_t size, bool write)
+{
+	int res = 0;
+	int total_bytes = 0;
+	struct file_segment segments[MYOS_PROCESS_IO_SEGMENTS];
+	struct process_buffer_walk walk;
+	process_buffer_walk_init(&walk, process, virt_ptr, size);
+	while ((res = process_buffer_walk_segments(&walk, segments, MYOS_PROCESS_IO_SEGMENTS)) > 0)
+	{
+		uint32_t wanted = 0;
+		for (int i = 0; i < res; i++)
+		{
+			wanted += segments[i].len;
+		}
+
+		res = write ? file_write_segments(desc, segments, res) : file_read_segments(desc, segments, res);
+		if (res < 0)
+		{
+			return res;
+		}
+
+		total_bytes += res;
+
+		// reads stop short at the end of the file
+		if (res < wanted)
+		{
+			return total_bytes;
+		}
+	}
+
+	return res < 0 ? res : total_bytes;
+}
+
+// copies user memory that may straddle physically scattered pages
+static int process_copy_from_user(struct process *process, void *out, void *virt_ptr, size_t size)
+{
+	int res = 0;
+	char *out_ptr = out;
+	struct file_segment segments[MYOS_PROCESS_IO_SEGMENTS];
+	struct process_buffer_walk walk;
+	process_buffer_walk_init(&walk, process, virt_ptr, size);
+	while ((res = process_buffer_walk_segments(&walk, segments, MYOS_PROCESS_IO_SEGMENTS)) > 0)
+	{
+		for (int i = 0; i < res; i++)
+		{
+			memcpy(out_ptr, segments[i].ptr, segments[i].len);
+			out_ptr += segments[i].len;
+		}
+	}
+
+	return res;
+}
+
+static int process_copy_to_user(struct process *process, void *virt_ptr, void *in, size_t size)
+{
+	int res = 0;
+	char *in_ptr = in;
+	struct file_segment segments[MYOS_PROCESS_IO_SEGMENTS];
+	struct process_buffer_walk walk;
+	process_buffer_walk_init(&walk, process, virt_ptr, size);
+	while ((res = process_buffer_walk_segments(&walk, segments, MYOS_PROCESS_IO_SEGMENTS)) > 0)
+	{
+		for (int i = 0; i < res; i++)
+		{
+			memcpy(segments[i].ptr, in_ptr, segments[i].len);
+			in_ptr += segments[i].len;
+		}
+	}
+
+	return res;
+}
+
+// transfers at offset in one kernel entry, the descriptor's position is restored afterwards
+int process_pio(struct process *process, int fd, void *virt_ptr, size_t size, uint32_t offset, bool write)
+{
+	int res = 0;
+	uint32_t pos = 0;
+	struct file_descriptor *desc = process_file_get(process, fd);
+	if (!desc || size == 0)
+	{
+		res = -EINVARG;
+		goto out;
+	}
+
+	res = process_validate_memory_or_terminate(process, virt_ptr, size);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	if (!write)
+	{
+		// reads at or past the end of the file transfer nothing, the seek would reject the offset
+		struct file_stat stat;
+		res = file_stat(desc, &stat);
+		if (res < 0 || offset >= stat.filesize)
+		{
+			goto out;
+		}
+	}
+
+	res = file_tell(desc, &pos);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = file_seek(desc, offset, SEEK_SET);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = process_file_io(process, desc, virt_ptr, size, write);
+
+	// a write can only have grown the file, so the old position is always still valid
+	int seek_res = file_seek(desc, pos, SEEK_SET);
+	if (res >= 0 && seek_res < 0)
+	{
+		res = seek_res;
+	}
+out:
+	return res;
+}
+
+// every buffer of the iovec array in order from the current position, returns the total bytes moved
+int process_vio(struct process *process, int fd, struct process_iovec *virt_iov, int iovcnt, bool write)
+{
+	int res = 0;
+	int total_bytes = 0;
+	struct process_iovec batch[MYOS_PROCESS_IO_SEGMENTS];
+	struct file_descriptor *desc = process_file_get(process, fd);
+	if (!desc || iovcnt <= 0 || iovcnt > MYOS_PROCESS_MAX_IOVEC)
+	{
+		res = -EINVARG;
+		goto out;
+	}
+
+	res = process_validate_memory_or_terminate(process, virt_iov, iovcnt * sizeof(struct process_iovec));
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	for (int first = 0; first < iovcnt; first += MYOS_PROCESS_IO_SEGMENTS)
+	{
+		int total = iovcnt - first < MYOS_PROCESS_IO_SEGMENTS ? iovcnt - first : MYOS_PROCESS_IO_SEGMENTS;
+		res = process_copy_from_user(process, batch, &virt_iov[first], total * sizeof(struct process_iovec));
+		if (res < 0)
+		{
+			goto out;
+		}
+
+		for (int i = 0; i < total; i++)
+		{
+			if (batch[i].len == 0)
+			{
+				continue;
+			}
+
+			res = process_validate_memory_or_terminate(process, batch[i].base, batch[i].len);
+			if (res < 0)
+			{
+				goto out;
+			}
+
+			res = process_file_io(process, desc, batch[i].base, batch[i].len, write);
+			if (res < 0)
+			{
+				goto out;
+			}
+
+			total_bytes += res;
+		}
+	}
+
+	res = total_bytes;
+out:
+	return res;
+}
+
 int process_fread(struct process *process, void *virt_ptr, uint64_t size, uint64_t nmemb, int fd)
 {
 	int res = 0;
-	struct process_file_handle *handle = process_file_handle_get(process, fd);
-	if (!handle)
+	struct file_descriptor *desc = process_file_get(process, fd);
+	if (!desc)
 	{
 		res = -EINVARG;
 		goto out;
 	}
 
 	size_t true_size = size * nmemb;
-	res = process_validate_memory_or_terminate(process, virt_ptr, true_size);
-	if (res < 0)
+	if (true_size == 0)
 	{
+		res = -EINVARG;
 		goto out;
 	}
 
-	void *phys_ptr = task_virtual_addr_to_phys(process->task, virt_ptr);
-	if (!phys_ptr)
+	res = process_validate_memory_or_terminate(process, virt_ptr, true_size);
+	if (res < 0)
 	{
-		res = -EIO;
 		goto out;
 	}
 
-	res = fread(phys_ptr, size, nmemb, handle->fd);
+	res = process_file_io(process, desc, virt_ptr, true_size, false);
 	if (res < 0)
 	{
 		goto out;
 	}
 
+	// members read in full, fewer than asked for at the end of the file
+	res = res / size;
 out:
 	return res;
 }
 
-int process_fclose(struct process *process, int fd)
+int process_fwrite(struct process *process, void *virt_ptr, uint64_t size, uint64_t nmemb, int fd)
 {
 	int res = 0;
-	struct process_file_handle *handle = process_file_handle_get(process, fd);
-	if (!handle)
+	struct file_descriptor *desc = process_file_get(process, fd);
+	if (!desc)
+	{
+		res = -EINVARG;
+		goto out;
+	}
+
+	size_t true_size = size * nmemb;
+	if (true_size == 0)
 	{
 		res = -EINVARG;
 		goto out;
 	}
 
-	fclose(handle->fd);
+	res = process_validate_memory_or_terminate(process, virt_ptr, true_size);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = process_file_io(process, desc, virt_ptr, true_size, true);
+	if (res < 0)
+	{
+		goto out;
+	}
 
-	// remove from vector
-	vector_pop_element(process->file_handles, &handle, sizeof(handle));
-	kfree(handle);
+	res = nmemb;
 out:
 	return res;
 }
 
-int process_fopen(struct process *process, const char *path, const char *mode)
+int process_ftruncate(struct process *process, int fd, uint32_t size)
+{
+	struct file_descriptor *desc = process_file_get(process, fd);
+	if (!desc)
+	{
+		return -EINVARG;
+	}
+
+	return file_truncate(desc, size);
+}
+
+static void process_mapping_free(struct process *process, struct process_mapping *mapping)
+{
+	for (int i = 0; i < mapping->total_pages; i++)
+	{
+		if (!mapping->pages[i])
+		{
+			continue;
+		}
+
+		if (process->paging_desc)
+		{
+			paging_map(process->paging_desc, mapping->virt + (size_t)i * PAGING_PAGE_SIZE, NULL, 0);
+		}
+
+		page_cache_put(mapping->pages[i]);
+	}
+
+	kfree(mapping->pages);
+	kfree(mapping);
+}
+
+// maps a file range read only, offset must be page aligned and the range is cut at the end of the file
+// every page is populated here from the page cache, there is no fault path to fill them in later
+void *process_fmap(struct process *process, int fd, uint32_t offset, size_t size)
 {
 	int res = 0;
-	int fd = fopen(path, mode);
-	if (fd <= 0)
+	struct process_mapping *mapping = NULL;
+	struct file_descriptor *desc = process_file_get(process, fd);
+	if (!desc || size == 0 || offset % PAGING_PAGE_SIZE)
 	{
-		res = -EIO;
+		res = -EINVARG;
+		goto out;
+	}
+
+	struct file_stat stat;
+	res = file_stat(desc, &stat);
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	if (offset >= stat.filesize)
+	{
+		res = -EOUTOFRANGE;
 		goto out;
 	}
 
-	res = fd;
+	if (size > stat.filesize - offset)
+	{
+		size = stat.filesize - offset;
+	}
 
-	// allocate memory for process_file_handle
-	struct process_file_handle *handle = kzalloc(sizeof(struct process_file_handle *));
-	if (!handle)
+	mapping = kzalloc(sizeof(struct process_mapping));
+	if (!mapping)
 	{
 		res = -ENOMEM;
 		goto out;
 	}
 
-	handle->fd = fd;
-	strncpy(handle->file_path, path, sizeof(handle->file_path));
-	strncpy(handle->mode, mode, sizeof(handle->mode));
+	mapping->size = paging_align_value_to_upper_page(size);
+	mapping->virt = process->map_next;
+	mapping->pages = kzalloc(mapping->size / PAGING_PAGE_SIZE * sizeof(struct page_cache_page *));
+	if (!mapping->pages)
+	{
+		res = -ENOMEM;
+		goto out;
+	}
+
+	for (size_t i = 0; i < mapping->size / PAGING_PAGE_SIZE; i++)
+	{
+		struct page_cache_page *page = page_cache_get(desc, offset / PAGING_PAGE_SIZE + i);
+		if (ISERR(page))
+		{
+			res = ERROR_I(page);
+			goto out;
+		}
 
-	// add to process file_handles vector
-	vector_push(process->file_handles, &handle);
+		mapping->pages[i] = page;
+		mapping->total_pages++;
+		res = paging_map(process->paging_desc, mapping->virt + i * PAGING_PAGE_SIZE, page->data, PAGING_IS_PRESENT | PAGING_ACCESS_FROM_ALL);
+		if (res < 0)
+		{
+			goto out;
+		}
+	}
+
+	res = vector_push(process->mappings, &mapping);
+	if (res < 0)
+	{
+		goto out;
+	}
 
+	process->map_next += mapping->size;
 out:
 	if (res < 0)
 	{
-		fclose(fd);
+		if (mapping)
+		{
+			process_mapping_free(process, mapping);
+		}
+
+		return ERROR(res);
 	}
-	return res;
+
+	return mapping->virt;
 }
 
-struct process_file_handle *process_file_handle_get(struct process *process, int fd)
+int process_funmap(struct process *process, void *virt)
 {
-	size_t total_handles = vector_count(process->file_handles);
-	for (size_t i = 0; i < total_handles; i++)
+	size_t total_mappings = vector_count(process->mappings);
+	for (size_t i = 0; i < total_mappings; i++)
 	{
-		struct process_file_handle *handle = NULL;
-		vector_at(process->file_handles, i, &handle, sizeof(handle));
-		if (handle && handle->fd == fd)
+		struct process_mapping *mapping = NULL;
+		vector_at(process->mappings, i, &mapping, sizeof(mapping));
+		if (mapping && mapping->virt == virt)
 		{
-			return handle;
+			vector_pop_element(process->mappings, &mapping, sizeof(mapping));
+			process_mapping_free(process, mapping);
+			return 0;
 		}
 	}
 
-	return NULL;
+	return -EINVARG;
 }
 
-int process_close_file_handles(struct process *process)
+static void process_unmap_all(struct process *process)
+{
+	size_t total_mappings = vector_count(process->mappings);
+	for (size_t i = 0; i < total_mappings; i++)
+	{
+		struct process_mapping *mapping = NULL;
+		vector_at(process->mappings, i, &mapping, sizeof(mapping));
+		if (mapping)
+		{
+			process_mapping_free(process, mapping);
+		}
+	}
+
+	vector_free(process->mappings);
+	process->mappings = NULL;
+}
+
+// lists up to max entries of a directory into user memory, the cursor is read and written back so listing resumes
+int process_readdir(struct process *process, const char *path, uint32_t *virt_cursor, struct file_dirent *virt_out, int max)
 {
 	int res = 0;
-	size_t total_handles = vector_count(process->file_handles);
-	for (size_t i = 0; i < total_handles; i++)
+	int total = 0;
+	uint32_t cursor = 0;
+	struct file_dirent batch[MYOS_PROCESS_IO_SEGMENTS];
+	if (max <= 0)
 	{
-		struct process_file_handle *handle = NULL;
-		vector_at(process->file_handles, i, &handle, sizeof(handle));
-		if (handle)
+		res = -EINVARG;
+		goto out;
+	}
+
+	res = process_validate_memory_or_terminate(process, virt_cursor, sizeof(cursor));
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = process_validate_memory_or_terminate(process, virt_out, max * sizeof(struct file_dirent));
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = process_copy_from_user(process, &cursor, virt_cursor, sizeof(cursor));
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	while (total < max)
+	{
+		int wanted = max - total < MYOS_PROCESS_IO_SEGMENTS ? max - total : MYOS_PROCESS_IO_SEGMENTS;
+		res = file_readdir(path, &cursor, batch, wanted);
+		if (res <= 0)
 		{
-			fclose(handle->fd);
-			kfree(handle);
+			break;
+		}
+
+		int copy_res = process_copy_to_user(process, &virt_out[total], batch, res * sizeof(struct file_dirent));
+		if (copy_res < 0)
+		{
+			res = copy_res;
+			break;
 		}
+
+		total += res;
+		if (res < wanted)
+		{
+			break;
+		}
+	}
+
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	res = process_copy_to_user(process, virt_cursor, &cursor, sizeof(cursor));
+	if (res < 0)
+	{
+		goto out;
 	}
 
-	vector_free(process->file_handles);
-	process->file_handles = NULL;
+	res = total;
+out:
 	return res;
 }
 
+int process_graphics_stats(struct process *process, struct graphics_stats *virt_stats_out)
+{
+	int res = 0;
+	struct graphics_stats stats;
+	res = process_validate_memory_or_terminate(process, virt_stats_out, sizeof(stats));
+	if (res < 0)
+	{
+		goto out;
+	}
+
+	graphics_stats_get(&stats);
+	res = process_copy_to_user(process, virt_stats_out, &stats, sizeof(stats));
+out:
+	return res;
+}
+
+int process_funlink(struct process *process, const char *path)
+{
+	return funlink(path);
+}
+
+int process_fclose(struct process *process, int fd)
+{
+	struct file_descriptor *desc = fd_table_remove(&process->files, fd);
+	if (!desc)
+	{
+		return -EINVARG;
+	}
+
+	return file_put(desc);
+}
+
+int process_fopen(struct process *process, const char *path, const char *mode)
+{
+	struct file_descriptor *desc = file_open(path, mode);
+	if (ISERR(desc))
+	{
+		return -EIO;
+	}
+
+	int res = fd_table_install(&process->files, desc);
+	if (res < 0)
+	{
+		file_put(desc);
+	}
+
+	return res;
+}
+
+// array index into the process table, no search
+struct file_descriptor *process_file_get(struct process *process, int fd)
+{
+	return fd_table_get(&process->files, fd);
+}
+
+// the new descriptor shares the open file and its position with fd
+int process_fdup(struct process *process, int fd)
+{
+	return fd_table_dup(&process->files, fd);
+}
+
+int process_close_file_handles(struct process *process)
+{
+	fd_table_free(&process->files);
+	return 0;
+}
+
 int process_map_into_userspace(struct process *process, void *phys_ptr, size_t t_size, int map_flags, void **virt_addr_out)
 {
 	int res = 0;
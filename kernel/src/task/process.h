@@ -4,6 +4,7 @@
 #include "task.h"
 #include "config.h"
 #include "fs/file.h"
+#include "fs/fdtable.h"
 #include <stddef.h>
 #include <stdbool.h>
 
@@ -53,11 +54,30 @@ struct process_allocation_request
 	} peek;
 };
 
-struct process_file_handle
+// cursor over a user buffer, see process_buffer_walk_segments
+struct process_buffer_walk
 {
-	int fd;						   // file descriptor
-	char file_path[MYOS_MAX_PATH]; // path to the file
-	char mode[2];				   // file mode (e.g., "r", "w", etc.)
+	struct process *process;
+	char *virt;
+	size_t left;
+};
+
+struct page_cache_page;
+
+// read only view of a file range, the pages belong to the page cache and are shared with other mappings
+struct process_mapping
+{
+	void *virt;
+	size_t size; // whole pages
+	struct page_cache_page **pages;
+	int total_pages;
+};
+
+// layout of struct iovec in the stdlib
+struct process_iovec
+{
+	void *base;
+	uint64_t len;
 };
 
 struct process_userspace_window
@@ -92,8 +112,8 @@ struct process
 	// vector of struct userland_ptr*
 	struct vector *kernel_userland_ptrs_vector;
 
-	// vector of struct process_file_handle*
-	struct vector *file_handles;
+	// open files indexed by descriptor, allocated on the first open
+	struct fd_table files;
 
 	PROCESS_FILETYPE filetype;
 
@@ -121,6 +141,10 @@ struct process
 	// vector of struct process_window*
 	struct vector *windows;
 
+	// vector of struct process_mapping*, placed one after another from MYOS_PROCESS_MAP_VIRTUAL_ADDRESS
+	struct vector *mappings;
+	void *map_next;
+
 	// window events
 	struct
 	{
@@ -151,12 +175,27 @@ void process_get_arguments(struct process *process, int *argc, char ***argv);
 int process_inject_arguments(struct process *process, struct command_argument *root_argument);
 int process_terminate(struct process *process);
 
-struct process_file_handle *process_file_handle_get(struct process *process, int fd);
+struct file_descriptor *process_file_get(struct process *process, int fd);
+int process_fdup(struct process *process, int fd);
+void process_buffer_walk_init(struct process_buffer_walk *walk, struct process *process, void *virt, size_t size);
+int process_buffer_walk_segments(struct process_buffer_walk *walk, struct file_segment *segments, int max);
 int process_fopen(struct process *process, const char *path, const char *mode);
 int process_fclose(struct process *process, int fd);
 int process_fread(struct process *process, void *virt_ptr, uint64_t size, uint64_t nmemb, int fd);
 int process_fseek(struct process *process, int fd, int offset, FILE_SEEK_MODE whence);
 int process_fstat(struct process *process, int fd, struct file_stat *virt_filestat_addr);
+int process_fwrite(struct process *process, void *virt_ptr, uint64_t size, uint64_t nmemb, int fd);
+int process_ftruncate(struct process *process, int fd, uint32_t size);
+int process_pio(struct process *process, int fd, void *virt_ptr, size_t size, uint32_t offset, bool write);
+int process_vio(struct process *process, int fd, struct process_iovec *virt_iov, int iovcnt, bool write);
+int process_funlink(struct process *process, const char *path);
+void *process_fmap(struct process *process, int fd, uint32_t offset, size_t size);
+int process_funmap(struct process *process, void *virt);
+int process_readdir(struct process *process, const char *path, uint32_t *virt_cursor, struct file_dirent *virt_out, int max);
+struct disk_stats_info;
+int process_disk_stats(struct process *process, int disk_id, struct disk_stats_info *virt_info_addr);
+struct graphics_stats;
+int process_graphics_stats(struct process *process, struct graphics_stats *virt_stats_out);
 struct process_window *process_window_create(struct process *process, char *title, int width, int height, int flags, int id);
 bool process_owns_kernel_window(struct process *process, struct window *kernel_window);
 struct process *process_get_from_kernel_window(struct window *kernel_window);
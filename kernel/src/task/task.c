@@ -8,6 +8,7 @@
 #include "process.h"
 #include "string/string.h"
 #include "loader/formats/elfloader.h"
+#include "graphics/graphics.h"
 
 // current task that is running
 struct task *current_task = 0;
@@ -216,6 +217,11 @@ void task_current_save_state(struct interrupt_frame *frame)
 
 bool task_is_sleeping(struct task *task)
 {
+	if (task->waiting.channel)
+	{
+		return true;
+	}
+
 	return task->sleeping.sleep_until_microseconds > tsc_microseconds();
 }
 
@@ -224,6 +230,37 @@ void task_sleep(struct task *task, TIME_MICROSECONDS sleep_time)
 	task->sleeping.sleep_until_microseconds = tsc_microseconds() + sleep_time;
 }
 
+void task_wait_for_wakeup(void *channel)
+{
+	// the kernel has a single stack so a task blocked inside a system call cannot be switched away from,
+	// instead the CPU is halted until the next interrupt. callers must disable interrupts, check their
+	// completion condition and only then call us, re-checking the condition once we return
+	if (current_task)
+	{
+		current_task->waiting.channel = channel;
+	}
+
+	// sti only takes effect after the following instruction, an interrupt raised before
+	// the halt is therefore never lost
+	__asm__ volatile("sti; hlt; cli" ::: "memory");
+
+	if (current_task)
+	{
+		current_task->waiting.channel = NULL;
+	}
+}
+
+void task_wakeup(void *channel)
+{
+	for (struct task *task = task_head; task; task = task->next)
+	{
+		if (task->waiting.channel == channel)
+		{
+			task->waiting.channel = NULL;
+		}
+	}
+}
+
 int task_page()
 {
 	user_registers();
@@ -276,6 +313,9 @@ void task_next()
 	struct task *next_task = NULL;
 	do
 	{
+		// the screen is still updated while every task sleeps
+		graphics_frame();
+
 		int res = task_get_next_non_sleeping_task(&next_task);
 		if (res < 0)
 		{
@@ -39,6 +39,12 @@ struct task
 		TIME_MICROSECONDS sleep_until_microseconds; // if task is sleeping, the time (in microseconds) until which it should sleep. if 0, task is not sleeping
 	} sleeping;
 
+	// waiting info
+	struct
+	{
+		void *channel; // if the task is blocked in the kernel waiting for an interrupt, the channel it waits on. NULL otherwise
+	} waiting;
+
 	// next task in linked list
 	struct task *next;
 
@@ -70,4 +76,7 @@ struct paging_desc *task_current_paging_desc();
 
 void task_sleep(struct task *task, TIME_MICROSECONDS sleep_time);
 bool task_is_sleeping(struct task *task);
-int task_get_next_non_sleeping_task(struct task **out);
\ No newline at end of file
+int task_get_next_non_sleeping_task(struct task **out);
+
+void task_wait_for_wakeup(void *channel);
+void task_wakeup(void *channel);
\ No newline at end of file